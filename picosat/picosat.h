@@ -60,6 +60,19 @@ void picosat_set_delete (void *, void (*)(void *, void *, size_t));
 void picosat_init (void);               /* constructor */
 void picosat_reset (void);              /* destructor */
 
+/*------------------------------------------------------------------------*/
+/* Each call to 'picosat_init' creates a new solver instance, which becomes
+ * the current instance of the calling thread.  All other functions work
+ * on the current instance and 'picosat_reset' deletes it.  Several
+ * instances can be used alternately by selecting them with
+ * 'picosat_select', also from different threads, as long as an instance
+ * is not used by two threads at the same time.
+ */
+typedef struct PicoSAT PicoSAT;
+
+PicoSAT * picosat_current (void);       /* 0 if there is none */
+void picosat_select (PicoSAT *);
+
 /*------------------------------------------------------------------------*/
 /* The following five functions are essentially parameters to 'init', and
  * thus should be called right after 'picosat_init' before doing anything
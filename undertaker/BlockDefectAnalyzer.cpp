@@ -27,11 +27,22 @@
 #include "SatChecker.h"
 #include "ModelContainer.h"
 #include "ConfigurationModel.h"
+#include "CnfConfigurationModel.h"
 #include "Logging.h"
 #include "Tools.h"
+#include "bool.h"
 #include "exceptions/CNFBuilderError.h"
+#include "exceptions/SatBudgetExceeded.h"
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
 #include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 
 /************************************************************************/
@@ -43,20 +54,24 @@ std::string BlockDefectAnalyzer::getBlockPrecondition(ConditionalBlock *cb,
     StringJoiner formula;
 
     /* Adding block and code constraints extraced from code sat stream */
-    std::string code_formula = cb->getCodeConstraints();
     formula.push_back(cb->getName());
-    formula.push_back(code_formula);
+    formula.push_back(cb->getCodeConstraints());
 
     if (model) {
         /* Adding kconfig constraints and kconfig missing */
         std::set<std::string> missingSet;
         std::string kconfig_formula;
         // add file precondition
-        code_formula += " && ";
-        code_formula += cb->getBuildSystemCondition();
         formula.push_back(cb->getBuildSystemCondition());
-        model->doIntersect(code_formula, cb->getFile()->getDefineChecker(), missingSet,
-                           kconfig_formula);
+        // the items of the code constraints and the file precondition, none if a block
+        // expression can't be parsed
+        kconfig::BoolExp *exp = nullptr;
+        try {
+            exp = B_AND(cb->getCodeConstraintExp()->retain(), cb->getBuildSystemConditionExp());
+        } catch (CNFBuilderError &) {}
+        model->doIntersect(exp, cb->getFile()->getDefineChecker(), missingSet, kconfig_formula);
+        if (exp)
+            exp->release();
         formula.push_back(kconfig_formula);
         if (model->isComplete())
             formula.push_back(ConfigurationModel::getMissingItemsConstraints(missingSet));
@@ -64,21 +79,113 @@ std::string BlockDefectAnalyzer::getBlockPrecondition(ConditionalBlock *cb,
     return formula.join("\n&& ");
 }
 
+static unsigned int crosscheck_threads = 1;
+
+void BlockDefectAnalyzer::setCrosscheckThreads(unsigned int threads) {
+    crosscheck_threads = threads > 0 ? threads : 1;
+}
+
+namespace {
+    /*
+     * Threads that help the calling thread with a job. They are started
+     * once and wait for the next job in between, so checking a block
+     * doesn't pay for starting threads.
+     */
+    class WorkerPool {
+        std::vector<std::thread> _threads;
+        std::mutex _running;  // run() isn't reentrant, its callers take turns
+        std::mutex _mutex;
+        std::condition_variable _started, _finished;
+        const std::function<void(unsigned int)> *_job = nullptr;
+        unsigned long _generation = 0;  // number of jobs run so far
+        size_t _busy = 0;               // threads still working on the current job
+        bool _stopping = false;
+
+        void work(unsigned int slot) {
+            unsigned long done = 0;
+            std::unique_lock<std::mutex> lock(_mutex);
+            while (true) {
+                _started.wait(lock, [&]() { return _generation != done || _stopping; });
+                if (_stopping)
+                    return;
+                done = _generation;
+                const std::function<void(unsigned int)> *job = _job;
+                lock.unlock();
+                (*job)(slot);
+                lock.lock();
+                if (--_busy == 0)
+                    _finished.notify_one();
+            }
+        }
+
+    public:
+        explicit WorkerPool(unsigned int threads) {
+            // slot 0 is the calling thread
+            for (unsigned int t = 1; t <= threads; t++)
+                _threads.emplace_back(&WorkerPool::work, this, t);
+        }
+
+        ~WorkerPool() {
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _stopping = true;
+            }
+            _started.notify_all();
+            for (std::thread &thread : _threads)
+                thread.join();
+        }
+
+        //! number of threads that run a job, including the calling thread
+        unsigned int size() const { return _threads.size() + 1; }
+
+        /**
+         * Runs the job on all threads of the pool and the calling thread. Each
+         * thread passes its own slot in [0, size()), the job must not throw.
+         * Jobs of several threads, e.g., of a job abandoned by its watchdog
+         * and of the next one, are run one after the other.
+         */
+        void run(const std::function<void(unsigned int)> &job) {
+            std::lock_guard<std::mutex> running(_running);
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _job = &job;
+                _busy = _threads.size();
+                _generation++;
+            }
+            _started.notify_all();
+            job(0);
+            std::unique_lock<std::mutex> lock(_mutex);
+            _finished.wait(lock, [&]() { return _busy == 0; });
+        }
+    };
+
+    /*
+     * The pool of the process. It is created by the first crosscheck, i.e.,
+     * in the forked process that analyzes the file, after the models have
+     * been loaded. Hence, it is destroyed before them when the process
+     * exits, which joins its threads.
+     */
+    WorkerPool &crosscheckPool() {
+        static WorkerPool pool(crosscheck_threads - 1);
+        return pool;
+    }
+} // namespace
+
 static const BlockDefect *analyzeBlock_helper(ConditionalBlock *block,
-                                              ConfigurationModel *main_model) {
-    BlockDefect *defect = new DeadBlockDefect(block);
+                                              ConfigurationModel *main_model,
+                                              const FileBudget &budget) {
+    // the analysis may be aborted by exceptions, e.g., when a check runs out of budget
+    std::unique_ptr<BlockDefect> defect(new DeadBlockDefect(block));
 
     // If this is neither an Implementation, Configuration nor Referential *dead*,
     // then destroy the analysis and retry with an Undead Analysis
     if (!defect->isDefect(main_model, true)) {
-        delete defect;
-        defect = new UndeadBlockDefect(block);
+        budget.check();
+        defect.reset(new UndeadBlockDefect(block));
 
         // No defect found, block seems OK
-        if (!defect->isDefect(main_model, true)) {
-            delete defect;
+        if (!defect->isDefect(main_model, true))
             return nullptr;
-        }
     }
     assert(defect->defectType() != BlockDefect::DEFECTTYPE::None);
 
@@ -93,30 +200,22 @@ static const BlockDefect *analyzeBlock_helper(ConditionalBlock *block,
     // they are not compileable for other architectures
     if (block->getFile()->getSpecificArch() != "") {
         defect->markAsGlobal();
-        return defect;
+        return defect.release();
     }
 
     // Implementation (i.e., Code) or NoKconfig defects do not require a crosscheck
     if (!main_model || !defect->needsCrosscheck())
-        return defect;
-
-    for (const auto &entry : ModelContainer::getInstance()) { // pair<string, ConfigurationModel *>
-        const ConfigurationModel *model = entry.second;
-        // don't check the main model twice
-        if (model == main_model)
-            continue;
+        return defect.release();
 
-        if (!defect->isDefect(model))
-            return defect;
-    }
-    defect->markAsGlobal();
-    return defect;
+    defect->crosscheck(main_model, budget);
+    return defect.release();
 }
 
 const BlockDefect *BlockDefectAnalyzer::analyzeBlock(ConditionalBlock *block,
-                                                     ConfigurationModel *main_model) {
+                                                     ConfigurationModel *main_model,
+                                                     const FileBudget &budget) {
     try {
-        return analyzeBlock_helper(block, main_model);
+        return analyzeBlock_helper(block, main_model, budget);
     } catch (CNFBuilderError &e) {
         Logging::error("Couldn't process ", block->getFile()->getFilename(), ":", block->getName(),
                        ": ", e.what());
@@ -127,10 +226,222 @@ const BlockDefect *BlockDefectAnalyzer::analyzeBlock(ConditionalBlock *block,
     return nullptr;
 }
 
+/**
+ * \brief the model dependent checks of a single defect query
+ *
+ * The checks are cumulative, each formula is checked together with all
+ * formulas checked before. Cnf models are loaded only once into an
+ * IncrementalSatChecker, which only keeps the formulas of this query
+ * until it is destroyed. Without a model, or with a rsf model, the query
+ * has a checker of its own.
+ */
+class ModelQuery {
+    IncrementalSatChecker _local{nullptr};
+    IncrementalSatChecker *_session = &_local;
+
+public:
+    ModelQuery(const ConfigurationModel *model, kconfig::BoolExp *code_exp) {
+        if (model && model->getModelVersionIdentifier() == "cnf")
+            _session = &IncrementalSatChecker::forModel(model);
+        _session->beginQuery();
+        try {
+            _session->addFormula(code_exp);
+        } catch (...) {
+            _session->endQuery();
+            throw;
+        }
+    }
+
+    ~ModelQuery() { _session->endQuery(); }
+
+    ModelQuery(const ModelQuery &) = delete;
+    ModelQuery &operator=(const ModelQuery &) = delete;
+
+    void addFormula(const std::string &formula) { _session->addFormula(formula); }
+
+    bool operator()(const std::string &formula) { return (*_session)(formula); }
+
+    bool checkAssuming(const SatChecker::AssignmentMap &assumptions) {
+        return _session->checkAssuming(assumptions);
+    }
+
+    bool deref(const std::string &var) const { return _session->deref(var); }
+
+    //! \return the architectures of a merged model on which the query is satisfiable
+    std::list<std::string> architectures(const StringList &archs) {
+        return _session->checkArchitectures(archs);
+    }
+};
+
+std::list<ConditionalBlock *>
+BlockDefectAnalyzer::getDefectCandidates(CppFile *file, const ConfigurationModel *model,
+                                         const FileBudget &budget) {
+    std::list<ConditionalBlock *> blocks(file->begin(), file->end());
+    blocks.push_front(file->topBlock());
+
+    kconfig::BoolExp *code_exp;
+    try {
+        code_exp = file->topBlock()->getCodeConstraintExp();
+    } catch (CNFBuilderError &e) {
+        // leave the error reporting to the analysis of the single blocks
+        Logging::debug("Couldn't check ", file->getFilename(), " as a whole: ", e.what());
+        return blocks;
+    }
+    // the model dependent part of the file formula
+    StringJoiner formula;
+    if (model) {
+        std::set<std::string> missingSet;
+        std::string kconfig_formula;
+        std::set<std::string> kconfigItems = model->doIntersect(code_exp,
+                                                                file->getDefineChecker(),
+                                                                missingSet, kconfig_formula);
+        formula.push_back(kconfig_formula);
+
+        std::string precondition = file->topBlock()->getBuildSystemCondition();
+        std::string precondition_formula;
+        model->doIntersect(precondition, nullptr, missingSet, precondition_formula, &kconfigItems);
+        formula.push_back(precondition_formula);
+        formula.push_back(precondition);
+
+        if (model->isComplete())
+            formula.push_back(ConfigurationModel::getMissingItemsConstraints(missingSet));
+    }
+
+    std::list<ConditionalBlock *> candidates;
+
+    // A satisfying assignment of the file formula usually selects (or deselects) many other
+    // blocks as well. Blocks witnessed that way don't need an own check. Blocks witnessed in
+    // both ways are dropped from 'unwitnessed'.
+    std::set<const ConditionalBlock *> selectable, deselectable, dead;
+    std::list<const ConditionalBlock *> unwitnessed(blocks.begin(), blocks.end());
+    // Blocks that contradict the items fixed by the model don't need the solver. The block is
+    // assumed to be selected, or deselected within its selected parent.
+    auto refutedByBackbone = [model](ConditionalBlock *block, const ConditionalBlock *parent) {
+        if (model->getBackbone().empty())
+            return false;
+        kconfig::BoolExp *selection = B_VAR(block->getName(), false);
+        if (parent)
+            selection = B_AND(B_VAR(parent->getName(), false), B_NOT(selection));
+        kconfig::BoolExp *exp = B_AND(selection, block->getCodeConstraintExp()->retain());
+        bool refuted = model->contradictsBackbone(exp);
+        exp->release();
+        return refuted;
+    };
+    try {
+        // cnf models are already loaded in the checker used by analyzeBlock()
+        ModelQuery sc(model, code_exp);
+        sc.addFormula(formula.join("\n&&\n"));
+        auto collectWitnesses = [&]() {
+            for (auto it = unwitnessed.begin(); it != unwitnessed.end();) {
+                const ConditionalBlock *block = *it, *parent = block->getParent();
+                if (sc.deref(block->getName()))
+                    selectable.insert(block);
+                else if (!parent || sc.deref(parent->getName()))
+                    deselectable.insert(block);
+
+                if (selectable.count(block) > 0 && (!parent || deselectable.count(block) > 0))
+                    it = unwitnessed.erase(it);
+                else
+                    ++it;
+            }
+        };
+        for (ConditionalBlock *block : blocks) {
+            budget.check();
+            const ConditionalBlock *parent = block->getParent();
+            // blocks imply their parent, hence children of dead blocks are dead as well
+            if (parent && dead.count(parent) > 0) {
+                dead.insert(block);
+                candidates.push_back(block);
+                continue;
+            }
+            if (selectable.count(block) == 0) {
+                if (model && refutedByBackbone(block, nullptr)) {
+                    dead.insert(block);
+                    candidates.push_back(block);
+                    continue;
+                }
+                SatChecker::AssignmentMap assumptions;
+                assumptions.emplace(block->getName(), true);
+                if (!sc.checkAssuming(assumptions)) {
+                    dead.insert(block);
+                    candidates.push_back(block);
+                    continue;
+                }
+                collectWitnesses();
+            }
+            if (parent && deselectable.count(block) == 0) {
+                if (model && refutedByBackbone(block, parent)) {
+                    candidates.push_back(block);
+                    continue;
+                }
+                SatChecker::AssignmentMap assumptions;
+                assumptions.emplace(parent->getName(), true);
+                assumptions.emplace(block->getName(), false);
+                if (!sc.checkAssuming(assumptions)) {
+                    candidates.push_back(block);
+                    continue;
+                }
+                collectWitnesses();
+            }
+        }
+    } catch (CNFBuilderError &e) {
+        // leave the error reporting to the analysis of the single blocks
+        Logging::debug("Couldn't check ", file->getFilename(), " as a whole: ", e.what());
+        return blocks;
+    } catch (std::bad_alloc &) {
+        Logging::debug("Couldn't check ", file->getFilename(), " as a whole: Out of Memory.");
+        return blocks;
+    } catch (SatBudgetExceeded &e) {
+        Logging::debug("Couldn't check ", file->getFilename(), " as a whole: ", e.what());
+        return blocks;
+    }
+    return candidates;
+}
+
+void BlockDefectAnalyzer::writeUnknownReport(ConditionalBlock *cb, const std::string &reason) {
+    const std::string filename = cb->getFile()->getFilename() + "." + cb->getName() + ".unknown";
+    std::ofstream out(filename);
+
+    if (!out.good()) {
+        Logging::error("failed to open ", filename, " for writing ");
+        return;
+    }
+    Logging::info("creating ", filename);
+    out << "#" << cb->getName() << ":" << cb->filename() << ":" << cb->lineStart() << ":"
+        << cb->colStart() << ":" << cb->filename() << ":" << cb->lineEnd() << ":"
+        << cb->colEnd() << ":" << std::endl;
+    out << reason << std::endl;
+}
+
+void BlockDefectAnalyzer::writeUnknownReport(const std::string &filename,
+                                             const std::string &reason) {
+    const std::string report = filename + ".unknown";
+    std::ofstream out(report);
+
+    if (!out.good()) {
+        Logging::error("failed to open ", report, " for writing ");
+        return;
+    }
+    Logging::info("creating ", report);
+    out << "#" << filename << std::endl;
+    out << reason << std::endl;
+}
+
 /************************************************************************/
 /* BlockDefect                                                          */
 /************************************************************************/
 
+BlockDefect::~BlockDefect() {
+    if (_codeExp)
+        _codeExp->release();
+}
+
+void BlockDefect::setCodeExp(kconfig::BoolExp *exp) {
+    if (_codeExp)
+        _codeExp->release();
+    _codeExp = exp;
+}
+
 const std::string BlockDefect::defectTypeToString() const {
     switch (_defectType) {
     case DEFECTTYPE::None:
@@ -193,7 +504,7 @@ bool BlockDefect::isNoKconfigDefect(const ConfigurationModel *model) const {
         }
     } else if (_cb == _cb->getFile()->topBlock()) {
         // If current block is the file, take the entire formula.
-        expr = _formula;
+        expr = getFormula();
     } else {
         // Otherwise, take the expression.
         expr = _cb->ifdefExpression();
@@ -221,7 +532,7 @@ void BlockDefect::writeReportToFile(bool skip_no_kconfig) const {
     out << "#" << _cb->getName() << ":" << _cb->filename() << ":" << _cb->lineStart() << ":"
         << _cb->colStart() << ":" << _cb->filename() << ":" << _cb->lineEnd() << ":"
         << _cb->colEnd() << ":" << std::endl;
-    out << _formula << std::endl;
+    out << getFormula() << std::endl;
     // for all processed arches, add the specific defect type to the defect report
     if (defectMap.size() > 0)
         out << [this]() {
@@ -237,6 +548,176 @@ void BlockDefect::writeReportToFile(bool skip_no_kconfig) const {
     out.close();
 }
 
+BlockDefect::ModelResult BlockDefect::checkModel(const ConfigurationModel *model) const {
+    static const std::string defects[] = {"kconfig", "kbuild", "missing"};
+    // each check adds one of these formulas to the checks before
+    std::vector<std::string> checks;
+
+    std::set<std::string> missingSet;
+    std::string kconfig_formula;
+    std::set<std::string> kconfigItems = model->doIntersect(_codeExp,
+                                                            _cb->getFile()->getDefineChecker(),
+                                                            missingSet, kconfig_formula);
+    checks.push_back(kconfig_formula);
+
+    std::string precondition = _cb->getBuildSystemCondition();
+    std::string precondition_formula;
+    model->doIntersect(precondition, nullptr, missingSet, precondition_formula, &kconfigItems);
+    if (precondition_formula.size() > 0)
+        precondition_formula += "\n&& ";
+    precondition_formula += precondition;
+    checks.push_back(precondition_formula);
+
+    // An incomplete model (not all symbols mentioned) can't generate referential errors
+    if (model->isComplete())
+        checks.push_back(ConfigurationModel::getMissingItemsConstraints(missingSet));
+
+    // the architectures of a merged cnf model, each of them gets its own result
+    const CnfConfigurationModel *cnf_model = dynamic_cast<const CnfConfigurationModel *>(model);
+    const StringList *archs = cnf_model ? cnf_model->getArchitectures() : nullptr;
+    std::map<std::string, std::string> arch_defects;
+
+    std::string canonical, defect;
+    // blocks that contradict the items fixed by the model don't need the solver
+    const bool refuted = model->contradictsBackbone(_codeExp);
+    if (refuted) {
+        Logging::debug(_cb->getName(), " contradicts the items fixed by ", model->getName());
+        defect = defects[0];
+        // the items of a merged model are fixed on all of its architectures
+        if (archs)
+            for (const std::string &arch : *archs)
+                arch_defects.emplace(arch, defect);
+    } else if (SatResultCache::isEnabled() && !archs) {
+        // the cache only knows the result of the whole model, it is keyed by the canonical
+        // text of the formulas
+        std::vector<std::string> formulas{codeFormula()};
+        formulas.insert(formulas.end(), checks.begin(), checks.end());
+        canonical = SatResultCache::canonicalize(model, formulas);
+    }
+    if (!refuted && (canonical.empty() || !SatResultCache::lookup(canonical, defect))) {
+        ModelQuery check(model, _codeExp);
+        // architectures without a defect up to the current check
+        StringList enabled;
+        if (archs)
+            enabled = *archs;
+        for (unsigned int i = 0; i < checks.size() && defect.empty(); i++) {
+            if (!check(checks[i])) {
+                // with the selectors left free, the check fails on every architecture
+                defect = defects[i];
+                for (const std::string &arch : enabled)
+                    arch_defects.emplace(arch, defect);
+                enabled.clear();
+            } else if (archs) {
+                std::list<std::string> satisfiable = check.architectures(enabled);
+                for (const std::string &arch : enabled)
+                    if (std::find(satisfiable.begin(), satisfiable.end(), arch)
+                            == satisfiable.end())
+                        arch_defects.emplace(arch, defects[i]);
+                enabled.assign(satisfiable.begin(), satisfiable.end());
+            }
+        }
+        for (const std::string &arch : enabled)
+            arch_defects.emplace(arch, "");
+        if (!canonical.empty())
+            SatResultCache::store(canonical, defect);
+    }
+
+    StringJoiner formula;
+    if (refuted) {
+        // the checks only see a slice of the model, the fixed items make the formula unsatisfiable
+        formula.push_back(checks[0]);
+        formula.push_back(model->getBackboneConstraints(_codeExp));
+        return {defect, formula.join("\n&&\n"), arch_defects};
+    }
+    for (unsigned int i = 0; i < checks.size() && !defect.empty(); i++) {
+        formula.push_back(checks[i]);
+        if (defects[i] == defect)
+            return {defect, formula.join("\n&&\n"), arch_defects};
+    }
+    return {"", "", arch_defects};
+}
+
+bool BlockDefect::applyModelResult(const ConfigurationModel *model, const ModelResult &result) {
+    // a merged model reports the defect of each of its architectures
+    for (const auto &entry : result.archs)  // pair<string, string>
+        defectMap.emplace(entry.first, entry.second.empty() ? "none" : entry.second);
+
+    // the formula of the report is only formatted for defects
+    _formula.clear();
+    if (result.defect == "")
+        return false;
+
+    StringJoiner formula;
+    formula.push_back(codeFormula());
+    formula.push_back(result.formula);
+    _formula = formula.join("\n&&\n");
+    if (result.defect == "kconfig") {
+        if (_defectType != DEFECTTYPE::BuildSystem)
+            _defectType = DEFECTTYPE::Configuration;
+    } else if (result.defect == "kbuild") {
+        _defectType = DEFECTTYPE::BuildSystem;
+    } else if (_defectType != DEFECTTYPE::Configuration
+               && _defectType != DEFECTTYPE::BuildSystem) {
+        _defectType = DEFECTTYPE::Referential;
+    }
+    if (result.archs.empty())
+        defectMap.emplace(ModelContainer::lookupArch(model), result.defect);
+    return true;
+}
+
+void BlockDefect::crosscheck(const ConfigurationModel *main_model, const FileBudget &budget) {
+    std::vector<const ConfigurationModel *> models;
+    for (const auto &entry : ModelContainer::getInstance()) { // pair<string, ConfigurationModel *>
+        // don't check the main model twice
+        if (entry.second != main_model)
+            models.push_back(entry.second);
+    }
+    // fill the lazily computed caches of the block before using it from several threads
+    _cb->getCodeConstraints();
+    _cb->getCodeConstraintExp();
+    _cb->getBuildSystemCondition();
+
+    // Each thread checks every n-th model, so a model is only loaded into the checkers of
+    // one thread. As soon as the block isn't defective on one model, later models don't
+    // need to be checked anymore.
+    const bool parallel = crosscheck_threads > 1 && models.size() > 1;
+    const size_t stride = parallel ? crosscheckPool().size() : 1;
+    std::vector<ModelResult> results(models.size());
+    std::atomic<size_t> cutoff(models.size());
+    std::exception_ptr error;
+    std::mutex error_mutex;
+    std::function<void(unsigned int)> worker = [&](unsigned int slot) {
+        for (size_t i = slot; i < cutoff; i += stride) {
+            try {
+                budget.check();
+                results[i] = checkModel(models[i]);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(error_mutex);
+                if (!error)
+                    error = std::current_exception();
+                cutoff = 0;
+                return;
+            }
+            if (results[i].defect == "") {
+                size_t c = cutoff;
+                while (i < c && !cutoff.compare_exchange_weak(c, i)) {}
+            }
+        }
+    };
+    if (parallel)
+        crosscheckPool().run(worker);
+    else
+        worker(0);
+    if (error)
+        std::rethrow_exception(error);
+
+    // apply the results like a serial check in container order would have done it
+    for (size_t i = 0; i < models.size(); i++)
+        if (!applyModelResult(models[i], results[i]))
+            return;
+    markAsGlobal();
+}
+
 /************************************************************************/
 /* DeadBlockDefect                                                      */
 /************************************************************************/
@@ -267,83 +748,35 @@ void DeadBlockDefect::reportMUS(ConfigurationModel *main_model) const {
     sc.writeMUS(ofs);
 }
 
-bool DeadBlockDefect::isDefect(const ConfigurationModel *model, bool is_main_model) {
+std::string DeadBlockDefect::codeFormula() const {
     StringJoiner formula;
-
-    std::string code_formula = _cb->getCodeConstraints();
     formula.push_back(_cb->getName());
-    formula.push_back(code_formula);
-    _formula = formula.join("\n&&\n");
+    formula.push_back(_cb->getCodeConstraints());
+    return formula.join("\n&&\n");
+}
+
+bool DeadBlockDefect::isDefect(const ConfigurationModel *model, bool is_main_model) {
+    kconfig::BoolExp *code = _cb->getCodeConstraintExp();
+    setCodeExp(B_AND(B_VAR(_cb->getName(), false), code->retain()));
 
     // check for code defect
     SatChecker sc;
-    if (!sc(_formula)) {
+    if (!sc(_codeExp)) {
         _defectType = DEFECTTYPE::Implementation;
         _isGlobal = true;
-        _musFormula = _formula;
+        _musFormula = getFormula();
         return true;
     }
     // we don't have a model, no further analyses possible
     if (!model)
         return false;
 
-    // check for kconfig defect
-    std::set<std::string> missingSet;
-    std::string kconfig_formula;
-    std::set<std::string> kconfigItems = model->doIntersect(code_formula,
-                                                            _cb->getFile()->getDefineChecker(),
-                                                            missingSet, kconfig_formula);
-    formula.push_back(kconfig_formula);
-
-    // increment sc with kconfig_formula and load model if necessary
-    if (model->getModelVersionIdentifier() == "cnf")
-        sc.loadCnfModel(model);
-    if (!sc(kconfig_formula)) {
-        _formula = formula.join("\n&&\n");
-        // save formula for mus analysis when we are analysing the main_model
-        if (is_main_model)
-            _musFormula = _formula;
-        if (_defectType != DEFECTTYPE::BuildSystem)
-            _defectType = DEFECTTYPE::Configuration;
-        defectMap.emplace(ModelContainer::lookupArch(model), "kconfig");
-        return true;
-    }
-
-    // check for kbuild defect
-    std::string precondition = _cb->getBuildSystemCondition();
-    std::string precondition_formula;
-    model->doIntersect(precondition, nullptr, missingSet, precondition_formula, &kconfigItems);
-    if (precondition_formula.size() > 0)
-        precondition_formula += "\n&& ";
-    precondition_formula += precondition;
-    formula.push_back(precondition_formula);
-    if (!sc(precondition_formula)) {
-        _formula = formula.join("\n&&\n");
-        if (is_main_model)
-            _musFormula = _formula;
-        _defectType = DEFECTTYPE::BuildSystem;
-        defectMap.emplace(ModelContainer::lookupArch(model), "kbuild");
-        return true;
-    }
-
-    // An incomplete model (not all symbols mentioned) can't generate referential errors
-    if (!model->isComplete())
+    if (!applyModelResult(model, checkModel(model)))
         return false;
-
-    // check for missing defect
-    std::string missing = ConfigurationModel::getMissingItemsConstraints(missingSet);
-    if (!sc(missing)) {
-        formula.push_back(missing);
-        _formula = formula.join("\n&&\n");
-        if (_defectType != DEFECTTYPE::Configuration && _defectType != DEFECTTYPE::BuildSystem)
-            _defectType = DEFECTTYPE::Referential;
-        defectMap.emplace(ModelContainer::lookupArch(model), "missing");
-        // save formula for mus analysis when we are analysing the main_model
-        if (is_main_model)
-            _musFormula = _formula;
-        return true;
-    }
-    return false;
+    // save formula for mus analysis when we are analysing the main_model
+    if (is_main_model)
+        _musFormula = getFormula();
+    return true;
 }
 
 /************************************************************************/
@@ -354,22 +787,27 @@ UndeadBlockDefect::UndeadBlockDefect(ConditionalBlock *cb) : BlockDefect(cb) {
     this->_suffix = "undead";
 }
 
-bool UndeadBlockDefect::isDefect(const ConfigurationModel *model, bool) {
+std::string UndeadBlockDefect::codeFormula() const {
     StringJoiner formula;
+    formula.push_back("( " + _cb->getParent()->getName() + " && ! " + _cb->getName() + " )");
+    formula.push_back(_cb->getCodeConstraints());
+    return formula.join("\n&&\n");
+}
+
+bool UndeadBlockDefect::isDefect(const ConfigurationModel *model, bool) {
     const ConditionalBlock *parent = _cb->getParent();
 
     // no parent -> it's B00 -> impossible to be undead
     if (!parent)
         return false;
 
-    std::string code_formula = _cb->getCodeConstraints();
-    formula.push_back("( " + parent->getName() + " && ! " + _cb->getName() + " )");
-    formula.push_back(code_formula);
-    _formula = formula.join("\n&&\n");
+    kconfig::BoolExp *code = _cb->getCodeConstraintExp();
+    setCodeExp(B_AND(B_AND(B_VAR(parent->getName(), false), B_NOT(B_VAR(_cb->getName(), false))),
+                     code->retain()));
 
     // check for code defect
     SatChecker sc;
-    if (!sc(_formula)) {
+    if (!sc(_codeExp)) {
         _defectType = DEFECTTYPE::Implementation;
         _isGlobal = true;
         return true;
@@ -378,53 +816,5 @@ bool UndeadBlockDefect::isDefect(const ConfigurationModel *model, bool) {
     if (!model)
         return false;
 
-    // check for kconfig defect
-    std::set<std::string> missingSet;
-    std::string kconfig_formula;
-    std::set<std::string> kconfigItems = model->doIntersect(code_formula,
-                                                            _cb->getFile()->getDefineChecker(),
-                                                            missingSet, kconfig_formula);
-    formula.push_back(kconfig_formula);
-
-    // increment sc with kconfig_formula and load model if necessary
-    if (model->getModelVersionIdentifier() == "cnf")
-        sc.loadCnfModel(model);
-    if (!sc(kconfig_formula)) {
-        _formula = formula.join("\n&&\n");
-        if (_defectType != DEFECTTYPE::BuildSystem)
-            _defectType = DEFECTTYPE::Configuration;
-        defectMap.emplace(ModelContainer::lookupArch(model), "kconfig");
-        return true;
-    }
-
-    // check for kbuild defect
-    std::string precondition = _cb->getBuildSystemCondition();
-    std::string precondition_formula;
-    model->doIntersect(precondition, nullptr, missingSet, precondition_formula, &kconfigItems);
-    if (precondition_formula.size() > 0)
-        precondition_formula += "\n&& ";
-    precondition_formula += precondition;
-    formula.push_back(precondition_formula);
-    if (!sc(precondition_formula)) {
-        _formula = formula.join("\n&&\n");
-        _defectType = DEFECTTYPE::BuildSystem;
-        defectMap.emplace(ModelContainer::lookupArch(model), "kbuild");
-        return true;
-    }
-
-    // An incomplete model (not all symbols mentioned) can't generate referential errors
-    if (!model->isComplete())
-        return false;
-
-    // check for missing defect
-    std::string missing = ConfigurationModel::getMissingItemsConstraints(missingSet);
-    if (!sc(missing)) {
-        formula.push_back(missing);
-        _formula = formula.join("\n&&\n");
-        if (_defectType != DEFECTTYPE::Configuration && _defectType != DEFECTTYPE::BuildSystem)
-            _defectType = DEFECTTYPE::Referential;
-        defectMap.emplace(ModelContainer::lookupArch(model), "missing");
-        return true;
-    }
-    return false;
+    return applyModelResult(model, checkModel(model));
 }
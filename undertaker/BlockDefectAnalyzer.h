@@ -36,10 +36,16 @@
 
 #include <string>
 #include <map>
+#include <list>
 
+class CppFile;
 class ConditionalBlock;
 class ConfigurationModel;
 class BlockDefect;
+class FileBudget;
+namespace kconfig {
+    class BoolExp;
+}
 
 
 /************************************************************************/
@@ -47,8 +53,44 @@ class BlockDefect;
 /************************************************************************/
 
 namespace BlockDefectAnalyzer {
-    const BlockDefect *analyzeBlock(ConditionalBlock *, ConfigurationModel *);
+    /**
+     * \brief checks the block for a dead or undead defect
+     *
+     * \return the defect, nullptr if the block is fine or couldn't be processed
+     * \throws SatBudgetExceeded if a check or the time of the file ran out of its budget
+     */
+    const BlockDefect *analyzeBlock(ConditionalBlock *, ConfigurationModel *, const FileBudget &);
     std::string getBlockPrecondition(ConditionalBlock *, const ConfigurationModel *);
+
+    /**
+     * \brief blocks of a file that might be dead or undead
+     *
+     * The constraints of the whole file (code, kconfig, kbuild and missing)
+     * are encoded only once. Each block is checked on this formula by
+     * assuming the block (dead) or its parent and the negated block
+     * (undead). Since the formula of every single check in analyzeBlock()
+     * is a part of the file formula, blocks that pass both checks can't be
+     * defective and are filtered out.
+     *
+     * \return the blocks of the file, including the top block, that need
+     *     an analysis with analyzeBlock(), in file order. All of them if a
+     *     check or the time of the file runs out of budget.
+     */
+    std::list<ConditionalBlock *> getDefectCandidates(CppFile *, const ConfigurationModel *,
+                                                      const FileBudget &);
+
+    //! number of threads checking a defect on the other models (default: 1)
+    void setCrosscheckThreads(unsigned int);
+
+    /**
+     * \brief writes $block.unknown for a block whose analysis ran out of budget
+     *
+     * The report starts with the same location line as a defect report,
+     * followed by the reason.
+     */
+    void writeUnknownReport(ConditionalBlock *, const std::string &reason);
+    //! writes $file.unknown for a file whose analysis was abandoned as a whole
+    void writeUnknownReport(const std::string &filename, const std::string &reason);
 } // namespace BlockDefectAnalyzer
 
 class BlockDefect {
@@ -57,7 +99,9 @@ public:
 
     virtual bool isDefect(const ConfigurationModel *, bool = false) = 0;  //!< checks for a defect
     virtual void reportMUS(ConfigurationModel *) const = 0;
-    virtual ~BlockDefect() {}
+    virtual ~BlockDefect();
+    BlockDefect(const BlockDefect &) = delete;
+    BlockDefect &operator=(const BlockDefect &) = delete;
 
     //!< human readable identifier for the defect type
     const std::string defectTypeToString() const;
@@ -68,6 +112,18 @@ public:
     bool isGlobal() const { return _isGlobal; }  //!< return if the defect applies to all models
     void markAsGlobal() { _isGlobal = true; }    //!< mark defect als valid on all models
     bool needsCrosscheck() const;  //!< defect will be present on every model
+    /**
+     * \brief checks the defect on all models but the main model
+     *
+     * The models are checked in parallel. Apart from that, the result is the
+     * same as calling isDefect() for each model in container order, until the
+     * first model without the defect. If all models have the defect, it is
+     * marked as global. A model merged by 'rsf2cnf -a' reports the defect of
+     * each of its architectures, "none" for those that don't have it.
+     *
+     * \throws SatBudgetExceeded if a check or the time of the file ran out of its budget
+     */
+    void crosscheck(const ConfigurationModel *main_model, const FileBudget &budget);
     std::string getDefectReportFilename() const;
     bool isNoKconfigDefect(const ConfigurationModel *model) const;
 
@@ -96,9 +152,36 @@ public:
 
 protected:
     explicit BlockDefect(ConditionalBlock *cb) : _cb(cb) {}
+
+    //! the outcome of the model dependent checks on one model
+    struct ModelResult {
+        std::string defect;   //!< "kconfig", "kbuild", "missing" or "" if there is none
+        std::string formula;  //!< the model dependent formulas up to the defect
+        //! defect per architecture of a model merged by 'rsf2cnf -a', "" if there is none
+        std::map<std::string, std::string> archs;
+    };
+    /**
+     * \brief checks _codeExp on the model
+     *
+     * Doesn't modify the defect, so it may be called for several models
+     * at the same time.
+     */
+    ModelResult checkModel(const ConfigurationModel *) const;
+    //! records the result of checkModel(), \return true if it is a defect
+    bool applyModelResult(const ConfigurationModel *, const ModelResult &);
+    //! sets the expression of the code check, takes over the reference
+    void setCodeExp(kconfig::BoolExp *);
+    //! \return the code check as formula, which is only formatted for reports
+    virtual std::string codeFormula() const = 0;
+    //! \return the formula of the report
+    std::string getFormula() const { return _formula.empty() ? codeFormula() : _formula; }
+
     DEFECTTYPE _defectType = DEFECTTYPE::None;
     bool _isGlobal = false;
 
+    //! the expression of the code check, see setCodeExp()
+    kconfig::BoolExp *_codeExp = nullptr;
+    //! the formula of the report, empty if it is codeFormula()
     std::string _formula;
     std::string _suffix;
     ConditionalBlock *_cb = nullptr;
@@ -119,6 +202,9 @@ public:
     explicit DeadBlockDefect(ConditionalBlock *);
     bool isDefect(const ConfigurationModel *, bool = false) final override;
     void reportMUS(ConfigurationModel *) const final override;
+
+protected:
+    std::string codeFormula() const final override;
 };
 
 /************************************************************************/
@@ -132,6 +218,9 @@ public:
     explicit UndeadBlockDefect(ConditionalBlock *);
     bool isDefect(const ConfigurationModel *, bool = false) final override;
     void reportMUS(ConfigurationModel *) const final override {}
+
+protected:
+    std::string codeFormula() const final override;
 };
 
 #endif
@@ -0,0 +1,73 @@
+// -*- mode: c++ -*-
+/*
+ *   undertaker - analyze preprocessor blocks in code
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef boolexp_joiner_h__
+#define boolexp_joiner_h__
+
+#include "bool.h"
+
+#include <unordered_set>
+#include <vector>
+
+
+/**
+ * \brief conjunction of expressions, the counterpart of UniqueStringJoiner
+ *
+ * Expressions are hash-consed, hence equal expressions are the same node
+ * and the conjuncts are kept unique by comparing pointers. The joiner holds
+ * a reference to each of its conjuncts.
+ */
+class BoolExpJoiner {
+    std::vector<kconfig::BoolExp *> _conjuncts;
+    std::unordered_set<const kconfig::BoolExp *> _unique;
+
+public:
+    BoolExpJoiner() = default;
+    BoolExpJoiner(const BoolExpJoiner &) = delete;
+    BoolExpJoiner &operator=(const BoolExpJoiner &) = delete;
+
+    ~BoolExpJoiner() {
+        for (kconfig::BoolExp *e : _conjuncts)
+            e->release();
+    }
+
+    //! appends the expression unless it is already a conjunct, takes over the reference
+    void push_back(kconfig::BoolExp *e) {
+        if (_unique.insert(e).second)
+            _conjuncts.push_back(e);
+        else
+            e->release();
+    }
+
+    size_t size() const { return _conjuncts.size(); }
+
+    /**
+     * \brief joins the conjuncts like the parser joins 'a && b && c'
+     *
+     * \return a new reference to the conjunction, true if it is empty
+     */
+    kconfig::BoolExp *join() const {
+        if (_conjuncts.empty())
+            return B_CONST(true);
+        kconfig::BoolExp *result = _conjuncts.front()->retain();
+        for (auto it = _conjuncts.begin() + 1; it != _conjuncts.end(); ++it)
+            result = B_AND(result, (*it)->retain());
+        return result;
+    }
+};
+#endif
@@ -19,37 +19,39 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
  */
 
+// the scanner of the flex/bison parser, only built for bench-BoolExpParser
 
-#ifndef KCONFIG_BOOLEXPLEXER_H
-#define KCONFIG_BOOLEXPLEXER_H
+#ifndef KCONFIG_BOOLEXPLEGACYLEXER_H
+#define KCONFIG_BOOLEXPLEGACYLEXER_H
 
 #ifndef YY_DECL
 
 #define YY_DECL                                                                                   \
-    kconfig::BoolExpParser::token_type kconfig::BoolExpLexer::lex(                                \
-        kconfig::BoolExpParser::semantic_type *yylval,                                            \
-        kconfig::BoolExpParser::location_type *yylloc)
+    kconfig::BoolExpLegacyParser::token_type kconfig::BoolExpLegacyLexer::lex(                    \
+        kconfig::BoolExpLegacyParser::semantic_type *yylval,                                      \
+        kconfig::BoolExpLegacyParser::location_type *yylloc)
 #endif
 
 #ifndef __FLEX_LEXER_H
-#define yyFlexLexer KconfigFlexLexer
+#define yyFlexLexer LegacyFlexLexer
 #include "FlexLexer.h"
 #undef yyFlexLexer
 #endif
 
 #include <list>
 
-#include "BoolExpParser.h"
+#include "BoolExpLegacyParser.h"
 
 namespace kconfig {
-    class BoolExpLexer : public KconfigFlexLexer {
+    class BoolExpLegacyLexer : public LegacyFlexLexer {
     public:
-        explicit BoolExpLexer(std::istream *arg_yyin = nullptr, std::ostream *arg_yyout = nullptr);
+        explicit BoolExpLegacyLexer(std::istream *arg_yyin = nullptr,
+                                    std::ostream *arg_yyout = nullptr);
 
-        virtual ~BoolExpLexer();
+        virtual ~BoolExpLegacyLexer();
 
-        BoolExpParser::token_type lex(BoolExpParser::semantic_type *yylval,
-                                      BoolExpParser::location_type *yylloc);
+        BoolExpLegacyParser::token_type lex(BoolExpLegacyParser::semantic_type *yylval,
+                                            BoolExpLegacyParser::location_type *yylloc);
 
         void set_debug(bool b);
     };
@@ -18,14 +18,20 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
  */
 
+/*
+ * The flex/bison parser that BoolExp::parseString() used before BoolExpParser.
+ * It is only built for bench-BoolExpParser, which compares the two.
+ */
+
 %{
 
 #include <stdio.h>
 #include <string>
 #include <list>
 
+#include <stdexcept>
+
 #include "bool.h"
-#include "exceptions/BoolExpParserException.h"
 
 %}
 
@@ -38,12 +44,12 @@
 %skeleton "lalr1.cc"
 
 %name-prefix "kconfig"
-%define parser_class_name {BoolExpParser}
+%define parser_class_name {BoolExpLegacyParser}
 
 %locations
 
 %parse-param { class BoolExp **result }
-%parse-param { class BoolExpLexer *lexer }
+%parse-param { class BoolExpLegacyLexer *lexer }
 
 %error-verbose
 
@@ -68,11 +74,12 @@
 %type <paramList>    ParamList
 
 %destructor { delete $$; } STRING
-%destructor { delete $$; } Const
-%destructor { delete $$; } Atom Literal AndExpr OrExpr ImplExpr EqExpr CExpr Expr ParamList
+%destructor { $$->release(); } Const
+%destructor { $$->release(); } Atom Literal AndExpr OrExpr ImplExpr EqExpr CExpr Expr
+%destructor { for (BoolExp *e : *$$) e->release(); delete $$; } ParamList
 
 %{
-#include "BoolExpLexer.h"
+#include "BoolExpLegacyLexer.h"
 
 #undef yylex
 #define yylex this->lexer->lex
@@ -85,8 +92,8 @@ Const :    TTRUE                {$$ = B_CONST(true);}
          ;
 
 Atom :     Const               {$$ = $1;}
-         | STRING '(' ParamList ')'  {$$ = new BoolExpCall(*$1, $3); delete $1;}
-         | STRING              {$$ = new BoolExpVar(*$1, false); delete $1;}
+         | STRING '(' ParamList ')'  {$$ = BoolExpCall::make(*$1, $3); delete $1;}
+         | STRING              {$$ = B_VAR(*$1, false); delete $1;}
          | '(' Expr ')'        {$$ = $2;}
          ;
 
@@ -96,27 +103,27 @@ ParamList : /*void*/            { $$ = new std::list<BoolExp *>();}
           ;
 
 Literal : Atom                 {$$ = $1;}
-         | '!' Literal         {$$ = new BoolExpNot($2);}
+         | '!' Literal         {$$ = B_NOT($2);}
          ;
 
 CExpr : Literal                {$$ = $1;}
-      | CExpr TCOP Literal     {$$ = new BoolExpAny(*$2, $1, $3); delete $2;}
+      | CExpr TCOP Literal     {$$ = BoolExpAny::make(*$2, $1, $3); delete $2;}
       ;
 
 AndExpr : CExpr                {$$ = $1;}
-        | AndExpr TAND CExpr   {$$ = new BoolExpAnd($1, $3);}
+        | AndExpr TAND CExpr   {$$ = B_AND($1, $3);}
         ;
 
 OrExpr : AndExpr               {$$ = $1;}
-       | OrExpr TOR AndExpr    { $$ = new BoolExpOr($1, $3);}
+       | OrExpr TOR AndExpr    { $$ = B_OR($1, $3);}
        ;
 
 ImplExpr :OrExpr               {$$ = $1;}
-       | ImplExpr TIMPL OrExpr { $$ = new BoolExpImpl($1, $3);}
+       | ImplExpr TIMPL OrExpr { $$ = B_IMPL($1, $3);}
        ;
 
 EqExpr : ImplExpr              {$$ = $1;}
-       | EqExpr TEQ ImplExpr   { $$ = new BoolExpEq($1, $3);}
+       | EqExpr TEQ ImplExpr   { $$ = BoolExpEq::make($1, $3);}
        ;
 
 Expr    : EqExpr               {$$ = $1;}
@@ -125,6 +132,7 @@ Expr    : EqExpr               {$$ = $1;}
 Line    : Expr END             { *(this->result) = $1;}
         ;
 %%
-void kconfig::BoolExpParser::error(const BoolExpParser::location_type&, const std::string& msg){
-    throw new BoolExpParserException(msg);
+void kconfig::BoolExpLegacyParser::error(const BoolExpLegacyParser::location_type&,
+                                         const std::string& msg){
+    throw std::runtime_error(msg);
 }
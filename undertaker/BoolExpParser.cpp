@@ -0,0 +1,300 @@
+/*
+ *   boolean framework for undertaker and satyr
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "BoolExpParser.h"
+
+#include <list>
+
+using kconfig::BoolExp;
+using kconfig::BoolExpParser;
+
+typedef BoolExpParser::TokenType TokenType;
+
+
+namespace {
+    // the binary operators, from the lowest to the highest precedence
+    const TokenType operators[] = {TokenType::EQ, TokenType::IMPL, TokenType::OR, TokenType::AND,
+                                   TokenType::C_OPERATOR};
+    const int levels = sizeof(operators) / sizeof(operators[0]);
+
+    bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+    bool isHexDigit(char c) {
+        return isDigit(c) || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+    }
+
+    bool isNameStart(char c) {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || c == '.';
+    }
+
+    bool isNameChar(char c) { return isNameStart(c) || isDigit(c); }
+
+    /*
+     * The parser is generic over what it makes of the expression. Each
+     * builder defines the type of the (partial) results, which evaluate to
+     * false on syntax errors, and releases the results it doesn't need anymore.
+     */
+
+    // builds the expression
+    struct TreeBuilder {
+        typedef BoolExp *Node;
+        typedef std::list<BoolExp *> *Params;
+
+        Node constant(bool value) { return B_CONST(value); }
+        Node variable(const BoolExpParser::Token &name) { return B_VAR(name.str(), false); }
+        Node negation(Node e) { return B_NOT(e); }
+
+        Node binary(const BoolExpParser::Token &op, Node l, Node r) {
+            switch (op.type) {
+            case TokenType::EQ:
+                return kconfig::BoolExpEq::make(l, r);
+            case TokenType::IMPL:
+                return B_IMPL(l, r);
+            case TokenType::OR:
+                return B_OR(l, r);
+            case TokenType::AND:
+                return B_AND(l, r);
+            default:
+                return kconfig::BoolExpAny::make(op.str(), l, r);
+            }
+        }
+
+        Params params() { return new std::list<BoolExp *>(); }
+        void addParam(Params params, Node e) { params->push_back(e); }
+
+        Node call(const BoolExpParser::Token &name, Params params) {
+            return kconfig::BoolExpCall::make(name.str(), params);
+        }
+
+        void release(Node e) { e->release(); }
+
+        void release(Params params) {
+            for (BoolExp *e : *params)
+                e->release();
+            delete params;
+        }
+    };
+
+    // only collects the variables
+    struct ItemCollector {
+        typedef bool Node;
+        typedef bool Params;
+
+        std::set<std::string> &items;
+
+        explicit ItemCollector(std::set<std::string> &items) : items(items) {}
+
+        Node constant(bool) { return true; }
+
+        Node variable(const BoolExpParser::Token &name) {
+            items.emplace(name.text, name.length);
+            return true;
+        }
+
+        Node negation(Node) { return true; }
+        Node binary(const BoolExpParser::Token &, Node, Node) { return true; }
+        Params params() { return true; }
+        void addParam(Params, Node) {}
+        Node call(const BoolExpParser::Token &, Params) { return true; }
+        void release(Node) {}
+    };
+} // namespace
+
+BoolExpParser::BoolExpParser(const std::string &input)
+        : pos(input.data()), end(input.data() + input.size()) {}
+
+void BoolExpParser::next() {
+    while (pos < end && (*pos == ' ' || *pos == '\t' || *pos == '\r' || *pos == '\n'))
+        pos++;
+    token.text = pos;
+    token.type = TokenType::INVALID;
+    if (pos == end) {
+        token.type = TokenType::END;
+        token.length = 0;
+        return;
+    }
+    // as with a scanner generator, the longest token wins
+    auto follows = [this](const char *s) {
+        size_t i = 0;
+        for (; s[i]; i++)
+            if (pos + i >= end || pos[i] != s[i])
+                return false;
+        pos += i;
+        return true;
+    };
+    const char c = *pos;
+    if (isNameStart(c)) {
+        while (++pos < end && isNameChar(*pos))
+            ;
+        token.type = TokenType::NAME;
+    } else if (isDigit(c)) {
+        if (c == '0' && end - pos > 2 && pos[1] == 'x' && isHexDigit(pos[2])) {
+            pos += 2;
+            while (pos < end && isHexDigit(*pos))
+                pos++;
+            token.type = TokenType::CONST_TRUE;
+        } else {
+            while (pos < end && isDigit(*pos))
+                pos++;
+            token.type = (pos - token.text == 1 && c == '0') ? TokenType::CONST_FALSE
+                                                             : TokenType::CONST_TRUE;
+        }
+        // integer suffix u?[lL]{0,2}
+        if (pos < end && *pos == 'u')
+            pos++;
+        for (int i = 0; i < 2 && pos < end && (*pos == 'l' || *pos == 'L'); i++)
+            pos++;
+    } else if (c == '\'' && end - pos >= 3 && pos[1] != '\n' && pos[2] == '\'') {
+        pos += 3;
+        token.type = TokenType::CONST_TRUE;
+    } else if (follows("||")) {
+        token.type = TokenType::OR;
+    } else if (follows("&&")) {
+        token.type = TokenType::AND;
+    } else if (follows("<->")) {
+        token.type = TokenType::EQ;
+    } else if (follows("->")) {
+        token.type = TokenType::IMPL;
+    } else if (follows("<<<") || follows("<<") || follows(">=") || follows("<=")
+               || follows("==") || follows("!=") || follows(">>")) {
+        token.type = TokenType::C_OPERATOR;
+    } else {
+        pos++;
+        switch (c) {
+        case '?': case ':': case '&': case '|': case '>': case '<':
+        case '*': case '/': case '+': case '-': case '%':
+            token.type = TokenType::C_OPERATOR;
+            break;
+        case '(':
+            token.type = TokenType::LPAREN;
+            break;
+        case ')':
+            token.type = TokenType::RPAREN;
+            break;
+        case ',':
+            token.type = TokenType::COMMA;
+            break;
+        case '!':
+            token.type = TokenType::NOT;
+            break;
+        }
+    }
+    token.length = pos - token.text;
+}
+
+template <class Builder>
+typename Builder::Node BoolExpParser::binary(Builder &builder, int level) {
+    if (level == levels)
+        return literal(builder);
+    typename Builder::Node left = binary(builder, level + 1);
+    while (left && token.type == operators[level]) {
+        const Token op = token;
+        next();
+        typename Builder::Node right = binary(builder, level + 1);
+        if (!right) {
+            builder.release(left);
+            return right;
+        }
+        left = builder.binary(op, left, right);
+    }
+    return left;
+}
+
+template <class Builder>
+typename Builder::Node BoolExpParser::literal(Builder &builder) {
+    if (token.type != TokenType::NOT)
+        return atom(builder);
+    next();
+    typename Builder::Node e = literal(builder);
+    return e ? builder.negation(e) : e;
+}
+
+template <class Builder>
+typename Builder::Node BoolExpParser::atom(Builder &builder) {
+    const Token t = token;
+    switch (t.type) {
+    case TokenType::CONST_TRUE:
+    case TokenType::CONST_FALSE:
+        next();
+        return builder.constant(t.type == TokenType::CONST_TRUE);
+    case TokenType::NAME:
+        next();
+        if (token.type != TokenType::LPAREN)
+            return builder.variable(t);
+        next();
+        return call(builder, t);
+    case TokenType::LPAREN: {
+        next();
+        typename Builder::Node e = binary(builder, 0);
+        if (!e)
+            return e;
+        if (token.type != TokenType::RPAREN) {
+            builder.release(e);
+            return typename Builder::Node();
+        }
+        next();
+        return e;
+    }
+    default:
+        return typename Builder::Node();
+    }
+}
+
+template <class Builder>
+typename Builder::Node BoolExpParser::call(Builder &builder, const Token &name) {
+    typename Builder::Params params = builder.params();
+    auto param = [&]() {
+        typename Builder::Node e = binary(builder, 0);
+        if (e)
+            builder.addParam(params, e);
+        return bool(e);
+    };
+    // the first parameter may be left out, as in 'f()' or 'f(, x)'
+    bool ok = token.type == TokenType::COMMA || token.type == TokenType::RPAREN || param();
+    while (ok && token.type == TokenType::COMMA) {
+        next();
+        ok = param();
+    }
+    if (!ok || token.type != TokenType::RPAREN) {
+        builder.release(params);
+        return typename Builder::Node();
+    }
+    next();
+    return builder.call(name, params);
+}
+
+template <class Builder>
+typename Builder::Node BoolExpParser::line(Builder &builder) {
+    next();
+    typename Builder::Node e = binary(builder, 0);
+    if (e && token.type != TokenType::END) {
+        builder.release(e);
+        return typename Builder::Node();
+    }
+    return e;
+}
+
+BoolExp *BoolExpParser::parse() {
+    TreeBuilder builder;
+    return line(builder);
+}
+
+bool BoolExpParser::parseItems(std::set<std::string> &items) {
+    ItemCollector builder(items);
+    return line(builder);
+}
@@ -0,0 +1,165 @@
+/*
+ *   boolean framework for undertaker and satyr
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "BoolExpPropagator.h"
+
+#include <utility>
+#include <vector>
+
+namespace {
+    // the results of the visited nodes point to one of these, unknown values are nullptr
+    const bool yes = true, no = false;
+
+    void *valueOf(bool value) {
+        return const_cast<bool *>(value ? &yes : &no);
+    }
+} // namespace
+
+bool kconfig::BoolExpPropagator::assign(const std::string &name, bool value) {
+    return values.emplace(name, value).first->second == value;
+}
+
+bool kconfig::BoolExpPropagator::propagate(BoolExp *e) {
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        // the values of the nodes may depend on the new assignments
+        forget();
+        if (!require(e, true, changed))
+            return false;
+    }
+    return true;
+}
+
+const bool *kconfig::BoolExpPropagator::evaluate(BoolExp *e) {
+    e->accept(this);
+    return static_cast<const bool *>(this->result);
+}
+
+bool kconfig::BoolExpPropagator::require(BoolExp *e, bool value, bool &changed) {
+    // iteratively, as long chains of && would overflow the stack
+    std::vector<std::pair<BoolExp *, bool>> stack{{e, value}};
+    while (!stack.empty()) {
+        BoolExp *node = stack.back().first;
+        const bool v = stack.back().second;
+        stack.pop_back();
+
+        if (BoolExpVar *var = dynamic_cast<BoolExpVar *>(node)) {
+            // the values of the nodes evaluated before may not know this assignment yet
+            auto entry = values.emplace(var->getName(), v);
+            if (entry.first->second != v)
+                return false;
+            changed |= entry.second;
+            continue;
+        }
+        const bool *known = evaluate(node);
+        if (known) {
+            if (*known != v)
+                return false;
+            continue;
+        }
+        if (dynamic_cast<BoolExpNot *>(node)) {
+            stack.emplace_back(node->right, !v);
+        } else if (dynamic_cast<BoolExpAnd *>(node)) {
+            if (v) {
+                stack.emplace_back(node->right, true);
+                stack.emplace_back(node->left, true);
+            }
+        } else if (dynamic_cast<BoolExpOr *>(node)) {
+            if (!v) {
+                stack.emplace_back(node->right, false);
+                stack.emplace_back(node->left, false);
+            }
+        } else if (dynamic_cast<BoolExpImpl *>(node)) {
+            if (!v) {
+                stack.emplace_back(node->right, false);
+                stack.emplace_back(node->left, true);
+            }
+        } else if (dynamic_cast<BoolExpEq *>(node)) {
+            // one side is known at most, otherwise the node would be known as well
+            if (const bool *left = evaluate(node->left))
+                stack.emplace_back(node->right, *left == v);
+            else if (const bool *right = evaluate(node->right))
+                stack.emplace_back(node->left, *right == v);
+        }
+    }
+    return true;
+}
+
+void kconfig::BoolExpPropagator::visit(BoolExp *) {
+    this->result = nullptr;
+}
+
+void kconfig::BoolExpPropagator::visit(BoolExpAnd *) {
+    const bool *left = static_cast<const bool *>(this->left);
+    const bool *right = static_cast<const bool *>(this->right);
+    if ((left && !*left) || (right && !*right))
+        this->result = valueOf(false);
+    else if (left && right)
+        this->result = valueOf(true);
+}
+
+void kconfig::BoolExpPropagator::visit(BoolExpOr *) {
+    const bool *left = static_cast<const bool *>(this->left);
+    const bool *right = static_cast<const bool *>(this->right);
+    if ((left && *left) || (right && *right))
+        this->result = valueOf(true);
+    else if (left && right)
+        this->result = valueOf(false);
+}
+
+void kconfig::BoolExpPropagator::visit(BoolExpNot *) {
+    const bool *right = static_cast<const bool *>(this->right);
+    if (right)
+        this->result = valueOf(!*right);
+}
+
+void kconfig::BoolExpPropagator::visit(BoolExpConst *e) {
+    if (constPolicy == CNFBuilder::ConstantPolicy::BOUND)
+        this->result = valueOf(e->value);
+}
+
+void kconfig::BoolExpPropagator::visit(BoolExpVar *e) {
+    auto it = values.find(e->getName());
+    if (it != values.end())
+        this->result = valueOf(it->second);
+}
+
+void kconfig::BoolExpPropagator::visit(BoolExpImpl *) {
+    const bool *left = static_cast<const bool *>(this->left);
+    const bool *right = static_cast<const bool *>(this->right);
+    if ((left && !*left) || (right && *right))
+        this->result = valueOf(true);
+    else if (left && right)
+        this->result = valueOf(false);
+}
+
+void kconfig::BoolExpPropagator::visit(BoolExpEq *) {
+    const bool *left = static_cast<const bool *>(this->left);
+    const bool *right = static_cast<const bool *>(this->right);
+    if (left && right)
+        this->result = valueOf(*left == *right);
+}
+
+void kconfig::BoolExpPropagator::visit(BoolExpCall *) {
+    this->result = nullptr;
+}
+
+void kconfig::BoolExpPropagator::visit(BoolExpAny *) {
+    this->result = nullptr;
+}
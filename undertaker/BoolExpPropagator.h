@@ -0,0 +1,73 @@
+/*
+ *   boolean framework for undertaker and satyr
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef KCONFIG_BOOLEXPPROPAGATOR_H
+#define KCONFIG_BOOLEXPPROPAGATOR_H
+
+#include "bool.h"
+#include "BoolVisitor.h"
+#include "CNFBuilder.h"
+
+#include <map>
+#include <string>
+
+namespace kconfig {
+    /**
+     * \brief decides expressions under a partial assignment, without a solver
+     *
+     * The nodes are evaluated with three values: true, false and unknown,
+     * the latter for unassigned variables, function calls and C operators.
+     * propagate() also assigns the values that an expression forces on its
+     * variables, like the unit propagation of a solver, until nothing
+     * changes. It only finds the contradictions that follow from such
+     * steps, hence it is no complete check.
+     */
+    class BoolExpPropagator : public BoolVisitor {
+        std::map<std::string, bool> values;
+        //! free constants are unknown, like the free variables CNFBuilder gives them
+        CNFBuilder::ConstantPolicy constPolicy;
+
+        //! \return the value of e, nullptr if it is unknown
+        const bool *evaluate(BoolExp *e);
+        //! assigns the values that give e the value, \return false on a contradiction
+        bool require(BoolExp *e, bool value, bool &changed);
+
+    public:
+        explicit BoolExpPropagator(
+            CNFBuilder::ConstantPolicy constPolicy = CNFBuilder::ConstantPolicy::BOUND)
+            : constPolicy(constPolicy) {}
+
+        //! \return false if the variable has the other value already
+        bool assign(const std::string &name, bool value);
+        //! \return false if the assignment contradicts e, the values forced by e are assigned
+        bool propagate(BoolExp *e);
+
+    protected:
+        void visit(BoolExp *e)      final override;
+        void visit(BoolExpAnd *e)   final override;
+        void visit(BoolExpOr *e)    final override;
+        void visit(BoolExpNot *e)   final override;
+        void visit(BoolExpConst *e) final override;
+        void visit(BoolExpVar *e)   final override;
+        void visit(BoolExpImpl *e)  final override;
+        void visit(BoolExpEq *e)    final override;
+        void visit(BoolExpCall *e)  final override;
+        void visit(BoolExpAny *e)   final override;
+    };
+} // namespace kconfig
+#endif
@@ -22,6 +22,28 @@
 #include "bool.h"
 #include "BoolExpSimplifier.h"
 
+namespace {
+    // C operators and function calls are simplified to nullptr
+    kconfig::BoolExp *ref(kconfig::BoolExp *e) {
+        return e ? e->retain() : nullptr;
+    }
+} // namespace
+
+kconfig::BoolExpSimplifier::~BoolExpSimplifier() {
+    for (BoolExp *e : owned)
+        e->release();
+}
+
+kconfig::BoolExp *kconfig::BoolExpSimplifier::getResult(void) const {
+    return ref(static_cast<BoolExp *>(this->result));
+}
+
+kconfig::BoolExp *kconfig::BoolExpSimplifier::own(BoolExp *e) {
+    if (e)
+        owned.push_back(e);
+    return e;
+}
+
 void kconfig::BoolExpSimplifier::visit(BoolExp *) {
     this->result = nullptr;
 }
@@ -31,15 +53,15 @@ void kconfig::BoolExpSimplifier::visit(BoolExpNot *) {
     BoolExpConst *constant = dynamic_cast<BoolExpConst*>(node);
     if (constant) {
         bool v = !constant->value;
-        this->result = B_CONST(v);
+        this->result = own(B_CONST(v));
         return;
     }
     BoolExpNot *notExpr = dynamic_cast<BoolExpNot*>(node);
     if (notExpr) {
-        this->result = notExpr->right;
+        this->result = own(notExpr->right->retain());
         return;
     }
-    this->result = new BoolExpNot(node);
+    this->result = own(B_NOT(ref(node)));
 }
 
 void kconfig::BoolExpSimplifier::visit(BoolExpAnd *) {
@@ -52,10 +74,10 @@ void kconfig::BoolExpSimplifier::visit(BoolExpAnd *) {
         BoolExpConst *c = left ? left : right;
         BoolExp *var = left ? sr : sl;
         if (c->value == true) {
-            this->result = var;
+            this->result = own(var->retain());
             return;
         } else {
-            this->result = c;            //0
+            this->result = own(c->retain());            //0
             return;
         }
     }
@@ -65,8 +87,7 @@ void kconfig::BoolExpSimplifier::visit(BoolExpAnd *) {
         BoolExpVar *left = dynamic_cast<BoolExpVar*>(sl);
         if (left != nullptr && right != nullptr) {
             if (right->equals(left)) {
-                //delete right;
-                this->result = left;
+                this->result = own(left->retain());
                 return;
             }
         }
@@ -80,12 +101,12 @@ void kconfig::BoolExpSimplifier::visit(BoolExpAnd *) {
             BoolExp *other = left ? sr : sl;
             BoolExpNot *inverse = dynamic_cast<BoolExpNot*>(other);
             if (inverse && inverse->right->equals(var)) {
-                 this->result = B_CONST(false);
+                 this->result = own(B_CONST(false));
                  return;
             }
         }
     }
-    this->result = B_AND(sl, sr);
+    this->result = own(B_AND(ref(sl), ref(sr)));
 }
 
 void kconfig::BoolExpSimplifier::visit(BoolExpOr *) {
@@ -100,10 +121,10 @@ void kconfig::BoolExpSimplifier::visit(BoolExpOr *) {
             BoolExpConst *c = left ? left : right;
             BoolExp *var = left ? sr : sl;
             if (c->value == false) {
-                this->result = var;
+                this->result = own(var->retain());
                  return;
             } else {
-                 this->result = c;        //1
+                 this->result = own(c->retain());        //1
                  return;
             }
         }
@@ -117,7 +138,7 @@ void kconfig::BoolExpSimplifier::visit(BoolExpOr *) {
             BoolExp *other = left ? sr : sl;
             BoolExpNot *inverse = dynamic_cast<BoolExpNot*>(other);
             if (inverse && inverse->right->equals(var)) {
-                 this->result = B_CONST(true);
+                 this->result = own(B_CONST(true));
                  return;
             }
         }
@@ -128,8 +149,7 @@ void kconfig::BoolExpSimplifier::visit(BoolExpOr *) {
         BoolExpVar *left = dynamic_cast<BoolExpVar*>(sl);
         if (left != nullptr && right != nullptr) {
             if (right->equals(left)) {
-                //delete right;
-                 this->result = left;
+                 this->result = own(left->retain());
                  return;
             }
         }
@@ -140,12 +160,12 @@ void kconfig::BoolExpSimplifier::visit(BoolExpOr *) {
         BoolExpVar *left = dynamic_cast<BoolExpVar*>(sl);
         if (left != nullptr && right != nullptr) {
             if (right->equals(left)) {
-                 this->result = left;
+                 this->result = own(left->retain());
                  return;
             }
         }
     }
-    this->result = B_OR(sl, sr);
+    this->result = own(B_OR(ref(sl), ref(sr)));
 }
 
 void kconfig::BoolExpSimplifier::visit(BoolExpImpl *) {
@@ -156,28 +176,25 @@ void kconfig::BoolExpSimplifier::visit(BoolExpImpl *) {
 
         // x -> 1;
         if (right != nullptr && right->value == true) {
-            //delete sr;
-            //delete sl;
-            this->result = B_CONST(true);
+            this->result = own(B_CONST(true));
             return;
         }
         // x-> 0
         if (right != nullptr && right->value == false) {
-            //delete sr;
-            BoolExp *notsl = B_NOT(sl);
+            BoolExp *notsl = B_NOT(ref(sl));
             BoolExp *notsl_simpl =  notsl->simplify();
-            //delete notsl;
-            this->result = notsl_simpl;
+            notsl->release();
+            this->result = own(notsl_simpl);
             return;
         }
     }
-    this->result = new BoolExpImpl(sl, sr);
+    this->result = own(B_IMPL(ref(sl), ref(sr)));
 }
 
 void kconfig::BoolExpSimplifier::visit(BoolExpEq *) {
     BoolExp *sr = static_cast<BoolExp *>(this->right);
     BoolExp *sl = static_cast<BoolExp *>(this->left);
-    this->result = new BoolExpEq(sl, sr);
+    this->result = own(BoolExpEq::make(ref(sl), ref(sr)));
 }
 
 void kconfig::BoolExpSimplifier::visit(BoolExpAny *) {
@@ -189,13 +206,13 @@ void kconfig::BoolExpSimplifier::visit(BoolExpCall *) {
 }
 
 void kconfig::BoolExpSimplifier::visit(BoolExpConst *e) {
-    this->result = new BoolExpConst(*e);
+    this->result = own(e->retain());
 }
 
 void kconfig::BoolExpSimplifier::visit(BoolExpVar *e) {
     if (e->rel == rel_mod && e->sym->type == S_BOOLEAN) {
-        this->result = B_CONST(false);
+        this->result = own(B_CONST(false));
         return;
     }
-    this->result = new BoolExpVar(*e);
+    this->result = own(e->retain());
 }
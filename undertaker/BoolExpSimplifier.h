@@ -26,12 +26,19 @@
 #include "bool.h"
 #include "BoolVisitor.h"
 
+#include <vector>
+
 namespace kconfig {
     class BoolExpSimplifier : public BoolVisitor {
+        //! the simplified subexpressions, the simplifier holds a reference to each
+        std::vector<BoolExp *> owned;
+
+        BoolExp *own(BoolExp *e);
+
     public:
-        BoolExp *getResult(void) const {
-            return static_cast<BoolExp *>(this->result);
-        }
+        ~BoolExpSimplifier();
+        //! \return a new reference to the simplified expression
+        BoolExp *getResult(void) const;
 
     protected:
         void visit(BoolExp *e)      final override;
@@ -34,9 +34,9 @@ namespace kconfig {
         }
 
         ~BoolExpStringBuilder() {
-            for (auto &entry : visited)  // pair<BoolExp *, void *>
-                if (entry.second)
-                    delete static_cast<std::string *>(entry.second);
+            for (const Visit &visit : visits)
+                if (visit.epoch == epoch)
+                    delete static_cast<std::string *>(visit.result);
         }
 
     protected:
@@ -78,7 +78,8 @@ namespace kconfig {
             std::string paramstring("");
             for (const auto &ptr : *e->param) {  // BoolExp *
                 paramstring += first ? "" : ", ";
-                paramstring += ptr->str();
+                // the parameters are visited before the call
+                paramstring += *static_cast<std::string *>(resultOf(ptr));
                 first = false;
             }
             this->result = new std::string{ e->getName() + " (" + paramstring + ")" };
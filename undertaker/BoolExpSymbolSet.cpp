@@ -40,5 +40,5 @@ void BoolExpSymbolSet::visit(BoolExpCall *e) {
 }
 
 void BoolExpSymbolSet::visit(BoolExpVar *e) {
-    symbolset.insert(e->str());
+    symbolset.insert(e->getName());
 }
@@ -24,9 +24,23 @@
 
 #include "bool.h"
 
-#include <map>
+#include <vector>
 
 namespace kconfig {
+    /**
+     * \brief base class of the algorithms on boolean expressions
+     *
+     * BoolExp::accept() hands the expression to traverse(), which calls
+     * visit() for each node in post-order, i.e., after its operands (or the
+     * parameters of a function call). Nodes that are shared by several
+     * parents are visited only once. visit() can access the results of the
+     * operands in 'left' and 'right' and stores its own result in 'result'.
+     * The results are kept in a vector of the visitor that is indexed by the
+     * ids of the nodes, so a visitor needs no lookups in shared tables.
+     *
+     * The traversal uses an explicit stack instead of recursion, as the
+     * expressions of big models contain very long chains of operators.
+     */
     class BoolVisitor {
         friend class BoolExpVar;
         friend class BoolExpNot;
@@ -41,13 +55,35 @@ namespace kconfig {
 
     public:
         bool isVisited(BoolExp *node) const {
-            return visited.find(node) != visited.end();
+            return node->id < visits.size() && visits[node->id].epoch == epoch;
         }
 
     protected:
-        std::map <BoolExp *, void *> visited;
+        struct Visit {
+            void *result = nullptr;
+            //! the node has been visited if this is the current epoch
+            unsigned epoch = 0;
+        };
+
+        //! the results of the nodes, indexed by their ids
+        std::vector<Visit> visits;
+        unsigned epoch = 1;
         void *left = nullptr, *right = nullptr;
         void *result = nullptr;
+
+        //! visits all nodes of e that haven't been visited yet, 'result' is the one of e
+        void traverse(BoolExp *e);
+        //! \return the result of a visited node
+        void *resultOf(BoolExp *node) const { return visits[node->id].result; }
+
+        //! forgets all visited nodes, in constant time
+        void forget() {
+            if (++epoch == 0) {
+                visits.clear();
+                epoch = 1;
+            }
+        }
+
         virtual void visit(BoolExp *e) = 0;
         virtual void visit(BoolExpAnd *e) = 0;
         virtual void visit(BoolExpOr *e) = 0;
@@ -26,22 +26,32 @@
 
 using namespace kconfig;
 
+namespace {
+    // polarities of a subexpression, i.e., the directions of its definition that are needed
+    const int POSITIVE = 1, NEGATIVE = 2, BOTH = POSITIVE | NEGATIVE;
+} // namespace
 
 CNFBuilder::CNFBuilder(PicosatCNF *cnf, std::string sat, bool useKconfigWhitelist,
-                       ConstantPolicy constPolicy)
-        : cnf(cnf), constPolicy(constPolicy), useKconfigWhitelist(useKconfigWhitelist) {
+                       ConstantPolicy constPolicy, int guard, Encoding encoding)
+        : cnf(cnf), constPolicy(constPolicy), useKconfigWhitelist(useKconfigWhitelist),
+          guard(guard), encoding(encoding) {
     if (sat != "") {
         BoolExp *exp = BoolExp::parseString(sat);
         if (!exp) {
             throw CNFBuilderError("CNFBuilder: Couldn't parse: " + sat);
         }
         this->pushClause(exp);
-        delete exp;
+        exp->release();
     }
 }
 
+CNFBuilder::~CNFBuilder() {
+    for (auto &entry : definitions)  // pair<BoolExp *, Definition>
+        entry.first->release();
+}
+
 void CNFBuilder::pushClause(BoolExp *e) {
-    visited.clear();
+    forget();
     BoolExpConst *constant = dynamic_cast<BoolExpConst*>(e);
 
     if (constant) {
@@ -53,18 +63,186 @@ void CNFBuilder::pushClause(BoolExp *e) {
     // If we push a variable directly to the stack of clauses, we can
     // assume that it is always set. Therefore, also add it to the
     // ALWAYS_ON meta variable, to preserve this observation so that
-    // it can be exploited in a later stage.
+    // it can be exploited in a later stage. This does not hold for
+    // guarded expressions.
     BoolExpVar *variable = dynamic_cast<BoolExpVar*>(e);
-    if (variable) {
+    if (variable && !guard) {
         const std::string always_on("ALWAYS_ON");
-        cnf->addMetaValue(always_on, variable->str());
+        cnf->addMetaValue(always_on, variable->getName());
+    }
+    if (encoding != Encoding::POLARITY) {
+        e->accept(this);
+        assertExpression(e);
+        return;
+    }
+    collectPolarities(e);
+    // the operands of a pushed conjunction have to hold on their own, hence
+    // they are pushed one by one without a variable for the conjunction
+    std::vector<BoolExp *> conjuncts{e};
+    if (dynamic_cast<BoolExpAnd *>(e) && !var(e))
+        conjuncts = chainOperands(e);
+    for (BoolExp *conjunct : conjuncts) {
+        // a pushed disjunction becomes a single clause of its operands
+        if (dynamic_cast<BoolExpOr *>(conjunct) && !var(conjunct)
+                && nodes[conjunct].parents <= 1) {
+            const std::vector<BoolExp *> disjuncts = chainOperands(conjunct);
+            for (BoolExp *disjunct : disjuncts)
+                disjunct->accept(this);
+            if (guard)
+                cnf->pushVar(-guard);
+            for (BoolExp *disjunct : disjuncts)
+                cnf->pushVar(operandVar(disjunct));
+            cnf->pushClause();
+        } else {
+            conjunct->accept(this);
+            assertExpression(conjunct);
+        }
     }
-    e->accept(this);
-    cnf->pushVar(e->CNFVar);
+    nodes.clear();
+}
+
+void CNFBuilder::assertExpression(BoolExp *e) {
+    if (guard)
+        cnf->pushVar(-guard);
+    cnf->pushVar(operandVar(e));
     cnf->pushClause();
 }
 
-int CNFBuilder::addVar(std::string symname) {
+void CNFBuilder::collectPolarities(BoolExp *e) {
+    std::vector<BoolExp *> order;
+    postorder(e, order);
+    // the pushed expression has to be true
+    nodes[e].polarity = POSITIVE;
+
+    // in reverse postorder, all parents of a subexpression come before it
+    for (auto it = order.rbegin(); it != order.rend(); ++it) {
+        BoolExp *node = *it;
+        const int polarity = nodes[node].polarity;
+        const int flipped = ((polarity & POSITIVE) ? NEGATIVE : 0)
+            | ((polarity & NEGATIVE) ? POSITIVE : 0);
+        if (dynamic_cast<BoolExpAnd *>(node) || dynamic_cast<BoolExpOr *>(node)) {
+            nodes[node->left].polarity |= polarity;
+            nodes[node->right].polarity |= polarity;
+        } else if (dynamic_cast<BoolExpNot *>(node)) {
+            nodes[node->right].polarity |= flipped;
+        } else if (dynamic_cast<BoolExpImpl *>(node)) {
+            nodes[node->left].polarity |= flipped;
+            nodes[node->right].polarity |= polarity;
+        } else if (dynamic_cast<BoolExpEq *>(node)) {
+            nodes[node->left].polarity |= BOTH;
+            nodes[node->right].polarity |= BOTH;
+        }
+        // the remaining expressions are free variables, their operands don't matter
+    }
+
+    // an operand of the same operator without other parents continues the chain
+    for (BoolExp *node : order) {
+        for (BoolExp *child : {node->left, node->right}) {
+            if (!child || var(child) || nodes[child].parents != 1)
+                continue;
+            if ((dynamic_cast<BoolExpAnd *>(node) && dynamic_cast<BoolExpAnd *>(child))
+                    || (dynamic_cast<BoolExpOr *>(node) && dynamic_cast<BoolExpOr *>(child)))
+                nodes[child].chained = true;
+        }
+    }
+}
+
+void CNFBuilder::postorder(BoolExp *e, std::vector<BoolExp *> &order) {
+    // with an explicit stack, as chains of && can be very long
+    std::vector<std::pair<BoolExp *, bool>> stack{{e, false}};  // node, expanded
+    while (!stack.empty()) {
+        BoolExp *node = stack.back().first;
+        if (stack.back().second) {
+            stack.pop_back();
+            order.push_back(node);
+            continue;
+        }
+        if (!nodes.emplace(node, NodeInfo()).second) {
+            stack.pop_back();
+            continue;
+        }
+        stack.back().second = true;
+        for (BoolExp *child : {node->right, node->left})
+            if (child)
+                stack.push_back({child, false});
+    }
+    for (BoolExp *node : order)
+        for (BoolExp *child : {node->left, node->right})
+            if (child)
+                nodes[child].parents++;
+}
+
+int CNFBuilder::missingPolarity(BoolExp *e) {
+    int needed = BOTH;
+    if (encoding == Encoding::POLARITY) {
+        const auto &it = nodes.find(e);
+        needed = (it != nodes.end()) ? it->second.polarity : BOTH;
+    }
+    // subexpressions that were pushed before only get the directions they lack
+    int &encoded = definition(e).polarity;
+    const int missing = needed & ~encoded;
+    encoded |= needed;
+    return missing;
+}
+
+CNFBuilder::Definition &CNFBuilder::definition(BoolExp *e) {
+    auto inserted = definitions.emplace(e, Definition());
+    // the node must not be freed while its variable is in use
+    if (inserted.second)
+        e->retain();
+    return inserted.first->second;
+}
+
+int CNFBuilder::var(BoolExp *e) const {
+    const auto &it = definitions.find(e);
+    return (it != definitions.end()) ? it->second.var : 0;
+}
+
+void CNFBuilder::define(BoolExp *e, int var) {
+    definition(e).var = var;
+}
+
+int CNFBuilder::operandVar(BoolExp *e) {
+    // all occurrences of a constant or of an ignored item are the same node,
+    // but each of them is another free variable, also if it is negated
+    BoolExp *operand = dynamic_cast<BoolExpNot *>(e) ? e->right : e;
+    if (constPolicy == ConstantPolicy::FREE && dynamic_cast<BoolExpConst *>(operand))
+        return cnf->newVar();
+    BoolExpVar *item = dynamic_cast<BoolExpVar *>(operand);
+    if (item && useKconfigWhitelist
+            && KconfigWhitelist::getIgnorelist().isWhitelisted(item->getName()))
+        return cnf->newVar();
+    return var(e);
+}
+
+std::vector<int> CNFBuilder::operandVars(BoolExp *e) {
+    std::vector<int> vars;
+    for (BoolExp *operand : chainOperands(e))
+        vars.push_back(operandVar(operand));
+    return vars;
+}
+
+bool CNFBuilder::isChained(const BoolExp *e) const {
+    const auto &it = nodes.find(e);
+    return it != nodes.end() && it->second.chained;
+}
+
+std::vector<BoolExp *> CNFBuilder::chainOperands(BoolExp *e) const {
+    std::vector<BoolExp *> operands, stack{e->right, e->left};
+    while (!stack.empty()) {
+        BoolExp *node = stack.back();
+        stack.pop_back();
+        if (isChained(node)) {
+            stack.push_back(node->right);
+            stack.push_back(node->left);
+        } else {
+            operands.push_back(node);
+        }
+    }
+    return operands;
+}
+
+int CNFBuilder::addVar(const std::string &symname) {
     int cv = cnf->getCNFVar(symname);
 
     if (cv == 0) {
@@ -84,159 +262,219 @@ void CNFBuilder::visit(BoolExp *) {
 }
 
 void CNFBuilder::visit(BoolExpAnd *e) {
-    if (e->CNFVar)
+    if (isChained(e))
+        return;
+    const int missing = missingPolarity(e);
+    if (!var(e))
+        define(e, this->cnf->newVar());
+    // nothing to encode, also no variables for free constant operands
+    if (!missing)
         return;
-
-    e->CNFVar = this->cnf->newVar();
 
     // add clauses
-    int h = e->CNFVar;
-    int a = e->left->CNFVar;
-    int b = e->right->CNFVar;
+    int h = var(e);
+    if (encoding == Encoding::POLARITY) {
+        const std::vector<int> operands = operandVars(e);
+        // H <-> (A_1 && ... && A_n)
+        // (!H || A_1) && ... && (!H || A_n) && (H || !A_1 || ... || !A_n)
+        if (missing & POSITIVE) {
+            for (int operand : operands) {
+                cnf->pushVar(-h);
+                cnf->pushVar(operand);
+                cnf->pushClause();
+            }
+        }
+        if (missing & NEGATIVE) {
+            cnf->pushVar(h);
+            for (int operand : operands)
+                cnf->pushVar(-operand);
+            cnf->pushClause();
+        }
+        return;
+    }
+    int a = operandVar(e->left);
+    int b = operandVar(e->right);
     // H <-> (A && B)
     // (!H || A) && ( !H || B) && ( H || !A || !B)
-    cnf->pushVar(-h);
-    cnf->pushVar(a);
-    cnf->pushClause();
-
-    cnf->pushVar(-h);
-    cnf->pushVar(b);
-    cnf->pushClause();
+    if (missing & POSITIVE) {
+        cnf->pushVar(-h);
+        cnf->pushVar(a);
+        cnf->pushClause();
 
-    cnf->pushVar(h);
-    cnf->pushVar(-a);
-    cnf->pushVar(-b);
-    cnf->pushClause();
+        cnf->pushVar(-h);
+        cnf->pushVar(b);
+        cnf->pushClause();
+    }
+    if (missing & NEGATIVE) {
+        cnf->pushVar(h);
+        cnf->pushVar(-a);
+        cnf->pushVar(-b);
+        cnf->pushClause();
+    }
 }
 
 void CNFBuilder::visit(BoolExpOr *e) {
-    if (e->CNFVar)
+    if (isChained(e))
+        return;
+    const int missing = missingPolarity(e);
+    if (!var(e))
+        define(e, this->cnf->newVar());
+    // nothing to encode, also no variables for free constant operands
+    if (!missing)
         return;
-
-    e->CNFVar = this->cnf->newVar();
 
     // add clauses
-    int h = e->CNFVar;
-    int a = e->left->CNFVar;
-    int b = e->right->CNFVar;
+    int h = var(e);
+    if (encoding == Encoding::POLARITY) {
+        const std::vector<int> operands = operandVars(e);
+        // H <-> (A_1 || ... || A_n)
+        // (H || !A_1) && ... && (H || !A_n) && (!H || A_1 || ... || A_n)
+        if (missing & NEGATIVE) {
+            for (int operand : operands) {
+                cnf->pushVar(h);
+                cnf->pushVar(-operand);
+                cnf->pushClause();
+            }
+        }
+        if (missing & POSITIVE) {
+            cnf->pushVar(-h);
+            for (int operand : operands)
+                cnf->pushVar(operand);
+            cnf->pushClause();
+        }
+        return;
+    }
+    int a = operandVar(e->left);
+    int b = operandVar(e->right);
 
     // H <-> (A || B)
     // (H || !A) && ( H || !B) && ( !H || A || B)
-    cnf->pushVar(h);
-    cnf->pushVar(-a);
-    cnf->pushClause();
-
-    cnf->pushVar(h);
-    cnf->pushVar(-b);
-    cnf->pushClause();
+    if (missing & NEGATIVE) {
+        cnf->pushVar(h);
+        cnf->pushVar(-a);
+        cnf->pushClause();
 
-    cnf->pushVar(-h);
-    cnf->pushVar(a);
-    cnf->pushVar(b);
-    cnf->pushClause();
+        cnf->pushVar(h);
+        cnf->pushVar(-b);
+        cnf->pushClause();
+    }
+    if (missing & POSITIVE) {
+        cnf->pushVar(-h);
+        cnf->pushVar(a);
+        cnf->pushVar(b);
+        cnf->pushClause();
+    }
 }
 
 void CNFBuilder::visit(BoolExpImpl *e) {
-    if (e->CNFVar)
+    const int missing = missingPolarity(e);
+    if (!var(e))
+        define(e, this->cnf->newVar());
+    // nothing to encode, also no variables for free constant operands
+    if (!missing)
         return;
 
-    e->CNFVar = this->cnf->newVar();
-
     // add clauses
-    int h = e->CNFVar;
-    int a = e->left->CNFVar;
-    int b = e->right->CNFVar;
+    int h = var(e);
+    int a = operandVar(e->left);
+    int b = operandVar(e->right);
     // H <-> (A -> B)
     // (H ||  A) && (H || !B ) && (!H || !A || B)
-    cnf->pushVar(h);
-    cnf->pushVar(a);
-    cnf->pushClause();
-
-    cnf->pushVar(h);
-    cnf->pushVar(-b);
-    cnf->pushClause();
+    if (missing & NEGATIVE) {
+        cnf->pushVar(h);
+        cnf->pushVar(a);
+        cnf->pushClause();
 
-    cnf->pushVar(-h);
-    cnf->pushVar(-a);
-    cnf->pushVar(b);
-    cnf->pushClause();
+        cnf->pushVar(h);
+        cnf->pushVar(-b);
+        cnf->pushClause();
+    }
+    if (missing & POSITIVE) {
+        cnf->pushVar(-h);
+        cnf->pushVar(-a);
+        cnf->pushVar(b);
+        cnf->pushClause();
+    }
 }
 
 void CNFBuilder::visit(BoolExpEq *e) {
-    if (e->CNFVar)
+    const int missing = missingPolarity(e);
+    if (!var(e))
+        define(e, this->cnf->newVar());
+    // nothing to encode, also no variables for free constant operands
+    if (!missing)
         return;
 
-    e->CNFVar = this->cnf->newVar();
-
     // add clauses
-    int h = e->CNFVar;
-    int a = e->left->CNFVar;
-    int b = e->right->CNFVar;
+    int h = var(e);
+    int a = operandVar(e->left);
+    int b = operandVar(e->right);
     // H <-> (A <-> B)
     // (H || !A || !B) && (H || A || B) && (!H || A || !B) && (!H || !A || B)
-    cnf->pushVar(h);
-    cnf->pushVar(-a);
-    cnf->pushVar(-b);
-    cnf->pushClause();
-
-    cnf->pushVar(h);
-    cnf->pushVar(a);
-    cnf->pushVar(b);
-    cnf->pushClause();
+    if (missing & NEGATIVE) {
+        cnf->pushVar(h);
+        cnf->pushVar(-a);
+        cnf->pushVar(-b);
+        cnf->pushClause();
 
-    cnf->pushVar(-h);
-    cnf->pushVar(a);
-    cnf->pushVar(-b);
-    cnf->pushClause();
+        cnf->pushVar(h);
+        cnf->pushVar(a);
+        cnf->pushVar(b);
+        cnf->pushClause();
+    }
+    if (missing & POSITIVE) {
+        cnf->pushVar(-h);
+        cnf->pushVar(a);
+        cnf->pushVar(-b);
+        cnf->pushClause();
 
-    cnf->pushVar(-h);
-    cnf->pushVar(-a);
-    cnf->pushVar(b);
-    cnf->pushClause();
+        cnf->pushVar(-h);
+        cnf->pushVar(-a);
+        cnf->pushVar(b);
+        cnf->pushClause();
+    }
 }
 
 void CNFBuilder::visit(BoolExpAny *e) {
     // add free variable for arith. Operators (ie, handle them later..)
-    e->CNFVar = this->cnf->newVar();
+    define(e, this->cnf->newVar());
 }
 
 void CNFBuilder::visit(BoolExpCall *e) {
     // add free variable for function calls (i.e., handle them later..)
-    e->CNFVar = this->cnf->newVar();
+    define(e, this->cnf->newVar());
 }
 
 void CNFBuilder::visit(BoolExpNot *e) {
-    if (e->CNFVar)
+    if (var(e))
         return;
 
-    e->CNFVar = -(e->right->CNFVar);
+    define(e, -operandVar(e->right));
 }
 
 void CNFBuilder::visit(BoolExpConst *e) {
-    if (e->CNFVar)
+    if (var(e))
         return;
 
-    if (constPolicy == ConstantPolicy::FREE){
-        //handle consts as free var
-        e->CNFVar = this->cnf->newVar();
+    if (constPolicy == ConstantPolicy::FREE)
+        // handle consts as free var, see operandVar()
         return;
-    }
     if (!this->boolvar) {
         this->boolvar = this->cnf->newVar();
         cnf->pushVar(boolvar);
         cnf->pushClause();
     }
-    e->CNFVar = e->value ? boolvar : -boolvar;
+    define(e, e->value ? boolvar : -boolvar);
 }
 
 void CNFBuilder::visit(BoolExpVar *e) {
-    std::string symname = e->str();
-    if (e->CNFVar)
+    const std::string &symname = e->getName();
+    if (var(e))
         return;
 
     if (useKconfigWhitelist && KconfigWhitelist::getIgnorelist().isWhitelisted(symname))
         // use free variables for symbols in wl
-        e->CNFVar = this->cnf->newVar();
+        define(e, this->cnf->newVar());
     else
-        e->CNFVar = this->addVar(symname);
+        define(e, this->addVar(symname));
 }
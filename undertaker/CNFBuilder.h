@@ -27,6 +27,8 @@
 #include "BoolVisitor.h"
 
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 
 namespace kconfig {
@@ -35,27 +37,91 @@ namespace kconfig {
     class CNFBuilder : public BoolVisitor {
     public:
         enum class ConstantPolicy {BOUND, FREE};
+        /**
+         * EQUIVALENCE: the variable of each subexpression is equivalent to it
+         * POLARITY: (Plaisted-Greenbaum) only the directions of the
+         *     equivalence that are needed for the polarities in which the
+         *     subexpression occurs are encoded. Subexpressions that occur both
+         *     positively and negatively are encoded as equivalence. The
+         *     satisfiability and the satisfying assignments of the named
+         *     variables don't change, but the variables of subexpressions
+         *     must not be used in assumptions.
+         *     Additionally, chains of the same operator (e.g., A && B && C)
+         *     are encoded as one n-ary expression with a single variable, and
+         *     the operands of a pushed conjunction are pushed one by one.
+         */
+        enum class Encoding {EQUIVALENCE, POLARITY};
         PicosatCNF *cnf = nullptr;
     private:
         int boolvar = 0;
         ConstantPolicy constPolicy;
         bool useKconfigWhitelist = false;
+        int guard = 0;
+        Encoding encoding;
+        struct Definition {
+            int var = 0;
+            //! the directions of the definition of var that have been encoded
+            int polarity = 0;
+        };
+        //! the variables of the subexpressions that have been pushed, keeps a reference to each
+        std::unordered_map<BoolExp *, Definition> definitions;
+
+        struct NodeInfo {
+            int polarity = 0;
+            int parents = 0;
+            //! inner node of a chain of the same operator, encoded by the top of the chain
+            bool chained = false;
+        };
+        //! the subexpressions of the expression that is pushed
+        std::unordered_map<const BoolExp *, NodeInfo> nodes;
+
+        void collectPolarities(BoolExp *e);
+        void postorder(BoolExp *e, std::vector<BoolExp *> &order);
+        //! the directions of the definition of e that still have to be encoded
+        int missingPolarity(BoolExp *e);
+        Definition &definition(BoolExp *e);
+        //! \return the variable of e, 0 if it has none yet
+        int var(BoolExp *e) const;
+        void define(BoolExp *e, int var);
+        //! \return the variable of the operand e, a new free one for each constant under FREE
+        //! and for each ignored item
+        int operandVar(BoolExp *e);
+        //! the variables of chainOperands(e)
+        std::vector<int> operandVars(BoolExp *e);
+        bool isChained(const BoolExp *e) const;
+        //! the operands of the chain of the same operator starting at e
+        std::vector<BoolExp *> chainOperands(BoolExp *e) const;
+        //! adds the clause (!guard || e)
+        void assertExpression(BoolExp *e);
 
     public:
+        /**
+         * \param guard if not 0, the pushed expressions only have to hold
+         *     if the literal 'guard' is true (i.e., the clause (!guard || e)
+         *     is added instead of the unit clause e)
+         */
         explicit CNFBuilder(PicosatCNF *cnf, std::string sat = "",
                             bool useKconfigWhitelist = false,
-                            ConstantPolicy constPolicy = ConstantPolicy::BOUND);
+                            ConstantPolicy constPolicy = ConstantPolicy::BOUND,
+                            int guard = 0, Encoding encoding = Encoding::EQUIVALENCE);
+        ~CNFBuilder();
+
+        CNFBuilder(const CNFBuilder &) = delete;
+        CNFBuilder &operator=(const CNFBuilder &) = delete;
 
         //! Add clauses from the parsed boolean expression e
         /**
-         * \param[in,out] e the parsed expression
+         * \param[in] e the parsed expression
          *
-         * Note that this triggers the traversal on the tree e,
-         * which (as every visitor), and therefrore potentially
-         * modifies the CNF variable assignment.
+         * The builder keeps the variables of the subexpressions of e.
+         * Subexpressions that are pushed again, also as part of another
+         * expression, are not encoded a second time.
          */
         void pushClause(BoolExp *e);
 
+        //! the expressions pushed from now on only have to hold if the literal 'guard' is true
+        void setGuard(int guard) { this->guard = guard; }
+
         //! Add new variable to the CNF and returns associated var number
         /**
          * @param[in] the name of the variable
@@ -65,7 +131,7 @@ namespace kconfig {
          * cnf var number. If a variable with the given name already
          * exists, the var number of the existing var is returned.
          */
-        int addVar(std::string s);
+        int addVar(const std::string &s);
 
     protected:
         void visit(BoolExp *e)      final override;
@@ -27,7 +27,11 @@
 #include "PicosatCNF.h"
 #include "StringJoiner.h"
 #include "Tools.h"
+#include "cpp14.h"
 
+#include <algorithm>
+#include <cstdlib>
+#include <deque>
 #include <boost/filesystem.hpp>
 #include <boost/regex.hpp>
 
@@ -35,6 +39,7 @@
 CnfConfigurationModel::CnfConfigurationModel(const std::string &filename) {
     boost::filesystem::path filepath(filename);
     _name = filepath.stem().string();
+    setIdentity({filename});
 
     _cnf = new kconfig::PicosatCNF();
     _cnf->readFromFile(filename);
@@ -51,10 +56,16 @@ CnfConfigurationModel::CnfConfigurationModel(const std::string &filename) {
         // if the model is empty (e.g., if /dev/null was loaded), it cannot possibly be complete
         _cnf->addMetaValue("CONFIGURATION_SPACE_INCOMPLETE", "1");
     }
+    loadBackbone(filename);
 }
 
 CnfConfigurationModel::~CnfConfigurationModel() { delete _cnf; }
 
+std::unique_ptr<kconfig::PicosatCNF> CnfConfigurationModel::createCNF() const {
+    // the copy shares the clauses of a binary model
+    return make_unique<kconfig::PicosatCNF>(*_cnf);
+}
+
 bool CnfConfigurationModel::isBoolean(const std::string &item) const {
     return _cnf->getSymbolType(item) == K_S_BOOLEAN;
 }
@@ -78,7 +89,7 @@ std::string CnfConfigurationModel::getType(const std::string &feature_name) cons
 }
 
 bool CnfConfigurationModel::containsSymbol(const std::string &symbol) const {
-    return undertaker::starts_with(symbol, "FILE_") || _cnf->getAssociatedSymbol(symbol) != nullptr;
+    return undertaker::starts_with(symbol, "FILE_") || _cnf->hasAssociatedSymbol(symbol);
 }
 
 void CnfConfigurationModel::addMetaValue(const std::string &key, const std::string &val) const {
@@ -88,3 +99,78 @@ void CnfConfigurationModel::addMetaValue(const std::string &key, const std::stri
 const StringList *CnfConfigurationModel::getMetaValue(const std::string &key) const {
     return _cnf->getMetaValue(key);
 }
+
+void CnfConfigurationModel::buildIndex() const {
+    // the index refers to the literals of the cnf, which stay in the mapping of the file
+    int varcount = _cnf->getVarCount();
+    std::vector<unsigned int> count(varcount + 2, 0);
+    _clause_start.clear();
+    _clause_start.push_back(0);
+    for (unsigned int i = 0; i < _cnf->getLiteralCount(); i++) {
+        int lit = _cnf->getLiteral(i);
+        if (lit == 0)
+            _clause_start.push_back(i + 1);
+        else
+            count[abs(lit)]++;
+    }
+    // the clauses of variable v are _occurrences[_occurrence_start[v]..._occurrence_start[v+1]]
+    _occurrence_start.assign(varcount + 2, 0);
+    for (int var = 1; var <= varcount + 1; var++)
+        _occurrence_start[var] = _occurrence_start[var - 1] + count[var - 1];
+    _occurrences.resize(_occurrence_start[varcount + 1]);
+    std::vector<unsigned int> next(_occurrence_start.begin(), _occurrence_start.end() - 1);
+    for (unsigned int clause = 0; clause + 1 < _clause_start.size(); clause++)
+        for (unsigned int i = _clause_start[clause]; _cnf->getLiteral(i) != 0; i++)
+            _occurrences[next[abs(_cnf->getLiteral(i))]++] = clause;
+}
+
+bool CnfConfigurationModel::pushCone(kconfig::PicosatCNF *cnf, const std::vector<int> &vars,
+                                     Cone &cone, int depth) const {
+    std::call_once(_index_built, &CnfConfigurationModel::buildIndex, this);
+    int varcount = _cnf->getVarCount();
+    cone.vars.resize(varcount + 1, false);
+    cone.clauses.resize(_clause_start.size() - 1, false);
+
+    // breadth first, so each variable is reached in as few steps as possible
+    std::deque<std::pair<int, int>> queue;  // variable, steps
+    for (int var : vars)
+        if (var != 0 && abs(var) <= varcount)
+            queue.emplace_back(abs(var), 0);
+    if (depth < 0) {
+        for (int var : cone.frontier)
+            queue.emplace_back(var, 0);
+        cone.frontier.clear();
+    }
+    while (!queue.empty()) {
+        int var = queue.front().first, steps = queue.front().second;
+        queue.pop_front();
+        if (cone.vars[var])
+            continue;
+        if (depth >= 0 && steps >= depth) {
+            for (unsigned int i = _occurrence_start[var]; i < _occurrence_start[var + 1]; i++)
+                if (!cone.clauses[_occurrences[i]]) {
+                    cone.frontier.push_back(var);
+                    break;
+                }
+            continue;
+        }
+        cone.vars[var] = true;
+        for (unsigned int i = _occurrence_start[var]; i < _occurrence_start[var + 1]; i++) {
+            unsigned int clause = _occurrences[i];
+            if (cone.clauses[clause])
+                continue;
+            cone.clauses[clause] = true;
+            for (unsigned int j = _clause_start[clause]; int lit = _cnf->getLiteral(j); j++) {
+                cnf->pushVar(lit);
+                if (!cone.vars[abs(lit)])
+                    queue.emplace_back(abs(lit), steps + 1);
+            }
+            cnf->pushClause();
+        }
+    }
+    // variables that were reached in fewer steps later on are in the cone after all
+    cone.frontier.erase(std::remove_if(cone.frontier.begin(), cone.frontier.end(),
+                                       [&](int var) { return cone.vars[var]; }),
+                        cone.frontier.end());
+    return cone.frontier.empty();
+}
@@ -24,6 +24,9 @@
 
 #include "ConfigurationModel.h"
 
+#include <mutex>
+#include <vector>
+
 namespace kconfig {
     class PicosatCNF;
 } // namespace kconfig
@@ -32,11 +35,21 @@ namespace kconfig {
 class CnfConfigurationModel: public ConfigurationModel {
     kconfig::PicosatCNF *_cnf = nullptr;
 
+    //@{
+    //! occurrence index of the clauses, built by the first call of pushCone()
+    mutable std::once_flag _index_built;
+    mutable std::vector<unsigned int> _clause_start;
+    mutable std::vector<unsigned int> _occurrence_start, _occurrences;
+    //@}
+    void buildIndex() const;
+
     void doIntersectPreprocess(std::set<std::string> &, StringJoiner &,
                                std::set<std::string> *) const final override {}
 
     void addMetaValue(const std::string &key, const std::string &val) const final override;
 
+    std::unique_ptr<kconfig::PicosatCNF> createCNF() const final override;
+
 public:
     //! Loads the configuration model from file
     //! \param filename filepath to the model file. (NB: The basename is taken as architecture name.)
@@ -61,5 +74,30 @@ public:
 
     bool containsSymbol(const std::string &symbol)         const final override;
     const StringList *getMetaValue(const std::string &key) const final override;
+
+    //! returns the architectures of a model merged by 'rsf2cnf -a', nullptr otherwise
+    //! Each architecture is selected by the variable ARCH_<name>.
+    const StringList *getArchitectures() const { return getMetaValue("ARCHITECTURES"); }
+
+    //! the variables and clauses of the model that were already pushed by pushCone()
+    struct Cone {
+        std::vector<bool> vars, clauses;
+        //! variables whose clauses were cut off by the depth limit
+        std::vector<int> frontier;
+    };
+
+    /**
+     * \brief pushes the clauses that may influence the given variables into cnf
+     *
+     * Starting with the given variables, all clauses that contain a variable of
+     * the cone, and thereby their variables, are added to the cone. The search
+     * stops after 'depth' steps, a negative depth follows all clauses, including
+     * those cut off before. Only the clauses that are not yet in the cone are
+     * pushed. The variables of cnf have to be numbered like those of the model.
+     *
+     * \returns false if the depth limit cut off some clauses of the cone
+     */
+    bool pushCone(kconfig::PicosatCNF *cnf, const std::vector<int> &vars, Cone &cone,
+                  int depth = -1) const;
 };
 #endif
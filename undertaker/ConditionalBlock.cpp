@@ -26,11 +26,14 @@
 
 #include "ConditionalBlock.h"
 #include "StringJoiner.h"
+#include "BoolExpJoiner.h"
 #include "ModelContainer.h"
 #include "Logging.h"
 #include "PumaConditionalBlock.h"
-typedef PumaConditionalBlock ConditionalBlockImpl;
+#include "ScannerConditionalBlock.h"
+#include "CppFileCache.h"
 #include "cpp14.h"
+#include "exceptions/CNFBuilderError.h"
 
 #include <boost/regex.hpp>
 #include <boost/filesystem.hpp>
@@ -55,28 +58,33 @@ static int lineFromPosition(std::string line) {
     }
 }
 
-static ConditionalBlockImpl *createDummyElseBlock(ConditionalBlock *i, ConditionalBlock *parent,
-                                                  ConditionalBlock *prev) {
-    ConditionalBlockImpl *superblock = dynamic_cast<ConditionalBlockImpl *>(i);
-    if (!superblock) {
-        Logging::error("failed to access the super-class of Conditionalblock");
-        exit(1);
+// The symbols of an expression are the maximal runs of characters between
+// these separators. Rewritten symbols contain a '.', which never occurs in
+// the name of a define, hence they aren't rewritten again.
+static bool isSymbolSpace(char c) {
+    switch (c) {
+    case '(': case ')': case ' ': case '>': case '<': case '&': case '|': case '!': case '-':
+        return true;
+    default:
+        return false;
     }
-    PumaConditionalBlockBuilder &builder = superblock->getBuilder();
-
-    auto tok = new Puma::Token(TOK_PRE_ELSE, Puma::Token::pre_id, "#else");
-    auto ptok = new Puma::PreTreeToken(tok);
-
-    auto tok2 = new Puma::Token(TOK_PRE_ELSE, Puma::Token::pre_id, "");
-    auto ptok2 = new Puma::PreTreeToken(tok2);
-
-    auto node = new Puma::PreElseDirective(ptok, ptok2);
-    unsigned long *nodeNum = builder.getNodeNum();
+}
 
-    auto newBlock = new ConditionalBlockImpl(i->getFile(), parent,
-            prev, node, (*nodeNum)++, builder);
-    newBlock->setDummyBlock();
-    return newBlock;
+// calls f(begin, end) for the position of each symbol of the expression
+template <typename F>
+static void forEachSymbol(const std::string &exp, F f) {
+    std::string::size_type begin = 0;
+    while (begin < exp.size()) {
+        if (isSymbolSpace(exp[begin])) {
+            begin++;
+            continue;
+        }
+        std::string::size_type end = begin + 1;
+        while (end < exp.size() && !isSymbolSpace(exp[end]))
+            end++;
+        f(begin, end);
+        begin = end;
+    }
 }
 
 /************************************************************************/
@@ -86,15 +94,29 @@ static ConditionalBlockImpl *createDummyElseBlock(ConditionalBlock *i, Condition
 // initialize static filename_regex at startup
 const boost::regex CppFile::filename_regex(R"(^.*/arch/([A-Za-z0-9]+)/.*$)");
 
-CppFile::CppFile(const std::string &f) {
+std::atomic<CppFile::Parser> CppFile::parser{CppFile::Parser::PUMA};
+
+CppFile::CppFile(const std::string &f, bool cached) {
     if (!boost::filesystem::exists(f))
         return;
     if (f[0] != '.' && f[1] != '/')
         filename = f;
     else
         filename = f.substr(2); // skip leading "./"
-    _builder = make_unique<PumaConditionalBlockBuilder>(this, f);
+    if (cached && CppFileCache::isEnabled()) {
+        cache_key = CppFileCache::key(f, filename);
+        _builder = CppFileCache::lookup(this, cache_key);
+    }
+    const bool loaded = _builder != nullptr;
+    if (!loaded) {
+        if (parser == Parser::SCANNER)
+            _builder = make_unique<ScannerConditionalBlockBuilder>(this, f);
+        else
+            _builder = make_unique<PumaConditionalBlockBuilder>(this, f);
+    }
     top_block = _builder->topBlock();
+    if (loaded)
+        cached_constraints = CppFileCache::countCodeConstraints(*this);
 
     boost::filesystem::path filepath(filename);
     // check if the 'absolute path' to the given file matches the regex
@@ -106,6 +128,11 @@ CppFile::CppFile(const std::string &f) {
 }
 
 CppFile::~CppFile() {
+    // store the entry again if more code constraints were computed than loaded
+    if (!cache_key.empty() && good()
+            && CppFileCache::countCodeConstraints(*this) != cached_constraints)
+        CppFileCache::store(cache_key, *this);
+
     /* Delete the toplevel block */
     delete topBlock();
 
@@ -149,6 +176,41 @@ const std::string &CppFile::getFileVar() {
     return fileVar;
 }
 
+void CppFile::replaceDefinedSymbols(std::string &exp) const {
+    if (define_map.empty())
+        return;
+    std::string result, symbol;
+    std::string::size_type copied = 0;  // exp is copied to result up to here
+    forEachSymbol(exp, [&](std::string::size_type begin, std::string::size_type end) {
+        symbol.assign(exp, begin, end - begin);
+        auto i = define_map.find(symbol);
+        if (i == define_map.end())
+            return;
+        result.append(exp, copied, begin - copied);
+        result += i->second->getActualSymbol();
+        copied = end;
+    });
+    if (copied == 0)  // nothing was replaced
+        return;
+    result.append(exp, copied, std::string::npos);
+    exp.swap(result);
+}
+
+std::vector<CppDefine *> CppFile::getDefinesOf(const std::string &exp) const {
+    std::map<std::string, CppDefine *> defines;
+    std::string symbol;
+    forEachSymbol(exp, [&](std::string::size_type begin, std::string::size_type end) {
+        symbol.assign(exp, begin, end - begin);
+        auto i = define_map.find(symbol);
+        if (i != define_map.end())
+            defines.insert(*i);
+    });
+    std::vector<CppDefine *> result;
+    for (const auto &entry : defines)  // pair<string, CppDefine *>
+        result.push_back(entry.second);
+    return result;
+}
+
 void CppFile::decisionCoverage() {
 #if 0
     Logging::debug("======== before TRANSFORMATION ========");
@@ -203,7 +265,7 @@ void ConditionalBlock::processForDecisionCoverage() {
         if (prev != this->end() && (*i)->isIfBlock() &&
                 ((*prev)->isIfBlock() || (*prev)->isElseIfBlock())) {
             ConditionalBlock *parent = const_cast<ConditionalBlock *>((*i)->_parent);
-            ConditionalBlockImpl *nblock = createDummyElseBlock(*i, parent, *prev);
+            ConditionalBlock *nblock = cpp_file->getBuilder()->createDummyElseBlock(parent, *prev);
             parent->insert(i, nblock);
             // this inserts the Block also into the correct position in the CppFile List
             insertBlockIntoFile(*i, nblock);
@@ -211,7 +273,7 @@ void ConditionalBlock::processForDecisionCoverage() {
         // when the last element of the list is an if-expression
         if (*i == this->back() && ((*i)->isIfBlock() || (*i)->isElseIfBlock())) {
             ConditionalBlock *parent = const_cast<ConditionalBlock *>((*i)->_parent);
-            ConditionalBlockImpl *nblock = createDummyElseBlock(*i, parent, *i);
+            ConditionalBlock *nblock = cpp_file->getBuilder()->createDummyElseBlock(parent, *i);
             parent->push_back(nblock);
             // this inserts the Block also into the correct position in the CppFile List
             if (*i == this->getFile()->back())
@@ -242,6 +304,14 @@ void ConditionalBlock::printConditionalBlocks(int indent) {
     }
 }
 
+ConditionalBlock::~ConditionalBlock() {
+    delete cached_code_expression;
+    if (ifdef_exp)
+        ifdef_exp->release();
+    if (cached_code_exp)
+        cached_code_exp->release();
+}
+
 void ConditionalBlock::lateConstructor() {
     if (!_parent) // The toplevel block
         return;
@@ -256,8 +326,7 @@ void ConditionalBlock::lateConstructor() {
         _exp.erase(pos,7);
 
     /* Define Rewriting */
-    for (auto &entry : *cpp_file->getDefines())  // pair<string, CppDefine *>
-        entry.second->replaceDefinedSymbol(_exp);
+    cpp_file->replaceDefinedSymbols(_exp);
 }
 
 std::string ConditionalBlock::getConstraintsHelper(UniqueStringJoiner *and_clause) const {
@@ -295,6 +364,45 @@ std::string ConditionalBlock::getConstraintsHelper(UniqueStringJoiner *and_claus
     return join ? and_clause->join(" && ") : "";
 }
 
+kconfig::BoolExp *ConditionalBlock::ifdefExp() const {
+    if (!ifdef_exp && _exp != "") {
+        ifdef_exp = kconfig::BoolExp::parseString(_exp);
+        if (!ifdef_exp)
+            throw CNFBuilderError("CNFBuilder: Couldn't parse: " + _exp);
+    }
+    return ifdef_exp;
+}
+
+// builds the expression, which the parser builds from the clause of getConstraintsHelper()
+void ConditionalBlock::getConstraintExpHelper(BoolExpJoiner &and_clause) const {
+    if (!_parent) {
+        and_clause.push_back(B_VAR("B00", false));
+        return;
+    }
+    kconfig::BoolExp *inner = nullptr;
+    auto append = [&inner](kconfig::BoolExp *e) { inner = inner ? B_AND(inner, e) : e; };
+
+    if (_parent != cpp_file->topBlock())
+        append(B_VAR(_parent->getName(), false));
+
+    if (kconfig::BoolExp *exp = ifdefExp())
+        append(exp->retain());
+
+    kconfig::BoolExp *predecessors = nullptr;
+    for (const ConditionalBlock *block = this; !block->isIfBlock();) {
+        block = block->getPrev();
+        kconfig::BoolExp *var = B_VAR(block->getName(), false);
+        predecessors = predecessors ? B_OR(predecessors, var) : var;
+    }
+    if (predecessors)
+        append(B_NOT(predecessors));
+    // the clause of getConstraintsHelper() doesn't parse either
+    if (!inner)
+        throw CNFBuilderError("CNFBuilder: Couldn't parse the empty expression of " + getName());
+
+    and_clause.push_back(kconfig::BoolExpEq::make(B_VAR(getName(), false), inner));
+}
+
 std::string ConditionalBlock::getCodeConstraints(UniqueStringJoiner *and_clause,
                                                  std::set<ConditionalBlock *> *visited) {
     UniqueStringJoiner sj; // on our stack
@@ -348,25 +456,62 @@ std::string ConditionalBlock::getCodeConstraints(UniqueStringJoiner *and_clause,
                 const_cast<ConditionalBlock *>(block)->getCodeConstraints(and_clause, visited);
 
             and_clause->push_back("B00");
-            for (auto &entry : *cpp_file->getDefines()) {  // pair<string, CppDefine *>
-                CppDefine *define = entry.second;
-                if (define->containsDefinedSymbol(ExpressionStr()))
-                    define->getConstraints(and_clause, visited);
-            }
+            for (CppDefine *define : cpp_file->getDefinesOf(ExpressionStr()))
+                define->getConstraints(and_clause, visited);
         }
     }
 
-    if (!cached_code_expression)
-        cached_code_expression = new std::string(and_clause->join("\n&& "));
+    // Do the join of the and clause only if we are the toplevel clause. The
+    // clause of a recursive call also contains the constraints of its callers.
+    if (!join)
+        return "";
+    cached_code_expression = new std::string(and_clause->join("\n&& "));
+    return *cached_code_expression;
+}
 
-    // Do the join of the and clause only if we are the toplevel clause
-    return join ? and_clause->join("\n&& ") : "";
+kconfig::BoolExp *ConditionalBlock::getCodeConstraintExp() {
+    if (!cached_code_exp) {
+        BoolExpJoiner and_clause;
+        std::set<ConditionalBlock *> visited;
+        getCodeConstraintExps(and_clause, visited);
+        cached_code_exp = and_clause.join();
+    }
+    return cached_code_exp;
+}
+
+// collects the conjuncts of getCodeConstraints() in the same order
+void ConditionalBlock::getCodeConstraintExps(BoolExpJoiner &and_clause,
+                                             std::set<ConditionalBlock *> &visited) {
+    if (!visited.insert(this).second)
+        return;
+
+    if (!_parent) { // Toplevel block
+        for (ConditionalBlock *block : *cpp_file)
+            block->getConstraintExpHelper(and_clause);
+        for (auto &entry : *cpp_file->getDefines())  // pair<string, CppDefine *>
+            entry.second->getConstraintExpHelper(and_clause);
+        and_clause.push_back(B_VAR("B00", false));
+        return;
+    }
+    getConstraintExpHelper(and_clause);
+
+    const ConditionalBlock *block = isIfBlock() ? getParent() : getPrev();
+    if (block && block != cpp_file->topBlock())
+        const_cast<ConditionalBlock *>(block)->getCodeConstraintExps(and_clause, visited);
+
+    and_clause.push_back(B_VAR("B00", false));
+    for (CppDefine *define : cpp_file->getDefinesOf(ExpressionStr()))
+        define->getConstraintExps(and_clause, visited);
 }
 
 std::string ConditionalBlock::getBuildSystemCondition() const {
     return "( B00 <-> " + fileVar() + " )";
 }
 
+kconfig::BoolExp *ConditionalBlock::getBuildSystemConditionExp() const {
+    return kconfig::BoolExpEq::make(B_VAR("B00", false), B_VAR(fileVar(), false));
+}
+
 /************************************************************************/
 /* CppDefine                                                            */
 /************************************************************************/
@@ -376,17 +521,20 @@ CppDefine::CppDefine(ConditionalBlock *defined_in, bool define, const std::strin
     newDefine(defined_in, define);
 }
 
+CppDefine::CppDefine(const std::string &id) : actual_symbol(id), defined_symbol(id) {}
+
+CppDefine::~CppDefine() {
+    for (kconfig::BoolExp *e : defineExps)
+        e->release();
+}
+
 void CppDefine::newDefine(ConditionalBlock *parent, bool define) {
     const char *rewriteToken = ".";
     std::string new_symbol = actual_symbol + rewriteToken;
 
     /* Was also defined here */
     defined_in.push_back(parent);
-
-    // If actual define is an undef insert it into the undef map
-    if (!define) {
-        isUndef.insert(parent->getName());
-    }
+    isUndef.push_back(!define);
 
     // If actual Block is selected, we select or deselect the flag
     std::string right_side = (define ? "" : "!") + new_symbol;
@@ -397,35 +545,27 @@ void CppDefine::newDefine(ConditionalBlock *parent, bool define) {
     // !block defined -> old symbol == new_symbol
     defineExpressions.push_back("(!" + parent->getName() + " -> (" + actual_symbol + " <-> " + new_symbol + "))");
 
+    // the same expressions, as the parser builds them
+    kconfig::BoolExp *new_var = B_VAR(new_symbol, false);
+    defineExps.push_back(B_IMPL(B_VAR(parent->getName(), false),
+                                define ? new_var->retain() : B_NOT(new_var->retain())));
+    defineExps.push_back(B_IMPL(B_NOT(B_VAR(parent->getName(), false)),
+                                kconfig::BoolExpEq::make(B_VAR(actual_symbol, false), new_var)));
+
     /* B --> B. */
     actual_symbol = new_symbol;
-
-    const std::string symbolSpace = "([() ><&|!-]|^|$)";
-
-    replaceRegex = boost::regex(symbolSpace + "(" + defined_symbol + ")" + symbolSpace);
 }
 
-void CppDefine::replaceDefinedSymbol(std::string &exp) {
-    if (exp.find(defined_symbol) == exp.npos)  // exp doesn't contain defined_symbol
-        return;
-
-    boost::match_results<std::string::iterator> what;
-    while (boost::regex_search(exp.begin(), exp.end(), what, replaceRegex))
-        exp.replace(what[2].first, what[2].second, actual_symbol);
-}
-
-bool CppDefine::containsDefinedSymbol(const std::string &exp) {
-    if (exp.find(defined_symbol) == exp.npos)  // exp doesn't contain defined_symbol
-        return false;
-    return boost::regex_search(exp, replaceRegex);
-}
-
-
 void CppDefine::getConstraintsHelper(UniqueStringJoiner *and_clause) const {
     for (const std::string &str : defineExpressions)
         and_clause->push_back(str);
 }
 
+void CppDefine::getConstraintExpHelper(BoolExpJoiner &and_clause) const {
+    for (kconfig::BoolExp *e : defineExps)
+        and_clause.push_back(e->retain());
+}
+
 std::string CppDefine::getConstraints(UniqueStringJoiner *and_clause,
                                       std::set<ConditionalBlock *> *visited) const {
     UniqueStringJoiner sj; // on our stack
@@ -449,3 +589,13 @@ std::string CppDefine::getConstraints(UniqueStringJoiner *and_clause,
     }
     return join ? and_clause->join("\n&& ") : "";
 }
+
+void CppDefine::getConstraintExps(BoolExpJoiner &and_clause,
+                                  std::set<ConditionalBlock *> &visited) const {
+    getConstraintExpHelper(and_clause);
+
+    for (ConditionalBlock *block : defined_in)
+        // Not yet visited and not the toplevel block
+        if (visited.count(block) == 0 && block->getParent() != nullptr)
+            block->getCodeConstraintExps(and_clause, visited);
+}
@@ -26,12 +26,17 @@
 
 #include "BlockDefectAnalyzer.h"
 
+#include <atomic>
 #include <boost/regex.hpp>
 
 class ConditionalBlock;
+class ConditionalBlockBuilder;
 class CppDefine;
-class PumaConditionalBlockBuilder;
 struct UniqueStringJoiner;
+class BoolExpJoiner;
+namespace kconfig {
+    class BoolExp;
+}
 
 typedef std::list<ConditionalBlock *> CondBlockList;
 
@@ -46,17 +51,36 @@ class CppFile : public CondBlockList {
     std::string specific_arch;
     ConditionalBlock *top_block = nullptr;
     std::map<std::string, CppDefine *> define_map;
-    std::unique_ptr<PumaConditionalBlockBuilder> _builder;
+    std::unique_ptr<ConditionalBlockBuilder> _builder;
+    std::string cache_key;  // key of the entry in the CppFileCache, empty if not cached
+    long cached_constraints = -1;  // code constraints of the loaded entry, -1 if none was loaded
 
     void printCppFile();
 
     static const boost::regex filename_regex;
 
 public:
-    //! \param filename file with cpp expressions to parse
-    explicit CppFile(const std::string &filename);
+    //! the parsers that build the blocks of a file
+    enum class Parser {
+        PUMA,     //!< full Puma preprocessor, needed for source output
+        SCANNER,  //!< lightweight scanner for the preprocessor directives only
+    };
+
+    /**
+     * \param filename file with cpp expressions to parse
+     * \param cached if set and the CppFileCache is enabled, the blocks are
+     *        loaded from the cache when possible and stored there afterwards
+     */
+    explicit CppFile(const std::string &filename, bool cached = true);
     ~CppFile();
 
+    //! selects the parser of all files created afterwards, undertaker sets it for each job
+    static void setParser(Parser p) { parser = p; }
+    static Parser getParser() { return parser; }
+
+    //! \return the builder that created the blocks of this file
+    ConditionalBlockBuilder *getBuilder() const { return _builder.get(); }
+
     //! Check if the file was correctly parsed
     bool good() { return top_block ? true : false; };
 
@@ -73,6 +97,15 @@ public:
      */
     DefineMap *getDefines() { return &define_map; };
 
+    /**
+     * Replaces each symbol of the expression, which is defined in this file,
+     * by its current rewrite, e.g., FOO by FOO.. after its second #define.
+     */
+    void replaceDefinedSymbols(std::string &exp) const;
+
+    //! \return the defines of the symbols in the expression, ordered by symbol
+    std::vector<CppDefine *> getDefinesOf(const std::string &exp) const;
+
     //! \return filename given in the constructor
     const std::string &getFilename() const { return filename; };
 
@@ -97,6 +130,35 @@ public:
             return defines.find(item.substr(0, item.find('.'))) == defines.end();
         };
     }
+
+private:
+    static std::atomic<Parser> parser;
+};
+
+/************************************************************************/
+/* ConditionalBlockBuilder                                              */
+/************************************************************************/
+
+//! \brief creates the block tree of a CppFile
+class ConditionalBlockBuilder {
+public:
+    virtual ~ConditionalBlockBuilder() {}
+
+    //! \return the top block of the file, nullptr if parsing failed
+    virtual ConditionalBlock *topBlock() = 0;
+
+    //! \return an artificial #else block, used for decision coverage
+    virtual ConditionalBlock *createDummyElseBlock(ConditionalBlock *parent,
+                                                   ConditionalBlock *prev) = 0;
+
+    //! \return the files pasted into the file by #include directives
+    const std::vector<std::string> &includedFiles() const { return _included; }
+    //! \return the paths, at which #include directives looked for a file in vain
+    const std::vector<std::string> &missingIncludes() const { return _missing; }
+
+protected:
+    std::vector<std::string> _included;
+    std::vector<std::string> _missing;
 };
 
 /************************************************************************/
@@ -106,6 +168,9 @@ public:
 class ConditionalBlock : public CondBlockList {
     std::string _exp;
     std::string *cached_code_expression = nullptr;
+    //! the parsed _exp and the code constraints as expression, built on demand
+    mutable kconfig::BoolExp *ifdef_exp = nullptr;
+    kconfig::BoolExp *cached_code_exp = nullptr;
 
     void insertBlockIntoFile(ConditionalBlock *prevBlock, ConditionalBlock *nblock,
                              bool insertAfter = false);
@@ -150,7 +215,7 @@ public:
     //! Has to be called after constructing a ConditionalBlock
     void lateConstructor();
 
-    virtual ~ConditionalBlock() { delete cached_code_expression; };
+    virtual ~ConditionalBlock();
 
     //! \return name of the file containing this block
     const std::string &filename() const { return cpp_file->getFilename(); };
@@ -168,15 +233,36 @@ public:
 
     //! \return rewritten (define) macro expression
     std::string ifdefExpression() const { return _exp; };
+    /**
+     * \return the parsed ifdefExpression(), owned by the block, nullptr if it is empty
+     * \throws CNFBuilderError if the expression can't be parsed
+     */
+    kconfig::BoolExp *ifdefExp() const;
 
     std::string getCodeConstraints(UniqueStringJoiner *and_clause = nullptr,
                                    std::set<ConditionalBlock *> *visited = nullptr);
+    /**
+     * \brief the code constraints of getCodeConstraints() as expression
+     *
+     * The conjunction is built from the parsed ifdef expressions of the
+     * blocks, the same way the parser builds it from the formula of
+     * getCodeConstraints(). Only the checks need it, the formula is
+     * formatted for the output only.
+     * \return the expression, owned by the block
+     * \throws CNFBuilderError if the expression of a block can't be parsed
+     */
+    kconfig::BoolExp *getCodeConstraintExp();
+    //! adds the conjuncts of getCodeConstraintExp() for the blocks that aren't visited yet
+    void getCodeConstraintExps(BoolExpJoiner &and_clause, std::set<ConditionalBlock *> &visited);
 
     std::string getBuildSystemCondition() const;
+    //! \return a new reference to getBuildSystemCondition() as expression
+    kconfig::BoolExp *getBuildSystemConditionExp() const;
 
     void addDefine(CppDefine *define) { _defines.push_back(define); }
 
     std::string getConstraintsHelper(UniqueStringJoiner *and_clause = nullptr) const;
+    void getConstraintExpHelper(BoolExpJoiner &and_clause) const;
     const std::deque<CppDefine *> &getDefines() const { return _defines; };
 
     //! the following functions have to be public because decisionCoverage() is
@@ -195,6 +281,8 @@ protected:
     std::deque<CppDefine *> _defines;
     //!< if set blocknames of getName() are extended with a normalized filename
     static bool useBlockWithFilename;
+
+    friend class CppFileCache;
 };
 
 /************************************************************************/
@@ -202,26 +290,36 @@ protected:
 /************************************************************************/
 
 class CppDefine {
-    std::set<std::string> isUndef;
     std::string actual_symbol;  // The defined symbol will be replaced by this
     std::string defined_symbol;  // The defined symbol
 
     std::deque<ConditionalBlock *> defined_in;
+    std::deque<bool> isUndef;  // for each block of defined_in
     std::deque<std::string> defineExpressions;
+    std::deque<kconfig::BoolExp *> defineExps;  // defineExpressions as expressions
+
+    //! restores a define from the CppFileCache, which replays its directives with newDefine()
+    explicit CppDefine(const std::string &id);
 
-    boost::regex replaceRegex;
+    friend class CppFileCache;
 
 public:
     CppDefine(ConditionalBlock *parent, bool define, const std::string &id);
+    ~CppDefine();
+    CppDefine(const CppDefine &) = delete;
+    CppDefine &operator=(const CppDefine &) = delete;
+
     void newDefine(ConditionalBlock *parent, bool define);
 
-    void replaceDefinedSymbol(std::string &exp);
+    //! \return the symbol, which replaces the defined symbol in following expressions
+    const std::string &getActualSymbol() const { return actual_symbol; }
 
     std::string getConstraints(UniqueStringJoiner *and_clause = nullptr,
                                std::set<ConditionalBlock *> *visited = nullptr) const;
 
     void getConstraintsHelper(UniqueStringJoiner *and_clause) const;
 
-    bool containsDefinedSymbol(const std::string &exp);
+    void getConstraintExps(BoolExpJoiner &and_clause, std::set<ConditionalBlock *> &visited) const;
+    void getConstraintExpHelper(BoolExpJoiner &and_clause) const;
 };
 #endif /* _CONDITIONALBLOCK_H_ */
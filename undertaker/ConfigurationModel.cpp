@@ -21,9 +21,16 @@
 
 #include "ConfigurationModel.h"
 #include "StringJoiner.h"
+#include "BoolExpPropagator.h"
+#include "BoolExpSymbolSet.h"
+#include "KconfigWhitelist.h"
+#include "PicosatCNF.h"
 #include "Tools.h"
 #include "Logging.h"
 
+#include <boost/filesystem.hpp>
+#include <fstream>
+
 
 std::string ConfigurationModel::getMissingItemsConstraints(const std::set<std::string> &missing) {
     StringJoiner sj;
@@ -35,13 +42,107 @@ std::string ConfigurationModel::getMissingItemsConstraints(const std::set<std::s
     return {};
 }
 
+void ConfigurationModel::setIdentity(const std::vector<std::string> &filenames) {
+    _identity = _name + ":" + getModelVersionIdentifier();
+    for (const std::string &filename : filenames)
+        _identity += ":" + undertaker::fileHash(filename);
+}
+
+void ConfigurationModel::loadBackbone(const std::string &filename) {
+    static const std::string backbone_on("BACKBONE_ON"), backbone_off("BACKBONE_OFF");
+    auto addItems = [this](const StringList *items, bool value) {
+        if (items)
+            for (const std::string &item : *items)
+                _backbone.emplace(item, value);
+    };
+    if (getMetaValue(backbone_on) || getMetaValue(backbone_off)) {
+        addItems(getMetaValue(backbone_on), true);
+        addItems(getMetaValue(backbone_off), false);
+        return;
+    }
+    // the first line is the identity of the model the cache was computed for
+    const std::string cachename = filename + ".backbone";
+    std::ifstream in(cachename);
+    std::string line;
+    if (std::getline(in, line) && line == _identity) {
+        while (std::getline(in, line))
+            if (!line.empty())
+                _backbone.emplace(line[0] == '!' ? line.substr(1) : line, line[0] != '!');
+        Logging::debug("read ", _backbone.size(), " fixed items of ", _name, " from ", cachename);
+        return;
+    }
+    std::unique_ptr<kconfig::PicosatCNF> cnf = createCNF();
+    if (cnf->computeBackbone()) {
+        addItems(cnf->getMetaValue(backbone_on), true);
+        addItems(cnf->getMetaValue(backbone_off), false);
+    } else {
+        Logging::debug("the model ", _name, " is unsatisfiable, it has no backbone");
+    }
+    // e.g., /dev/null
+    if (!boost::filesystem::is_regular_file(filename))
+        return;
+    std::string cache = _identity + "\n";
+    for (const auto &entry : _backbone)  // pair<string, bool>
+        cache += (entry.second ? "" : "!") + entry.first + "\n";
+    if (!undertaker::writeFileAtomically(cachename, cache))
+        Logging::warn("couldn't write ", cachename, ", the backbone of ", _name,
+                      " is computed again at the next load");
+}
+
+const std::map<std::string, bool> &ConfigurationModel::getBackbone() const {
+    static const std::map<std::string, bool> none;
+    return KconfigWhitelist::getIgnorelist().empty() ? _backbone : none;
+}
+
+bool ConfigurationModel::contradictsBackbone(kconfig::BoolExp *exp) const {
+    const std::map<std::string, bool> &backbone = getBackbone();
+    if (backbone.empty())
+        return false;
+    kconfig::BoolExpPropagator propagator(kconfig::CNFBuilder::ConstantPolicy::FREE);
+    kconfig::BoolExpSymbolSet symbols(exp);
+    for (const std::string &item : symbols.getSymbolSet()) {
+        const auto &it = backbone.find(item);
+        if (it != backbone.end())
+            propagator.assign(item, it->second);
+    }
+    return !propagator.propagate(exp);
+}
+
+std::string ConfigurationModel::getBackboneConstraints(kconfig::BoolExp *exp) const {
+    const std::map<std::string, bool> &backbone = getBackbone();
+    StringJoiner sj;
+    kconfig::BoolExpSymbolSet symbols(exp);
+    for (const std::string &item : symbols.getSymbolSet()) {
+        const auto &it = backbone.find(item);
+        if (it != backbone.end())
+            sj.push_back(it->second ? item : "!" + item);
+    }
+    return sj.join(" && ");
+}
+
 std::set<std::string> ConfigurationModel::doIntersect(const std::string exp,
                                                       const std::function<bool(std::string)> &c,
                                                       std::set<std::string> &missing,
                                                       std::string &intersected,
                                                       std::set<std::string> *exclude_set) const {
-    std::set<std::string> start_items = undertaker::itemsOfString(exp);
+    return doIntersectItems(undertaker::itemsOfString(exp), c, missing, intersected, exclude_set);
+}
+
+std::set<std::string> ConfigurationModel::doIntersect(kconfig::BoolExp *exp,
+                                                      const std::function<bool(std::string)> &c,
+                                                      std::set<std::string> &missing,
+                                                      std::string &intersected,
+                                                      std::set<std::string> *exclude_set) const {
+    // the variables of the expression, without building and parsing its string
+    kconfig::BoolExpSymbolSet symbols(exp);
+    return doIntersectItems(symbols.getSymbolSet(), c, missing, intersected, exclude_set);
+}
 
+std::set<std::string>
+ConfigurationModel::doIntersectItems(std::set<std::string> start_items,
+                                     const std::function<bool(std::string)> &c,
+                                     std::set<std::string> &missing, std::string &intersected,
+                                     std::set<std::string> *exclude_set) const {
     StringJoiner sj;
     doIntersectPreprocess(start_items, sj, exclude_set);  // preprocess depending on model type
 
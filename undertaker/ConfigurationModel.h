@@ -26,11 +26,18 @@
 
 #include <string>
 #include <set>
+#include <map>
 #include <deque>
+#include <memory>
+#include <vector>
 #include <boost/regex.hpp>
 
 using StringList = std::deque<std::string>;
 struct StringJoiner;
+namespace kconfig {
+    class BoolExp;
+    class PicosatCNF;
+}
 
 
 class ConfigurationModel {
@@ -39,6 +46,12 @@ class ConfigurationModel {
 
     virtual void addMetaValue(const std::string &key, const std::string &feature) const = 0;
 
+    std::set<std::string> doIntersectItems(std::set<std::string> start_items,
+                                           const std::function<bool(std::string)> &c,
+                                           std::set<std::string> &missing,
+                                           std::string &intersected,
+                                           std::set<std::string> *exclude_set) const;
+
 public:
     //! destructor
     virtual ~ConfigurationModel(){};
@@ -72,6 +85,11 @@ public:
                                       const std::function<bool(std::string)> &c,
                                       std::set<std::string> &missing, std::string &intersected,
                                       std::set<std::string> *exclude_set = nullptr) const;
+    //! like doIntersect() on a string, the expression may be nullptr
+    std::set<std::string> doIntersect(kconfig::BoolExp *exp,
+                                      const std::function<bool(std::string)> &c,
+                                      std::set<std::string> &missing, std::string &intersected,
+                                      std::set<std::string> *exclude_set = nullptr) const;
 
     //! add feature to whitelist ('ALWAYS_ON')
     void addFeatureToWhitelist(const std::string &feature);
@@ -87,18 +105,61 @@ public:
     //! The referenced object must not be freed, the model class manages it.
     const StringList *getBlacklist() const;
 
+    //! the items that have the same value in all configurations of the model, with that value
+    /*!
+     * Found when the model is loaded, see loadBackbone(). Empty if an ignorelist is given, as
+     * the checks leave its items free and thereby cut them out of the model.
+     */
+    const std::map<std::string, bool> &getBackbone() const;
+
+    //! \return true if the items fixed by the model contradict the expression
+    /*!
+     * Decided without a solver, see kconfig::BoolExpPropagator. Like in the checks of the
+     * block defects, the constants in the expression are free.
+     */
+    bool contradictsBackbone(kconfig::BoolExp *exp) const;
+
+    //! the fixed values of the items in the expression, as conjunction of literals
+    /*!
+     * The defect reports of blocks refuted by contradictsBackbone() contain
+     * them, so that their formula is unsatisfiable on its own.
+     */
+    std::string getBackboneConstraints(kconfig::BoolExp *exp) const;
+
     //! checks if we can assume that the configuration space is complete
     bool isComplete() const;
     //! checks if a given item should be in the model space
     bool inConfigurationSpace(const std::string &symbol) const;
     std::string getName() const { return _name; }
+    //! identifies the content of the model files, changes when one of them is modified
+    const std::string &getIdentity() const { return _identity; }
 
     static std::string getMissingItemsConstraints(const std::set<std::string> &missing);
 
 protected:
     ConfigurationModel() = default;
 
+    //! sets the identity from the name and the hashed content of the given files
+    void setIdentity(const std::vector<std::string> &filenames);
+
+    //! \return a cnf with all constraints of the model
+    virtual std::unique_ptr<kconfig::PicosatCNF> createCNF() const = 0;
+
+    /**
+     * \brief finds the items that the model fixes, called when the model is loaded
+     *
+     * Models converted with rsf2cnf -k store them in the meta values
+     * BACKBONE_ON and BACKBONE_OFF. The backbone of other models is computed
+     * once on the cnf of createCNF() and cached in the file
+     * <filename>.backbone, which is only used as long as the identity of the
+     * model stays the same.
+     */
+    void loadBackbone(const std::string &filename);
+
     std::string _name;
+    std::string _identity;
     boost::regex _inConfigurationSpace_regexp;
+    //! the items fixed by the model, see getBackbone()
+    std::map<std::string, bool> _backbone;
 };
 #endif
@@ -24,8 +24,13 @@
 #include "ConditionalBlock.h"
 #include "ConfigurationModel.h"
 #include "exceptions/CNFBuilderError.h"
+#include "exceptions/SatBudgetExceeded.h"
 #include "Logging.h"
 
+#include <boost/regex.hpp>
+
+#include <unordered_set>
+
 
 /************************************************************************/
 /* CoverageAnalyzer                                                     */
@@ -43,8 +48,16 @@ std::string CoverageAnalyzer::baseFileExpression(const ConfigurationModel *model
         code_formula += file->topBlock()->getBuildSystemCondition();
         formula.push_back(file->topBlock()->getBuildSystemCondition());
 
-        model->doIntersect(code_formula, file->getDefineChecker(), missingSet, kconfig_formula);
+        std::set<std::string> items = model->doIntersect(code_formula, file->getDefineChecker(),
+                                                         missingSet, kconfig_formula);
         formula.push_back(kconfig_formula);
+        // the items of the file that the model fixes, the solver doesn't have to find them
+        const std::map<std::string, bool> &backbone = model->getBackbone();
+        for (const std::string &str : items) {
+            const auto &it = backbone.find(str);
+            if (it != backbone.end())
+                formula.push_back(it->second ? str : "!" + str);
+        }
         // only add missing items if we can assume the model is complete
         if (model->isComplete()) {
             for (const std::string &str : missingSet)
@@ -73,52 +86,53 @@ std::string CoverageAnalyzer::baseFileExpression(const ConfigurationModel *model
 /* SimpleCoverageAnalyzer                                               */
 /************************************************************************/
 
-std::list<SatChecker::AssignmentMap> SimpleCoverageAnalyzer::blockCoverage(ConfigurationModel *model) {
+std::list<SatChecker::AssignmentMap> SimpleCoverageAnalyzer::blockCoverage(ConfigurationModel *model,
+                                                                          FileBudget &budget) {
     std::set<std::string> blocks_set;
     std::list<SatChecker::AssignmentMap> ret;
-    std::set<SatChecker::AssignmentMap> found_solutions;
+    std::unordered_set<SatChecker::AssignmentMap, SatChecker::AssignmentMap::Hash> found_solutions;
+
+    static const boost::regex block_regexp("^B\\d+$");
+    SatChecker::AssignmentMap::Filter blocks([](const std::string &name) {
+        return boost::regex_match(name, block_regexp);
+    });
+    // No blocks in the assignment maps. If a model is given, only the symbols in its
+    // configuration space make a difference.
+    SatChecker::AssignmentMap::Filter symbols([model](const std::string &name) {
+        return !boost::regex_match(name, block_regexp)
+               && (!model || model->inConfigurationSpace(name));
+    });
     try {
         BaseExpressionSatChecker sc(baseFileExpression(model), model);
 
         for (const auto &block : *file) {      // ConditionalBlock *
-            SatChecker::AssignmentMap current_solution;
-
             if (blocks_set.find(block->getName()) == blocks_set.end()) {
                 /* does this block contribute to the set of configurations? */
                 bool new_solution = false;
 
-                // unsolvable, i.e. we have found some defect!
-                if (!sc( { block->getName() } ))
+                if (budget.exhausted()) {
+                    budget.markUnknown(block->getName(), FileBudget::timeout_reason);
                     continue;
-
-                static const boost::regex block_regexp("^B\\d+$");
-                for (const auto &assignment : sc.getAssignment()) { // pair<string, bool>
-                    const std::string &name = assignment.first;
-                    const bool enabled = assignment.second;
-
-                    if (boost::regex_match(name, block_regexp)) {
-                        // if a block is enabled, and not already in the block set, we enable it
-                        // with this configuration and get a new solution
-                        if (enabled && blocks_set.find(name) == blocks_set.end()) {
-                            blocks_set.insert(name);
-                            new_solution = true;
-                        }
-                        // No blocks in the assignment maps
+                }
+                try {
+                    // unsolvable, i.e. we have found some defect!
+                    if (!sc( { block->getName() } ))
                         continue;
-                    }
-
-                    // If no model is given or the symbol is in the model space we can push the
-                    // assignment to the current solution.
-                    if (!model || model->inConfigurationSpace(name))
-                        current_solution.emplace(name, enabled);
+                } catch (SatBudgetExceeded &e) {
+                    budget.markUnknown(block->getName(), e.what());
+                    continue;
                 }
 
-                if (found_solutions.find(current_solution) == found_solutions.end()) {
-                    found_solutions.insert(current_solution);
-
-                    if (new_solution)
-                        ret.push_back(sc.getAssignment());
+                const SatChecker::AssignmentMap &assignment = sc.getAssignment();
+                for (const auto &entry : assignment.select(blocks)) {  // pair<string, bool>
+                    // if a block is enabled, and not already in the block set, we enable it
+                    // with this configuration and get a new solution
+                    if (entry.second && blocks_set.insert(entry.first).second)
+                        new_solution = true;
                 }
+
+                if (found_solutions.insert(assignment.select(symbols)).second && new_solution)
+                    ret.push_back(assignment);
             }
         }
     } catch (CNFBuilderError &e) {
@@ -133,7 +147,8 @@ std::list<SatChecker::AssignmentMap> SimpleCoverageAnalyzer::blockCoverage(Confi
 /* MinimizeCoverageAnalyzer                                             */
 /************************************************************************/
 
-std::list<SatChecker::AssignmentMap> MinimizeCoverageAnalyzer::blockCoverage(ConfigurationModel *model) {
+std::list<SatChecker::AssignmentMap> MinimizeCoverageAnalyzer::blockCoverage(ConfigurationModel *model,
+                                                                            FileBudget &budget) {
     std::set<std::string> blocks_set;
     std::list<SatChecker::AssignmentMap> ret;
 
@@ -145,15 +160,27 @@ std::list<SatChecker::AssignmentMap> MinimizeCoverageAnalyzer::blockCoverage(Con
         // simple algorithm. For the all blocks not enabled there we do the minimizer algorithm
         BaseExpressionSatChecker sc(baseFileExpression(model), model);
 
-        if(sc(configuration)) { // Configuration is an empty list here
+        // a check that runs out of budget doesn't enable the blocks of the configuration
+        auto check = [&]() {
+            try {
+                return sc(configuration);
+            } catch (SatBudgetExceeded &e) {
+                // only a block checked on its own is given up
+                if (configuration.size() == 1)
+                    budget.markUnknown(*configuration.begin(), e.what());
+                return false;
+            }
+        };
+
+        if(check()) { // Configuration is an empty list here
             static const boost::regex block_regexp("^B\\d+$");
-            for (const auto &assignment : sc.getAssignment()) {  // pair<string, bool>
+            SatChecker::AssignmentMap::Filter blocks([](const std::string &name) {
+                return boost::regex_match(name, block_regexp);
+            });
+            for (const auto &assignment : sc.getAssignment().select(blocks)) {  // pair<string, bool>
                 if (assignment.second == false) continue; // Not enabled
-                const std::string &block_name = assignment.first;
-                if (boost::regex_match(block_name, block_regexp)) {
-                    configuration.insert(block_name);
-                    blocks_set.insert(block_name);
-                }
+                configuration.insert(assignment.first);
+                blocks_set.insert(assignment.first);
             }
             goto dump_configuration;
         }
@@ -166,6 +193,12 @@ std::list<SatChecker::AssignmentMap> MinimizeCoverageAnalyzer::blockCoverage(Con
                 // Was already enabled in an other configuration
                 if (blocks_set.count(block_name) > 0) continue;
 
+                if (budget.exhausted()) {
+                    budget.markUnknown(block_name, FileBudget::timeout_reason);
+                    blocks_set.insert(block_name);
+                    continue;
+                }
+
                 // We check here if the selected block is surely in conflict with another block
                 // already in the current configuration.
                 // e.g We have the if clause already in the set, then the else clause will surely
@@ -186,7 +219,7 @@ std::list<SatChecker::AssignmentMap> MinimizeCoverageAnalyzer::blockCoverage(Con
 
                 configuration.insert(block->getName());
 
-                if (!sc(configuration)) {
+                if (!check()) {
                     // Block couldn't be enabled
                     if (configuration.size() == 1) {
                         // dead block; just ignore it
@@ -216,6 +249,8 @@ std::list<SatChecker::AssignmentMap> MinimizeCoverageAnalyzer::blockCoverage(Con
         Logging::error("Couldn't process ", file->getFilename(), ": ", e.what());
     } catch (std::bad_alloc &) {
         Logging::error("Couldn't process ", file->getFilename(), ": Out of Memory.");
+    } catch (SatBudgetExceeded &e) {
+        Logging::error("Couldn't process ", file->getFilename(), ": ", e.what());
     }
     return ret;
 }
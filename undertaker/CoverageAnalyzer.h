@@ -38,7 +38,14 @@ class ConfigurationModel;
 
 class CoverageAnalyzer {
 public:
-    virtual std::list<SatChecker::AssignmentMap> blockCoverage(ConfigurationModel *) = 0;
+    /**
+     * \brief configurations that enable the blocks of the file
+     *
+     * Blocks whose checks run out of budget are recorded as unknown in the
+     * budget and left out.
+     */
+    virtual std::list<SatChecker::AssignmentMap> blockCoverage(ConfigurationModel *,
+                                                               FileBudget &) = 0;
 
     // NB: missingSet is filled during blockCoverage run
     MissingSet getMissingSet() const { return missingSet; }
@@ -60,7 +67,8 @@ protected:
 class SimpleCoverageAnalyzer : public CoverageAnalyzer {
 public:
     explicit SimpleCoverageAnalyzer(CppFile *f) : CoverageAnalyzer(f){};
-    std::list<SatChecker::AssignmentMap> blockCoverage(ConfigurationModel *) final override;
+    std::list<SatChecker::AssignmentMap> blockCoverage(ConfigurationModel *,
+                                                       FileBudget &) final override;
 };
 
 /************************************************************************/
@@ -70,6 +78,7 @@ public:
 class MinimizeCoverageAnalyzer : public CoverageAnalyzer {
 public:
     explicit MinimizeCoverageAnalyzer(CppFile *f) : CoverageAnalyzer(f){};
-    std::list<SatChecker::AssignmentMap> blockCoverage(ConfigurationModel *) final override;
+    std::list<SatChecker::AssignmentMap> blockCoverage(ConfigurationModel *,
+                                                       FileBudget &) final override;
 };
 #endif /* _COVERAGEANALYZER_H_ */
@@ -0,0 +1,313 @@
+/*
+ *   undertaker - analyze preprocessor blocks in code
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "CppFileCache.h"
+#include "ScannerConditionalBlock.h"
+#include "Logging.h"
+#include "Tools.h"
+
+#include <algorithm>
+#include <boost/filesystem.hpp>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <vector>
+
+
+std::string CppFileCache::_directory;
+
+namespace {
+    // bump whenever the layout of the entries changes
+    const char *const format = "undertaker cppfile 3";
+
+    typedef ScannerConditionalBlock::Kind Kind;
+
+    // strings are stored with their length, they may contain newlines
+    void putString(std::ostream &out, const std::string &str) {
+        out << str.size() << ' ' << str << '\n';
+    }
+
+    bool getString(std::istream &in, std::string &str) {
+        size_t size;
+        if (!(in >> size) || in.get() != ' ')
+            return false;
+        str.resize(size);
+        return in.read(&str[0], size) && in.get() == '\n';
+    }
+
+    Kind kindOf(const ConditionalBlock *block) {
+        if (!block->getParent())
+            return Kind::TOP;
+        if (block->isIfndefine())
+            return Kind::IFNDEF;
+        if (block->isElseIfBlock())
+            return Kind::ELIF;
+        if (block->isElseBlock())
+            return Kind::ELSE;
+        return Kind::IF;
+    }
+
+    struct BlockRecord {
+        unsigned long number;
+        int kind;
+        long parent, prev;
+        unsigned int lineStart, colStart, lineEnd, colEnd;
+        std::string expression, ifdefExpression;
+        bool hasCodeConstraints;
+        std::string codeConstraints;
+        std::vector<size_t> defines;
+    };
+
+    // the #define and #undef directives of a symbol, in order
+    struct DefineRecord {
+        std::string defined_symbol;
+        std::vector<size_t> defined_in;
+        std::vector<bool> undef;
+    };
+
+    bool readBlock(std::istream &in, BlockRecord &r) {
+        size_t defines;
+        if (!(in >> r.number >> r.kind >> r.parent >> r.prev >> r.lineStart >> r.colStart
+                 >> r.lineEnd >> r.colEnd >> r.hasCodeConstraints) || in.get() != '\n')
+            return false;
+        if (!getString(in, r.expression) || !getString(in, r.ifdefExpression))
+            return false;
+        if (r.hasCodeConstraints && !getString(in, r.codeConstraints))
+            return false;
+        if (!(in >> defines))
+            return false;
+        r.defines.resize(defines);
+        for (size_t &define : r.defines)
+            if (!(in >> define))
+                return false;
+        return true;
+    }
+
+    bool readDefine(std::istream &in, DefineRecord &r) {
+        size_t count;
+        if (!getString(in, r.defined_symbol) || !(in >> count))
+            return false;
+        r.defined_in.resize(count);
+        r.undef.resize(count);
+        for (size_t i = 0; i < count; i++) {
+            bool undef;
+            if (!(in >> r.defined_in[i] >> undef))
+                return false;
+            r.undef[i] = undef;
+        }
+        return true;
+    }
+} // namespace
+
+std::string CppFileCache::key(const std::string &path, const std::string &filename) {
+    const std::string content = undertaker::fileHash(path);
+    if (content.empty())
+        return "";
+    std::stringstream key;
+    key << format << "\n";
+    key << "parser " << static_cast<int>(CppFile::getParser()) << "\n";
+    // block names contain the filename if requested
+    if (ConditionalBlock::useBlockWithFilename)
+        key << "names " << filename << "\n";
+    key << "directory "
+        << boost::filesystem::absolute(path).parent_path().string() << "\n";
+    // -I adds every path to both parsers
+    for (const std::string &include : ScannerConditionalBlockBuilder::getIncludePaths())
+        key << "include " << include << "\n";
+    key << "content " << content;
+    return key.str();
+}
+
+std::unique_ptr<CppFileCache> CppFileCache::lookup(CppFile *file, const std::string &key) {
+    // different keys may have the same hash, hence the file contains the key
+    std::ifstream in(undertaker::cacheFilename(_directory, key));
+    std::string stored_key;
+    if (!getString(in, stored_key) || stored_key != key)
+        return nullptr;
+
+    std::unique_ptr<CppFileCache> cache(new CppFileCache(file));
+    size_t included;
+    if (!(in >> included) || in.get() != '\n')
+        return nullptr;
+    for (size_t i = 0; i < included; i++) {
+        std::string path, hash;
+        if (!getString(in, path) || !getString(in, hash) || undertaker::fileHash(path) != hash)
+            return nullptr;
+        cache->_included.push_back(path);
+    }
+    // an #include that didn't resolve may find its file by now
+    size_t missing;
+    if (!(in >> missing) || in.get() != '\n')
+        return nullptr;
+    for (size_t i = 0; i < missing; i++) {
+        std::string path;
+        boost::system::error_code ec;
+        if (!getString(in, path) || boost::filesystem::is_regular_file(path, ec))
+            return nullptr;
+        cache->_missing.push_back(path);
+    }
+    if (!cache->load(in)) {
+        Logging::debug("Ignoring corrupt cache entry of ", file->getFilename());
+        return nullptr;
+    }
+    return cache;
+}
+
+bool CppFileCache::load(std::istream &in) {
+    // read and check everything before creating the blocks
+    size_t count;
+    if (!(in >> count) || count == 0)
+        return false;
+    std::vector<BlockRecord> block_records(count);
+    for (size_t i = 0; i < count; i++) {
+        BlockRecord &r = block_records[i];
+        if (!readBlock(in, r) || r.kind < 0 || r.kind > static_cast<int>(Kind::ELSE))
+            return false;
+        // parents and predecessors precede their blocks, only the top block has no parent
+        if ((i == 0) != (r.parent == -1) || r.parent >= static_cast<long>(i)
+                || r.prev < -1 || r.prev >= static_cast<long>(i))
+            return false;
+    }
+    if (!(in >> count))
+        return false;
+    std::vector<DefineRecord> define_records(count);
+    for (DefineRecord &r : define_records) {
+        if (!readDefine(in, r))
+            return false;
+        for (size_t block : r.defined_in)
+            if (block >= block_records.size())
+                return false;
+    }
+    for (const BlockRecord &r : block_records)
+        for (size_t define : r.defines)
+            if (define >= define_records.size())
+                return false;
+
+    // the file has no defines yet, hence the blocks don't rewrite their expressions
+    std::vector<ScannerConditionalBlock *> blocks;
+    for (BlockRecord &r : block_records) {
+        ScannerConditionalBlock *parent = r.parent < 0 ? nullptr : blocks[r.parent];
+        ScannerConditionalBlock *prev = r.prev < 0 ? nullptr : blocks[r.prev];
+        auto block = new ScannerConditionalBlock(_file, parent, prev, static_cast<Kind>(r.kind),
+                                                 r.number, r.expression, r.lineStart,
+                                                 r.colStart);
+        block->_lineEnd = r.lineEnd;
+        block->_colEnd = r.colEnd;
+        block->_exp = std::move(r.ifdefExpression);
+        if (r.hasCodeConstraints)
+            block->cached_code_expression = new std::string(std::move(r.codeConstraints));
+        if (parent) {
+            parent->push_back(block);
+            _file->push_back(block);
+        }
+        _nodeNum = std::max(_nodeNum, r.number + 1);
+        blocks.push_back(block);
+    }
+
+    std::vector<CppDefine *> defines;
+    for (const DefineRecord &r : define_records) {
+        auto define = new CppDefine(r.defined_symbol);
+        for (size_t i = 0; i < r.defined_in.size(); i++)
+            define->newDefine(blocks[r.defined_in[i]], !r.undef[i]);
+        (*_file->getDefines())[r.defined_symbol] = define;
+        defines.push_back(define);
+    }
+    for (size_t i = 0; i < blocks.size(); i++)
+        for (size_t define : block_records[i].defines)
+            blocks[i]->addDefine(defines[define]);
+
+    _top = blocks.front();
+    return true;
+}
+
+void CppFileCache::store(const std::string &key, CppFile &file) {
+    std::vector<ConditionalBlock *> blocks{file.topBlock()};
+    blocks.insert(blocks.end(), file.begin(), file.end());
+    std::map<const ConditionalBlock *, long> block_index{{nullptr, -1}};
+    for (ConditionalBlock *block : blocks) {
+        // dummy blocks aren't part of the parsed file
+        if (block->isDummyBlock())
+            return;
+        block_index.emplace(block, block_index.size() - 1);
+    }
+    std::map<const CppDefine *, size_t> define_index;
+    for (const auto &entry : *file.getDefines())  // pair<string, CppDefine *>
+        define_index.emplace(entry.second, define_index.size());
+
+    std::stringstream out;
+    putString(out, key);
+    const std::vector<std::string> &included = file.getBuilder()->includedFiles();
+    out << included.size() << '\n';
+    for (const std::string &path : included) {
+        putString(out, path);
+        putString(out, undertaker::fileHash(path));
+    }
+    const std::vector<std::string> &missing = file.getBuilder()->missingIncludes();
+    out << missing.size() << '\n';
+    for (const std::string &path : missing)
+        putString(out, path);
+
+    out << blocks.size() << '\n';
+    for (const ConditionalBlock *block : blocks) {
+        // the number of a block follows the 'B' of its name
+        out << std::stoul(block->getName().substr(1)) << ' '
+            << static_cast<int>(kindOf(block)) << ' '
+            << block_index[block->getParent()] << ' ' << block_index[block->getPrev()] << ' '
+            << block->lineStart() << ' ' << block->colStart() << ' '
+            << block->lineEnd() << ' ' << block->colEnd() << ' '
+            << (block->cached_code_expression ? 1 : 0) << '\n';
+        // the top block has no expression
+        putString(out, block->getParent() ? block->ExpressionStr() : "");
+        putString(out, block->_exp);
+        if (block->cached_code_expression)
+            putString(out, *block->cached_code_expression);
+        out << block->_defines.size();
+        for (const CppDefine *define : block->_defines)
+            out << ' ' << define_index[define];
+        out << '\n';
+    }
+
+    out << define_index.size() << '\n';
+    for (const auto &entry : *file.getDefines()) {  // pair<string, CppDefine *>
+        const CppDefine *define = entry.second;
+        putString(out, define->defined_symbol);
+        out << define->defined_in.size();
+        for (size_t i = 0; i < define->defined_in.size(); i++)
+            out << ' ' << block_index[define->defined_in[i]] << ' ' << define->isUndef[i];
+        out << '\n';
+    }
+
+    const std::string filename = undertaker::cacheFilename(_directory, key);
+    if (!undertaker::writeFileAtomically(filename, out.str()))
+        Logging::debug("Couldn't write ", filename);
+}
+
+long CppFileCache::countCodeConstraints(const CppFile &file) {
+    long count = file.topBlock()->cached_code_expression ? 1 : 0;
+    for (const ConditionalBlock *block : file)
+        if (block->cached_code_expression)
+            count++;
+    return count;
+}
+
+ConditionalBlock *CppFileCache::createDummyElseBlock(ConditionalBlock *parent,
+                                                     ConditionalBlock *prev) {
+    auto newBlock = new ScannerConditionalBlock(_file, parent, prev, Kind::ELSE,
+                                                _nodeNum++, "", 0, 0);
+    newBlock->setDummyBlock();
+    return newBlock;
+}
@@ -0,0 +1,89 @@
+// -*- mode: c++ -*-
+/*
+ *   undertaker - analyze preprocessor blocks in code
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _CPPFILE_CACHE_H
+#define _CPPFILE_CACHE_H
+
+#include "ConditionalBlock.h"
+
+#include <iosfwd>
+#include <memory>
+#include <string>
+
+
+/************************************************************************/
+/* CppFileCache                                                         */
+/************************************************************************/
+
+/**
+ * \brief on-disk store for parsed files
+ *
+ * An entry holds the block tree of a file with the locations and the
+ * rewritten expressions of its blocks, the blocks of its #define and #undef
+ * directives and the code constraints that have been computed for its
+ * blocks. It is keyed by the content of the file, the parser, the include
+ * paths and the directory of the file, against which quoted includes are
+ * resolved. An entry is only used while the files pasted by its #include
+ * directives are unchanged and no file has appeared at a path, at which an
+ * #include looked for one in vain. Like the SatResultCache, the directory
+ * may be shared by several processes and runs.
+ *
+ * The stored code constraints are the strings of getCodeConstraints(),
+ * which end up in reports and in the output of cpppc and coverage. The
+ * checks build their formulas with getCodeConstraintExp() from the
+ * expressions of the blocks instead, hence the cache saves them the
+ * parsing of the file, but not the construction of their formulas.
+ *
+ * Files loaded from the cache are built by a CppFileCache, their blocks
+ * are ScannerConditionalBlocks. Source output of the coverage analysis
+ * needs the Puma tokens, hence it doesn't use the cache.
+ */
+class CppFileCache : public ConditionalBlockBuilder {
+    static std::string _directory;
+
+    CppFile *_file;
+    ConditionalBlock *_top = nullptr;
+    unsigned long _nodeNum = 0;
+
+    explicit CppFileCache(CppFile *file) : _file(file) {}
+    bool load(std::istream &in);
+
+public:
+    //! enables the cache, the files are stored below the given directory
+    static void setDirectory(const std::string &directory) { _directory = directory; }
+    static bool isEnabled() { return !_directory.empty(); }
+
+    /**
+     * \param path the file to read
+     * \param filename the name of the file in its block names
+     * \return key of the entry of the file, empty if the file can't be read
+     */
+    static std::string key(const std::string &path, const std::string &filename);
+    //! \return the builder of the stored blocks, nullptr if there is no valid entry
+    static std::unique_ptr<CppFileCache> lookup(CppFile *file, const std::string &key);
+    //! stores the file, unless it has been modified for decision coverage
+    static void store(const std::string &key, CppFile &file);
+    //! \return number of blocks, whose code constraints have been computed
+    static long countCodeConstraints(const CppFile &file);
+
+    ConditionalBlock *topBlock() final override { return _top; }
+    ConditionalBlock *createDummyElseBlock(ConditionalBlock *parent,
+                                           ConditionalBlock *prev) final override;
+};
+#endif
@@ -37,7 +37,7 @@
 // parameter filename will look like: 'models/x86.model', ext: 'model'
 static ConfigurationModel *loadModelFile(const std::string &filename, const std::string &ext) {
     // return value cannot be nullptr! if allocation fails, a std::bad_alloc is thrown
-    if (ext == ".cnf")
+    if (ext == ".cnf" || ext == ".cnfb")
         return new CnfConfigurationModel(filename);
     else
         return new RsfConfigurationModel(filename);
@@ -70,7 +70,7 @@ ConfigurationModel* ModelContainer::loadModels(std::string model) {
     for (boost::filesystem::directory_iterator dir(model), end; dir != end; ++dir) {
         const boost::filesystem::path dir_entry = dir->path();
         const std::string ext = dir_entry.extension().string();
-        if (ext == ".cnf" || ext == ".model") {
+        if (ext == ".cnf" || ext == ".cnfb" || ext == ".model") {
             const std::string found_arch = dir_entry.stem().string();
             futures.emplace(found_arch, std::async(std::launch::async, loadModelFile,
                                                    dir_entry.string(), ext));
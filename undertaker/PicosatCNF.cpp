@@ -22,10 +22,17 @@
 
 #include "PicosatCNF.h"
 #include "exceptions/IOException.h"
+#include "exceptions/SatBudgetExceeded.h"
 #include "Logging.h"
 
 #include <fstream>
 #include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 namespace Picosat {
 // include picosat header as C
@@ -36,20 +43,147 @@ namespace Picosat {
 
 using namespace kconfig;
 
+namespace {
+    /* Layout of the binary cnf format (.cnfb), all numbers are stored in host byte order:
+     * the header, the variables, the symbol types and the meta keys (each as CnfbEntry), the
+     * offsets of all meta values, the clause literals and finally the string pool, which
+     * contains all names as '\0' terminated strings. */
+    const char cnfb_magic[4] = {'C', 'N', 'F', 'B'};
+    const uint32_t cnfb_version = 1;
 
-static bool picosatIsInitalized = false;
-static PicosatCNF *currentContext = nullptr;
+    struct CnfbHeader {
+        char magic[4];
+        uint32_t version;
+        int32_t varcount, clausecount;
+        uint32_t vars, syms, metas, meta_values, literals, strings;
+    };
 
-PicosatCNF::PicosatCNF(Picosat::SATMode defaultPhase) : defaultPhase(defaultPhase) {}
+    struct CnfbEntry {
+        uint32_t name;  // offset into the string pool
+        int32_t value;  // cnf variable, symbol type or number of meta values
+    };
 
-// copy delegate constructor with initializing _picosat and setting default_phase
+    // FNV-1a
+    uint32_t hashName(const char *name, size_t length) {
+        uint32_t hash = 2166136261u;
+        for (size_t i = 0; i < length; i++)
+            hash = (hash ^ (unsigned char) name[i]) * 16777619u;
+        return hash;
+    }
+} // namespace
+
+int SymbolTable::lookup(const char *name, size_t length, uint32_t hash) const {
+    if (slots.empty())
+        return -1;
+    const size_t mask = slots.size() - 1;
+    for (size_t slot = hash & mask;; slot = (slot + 1) & mask) {
+        const int id = slots[slot];
+        if (id < 0)
+            return -1;
+        const Record &r = records[id];
+        if (r.hash == hash && r.length == length
+                && std::memcmp(pool.data() + r.name, name, length) == 0)
+            return id;
+    }
+}
+
+int SymbolTable::find(const char *name, size_t length) const {
+    return lookup(name, length, hashName(name, length));
+}
+
+int SymbolTable::intern(const char *name, size_t length) {
+    const uint32_t hash = hashName(name, length);
+    int id = lookup(name, length, hash);
+    if (id >= 0)
+        return id;
+    // at most half of the slots are used, so the probe sequences stay short
+    if (2 * (records.size() + 1) > slots.size()) {
+        slots.assign(std::max<size_t>(64, 2 * slots.size()), -1);
+        const size_t mask = slots.size() - 1;
+        for (size_t i = 0; i < records.size(); i++) {
+            size_t slot = records[i].hash & mask;
+            while (slots[slot] >= 0)
+                slot = (slot + 1) & mask;
+            slots[slot] = i;
+        }
+    }
+    id = records.size();
+    Record r;
+    r.name = pool.size();
+    r.length = length;
+    r.hash = hash;
+    records.push_back(r);
+    pool.insert(pool.end(), name, name + length);
+    pool.push_back('\0');
+    const size_t mask = slots.size() - 1;
+    size_t slot = hash & mask;
+    while (slots[slot] >= 0)
+        slot = (slot + 1) & mask;
+    slots[slot] = id;
+    return id;
+}
+
+void SymbolTable::setVar(int id, int var) {
+    Record &r = records[id];
+    if (!r.has_var)
+        var_count++;
+    r.has_var = true;
+    r.var = var;
+    if (var > 0) {
+        if (var >= (int) var_names.size())
+            var_names.resize(var + 1, -1);
+        var_names[var] = id;
+    }
+}
+
+void SymbolTable::reindexVars() {
+    var_names.clear();
+    // if several names share a variable, the last one in the order of the names wins
+    for (int id : variables())
+        if (records[id].var > 0) {
+            if (records[id].var >= (int) var_names.size())
+                var_names.resize(records[id].var + 1, -1);
+            var_names[records[id].var] = id;
+        }
+}
+
+void SymbolTable::setType(int id, kconfig_symbol_type type) {
+    records[id].has_type = true;
+    records[id].type = type;
+}
+
+std::vector<int> SymbolTable::sorted(bool Record::*has) const {
+    std::vector<int> ids;
+    for (size_t i = 0; i < records.size(); i++)
+        if (records[i].*has)
+            ids.push_back(i);
+    std::sort(ids.begin(), ids.end(), [this](int a, int b) {
+        return std::strcmp(name(a), name(b)) < 0;
+    });
+    return ids;
+}
+
+unsigned long long PicosatCNF::propagation_budget = 0;
+
+PicosatCNF::PicosatCNF(Picosat::SATMode defaultPhase)
+    : symbols(std::make_shared<SymbolTable>()), defaultPhase(defaultPhase) {}
+
+// the solver instance is not shared, the copy loads all clauses into a new one when needed
+PicosatCNF::PicosatCNF(const PicosatCNF &cnf)
+    : clauses(cnf.clauses), mapped_clauses(cnf.mapped_clauses), mapped_size(cnf.mapped_size),
+      assumptions(cnf.assumptions), symbols(cnf.symbols), meta_information(cnf.meta_information), defaultPhase(cnf.defaultPhase),
+      varcount(cnf.varcount), clausecount(cnf.clausecount) {}
+
+// copy delegate constructor with setting default_phase
 PicosatCNF::PicosatCNF(const PicosatCNF &cnf, Picosat::SATMode defaultPhase) : PicosatCNF(cnf) {
     this->defaultPhase = defaultPhase;
 }
 
 PicosatCNF::~PicosatCNF() {
-    if (this == currentContext)
-        currentContext = nullptr;
+    if (picosat) {
+        Picosat::picosat_select(picosat);
+        Picosat::picosat_reset();
+    }
 }
 
 void PicosatCNF::readFromFile(const std::string &filename) {
@@ -57,9 +191,91 @@ void PicosatCNF::readFromFile(const std::string &filename) {
     if (!i.good()) {
         throw IOException("Could not open CNF-File");
     }
+    char magic[sizeof(cnfb_magic)];
+    if (i.read(magic, sizeof(magic)) && std::equal(magic, magic + sizeof(magic), cnfb_magic)) {
+        readFromBinaryFile(filename);
+        return;
+    }
+    i.clear();
+    i.seekg(0);
     readFromStream(i);
 }
 
+void PicosatCNF::readFromBinaryFile(const std::string &filename) {
+    int fd = open(filename.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        if (fd >= 0)
+            close(fd);
+        throw IOException("Could not open CNF-File");
+    }
+    const size_t size = st.st_size;
+    void *addr = MAP_FAILED;
+    if (size >= sizeof(CnfbHeader))
+        addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED)
+        throw IOException("Could not map CNF-File");
+    // the mapping is released when neither this cnf nor a copy of it uses the clauses anymore
+    std::shared_ptr<const char> mapping(static_cast<const char *>(addr), [size](const char *p) {
+        munmap(const_cast<char *>(p), size);
+    });
+
+    const CnfbHeader *header = static_cast<const CnfbHeader *>(addr);
+    if (header->version != cnfb_version) {
+        Logging::error("Unsupported version ", header->version, " of the binary CNF format.");
+        throw IOException("parse error while reading CNF file");
+    }
+    const uint64_t expected_size = sizeof(CnfbHeader)
+        + sizeof(CnfbEntry) * (uint64_t(header->vars) + header->syms + header->metas)
+        + sizeof(uint32_t) * uint64_t(header->meta_values)
+        + sizeof(int32_t) * uint64_t(header->literals) + header->strings;
+    const CnfbEntry *vars = reinterpret_cast<const CnfbEntry *>(header + 1);
+    const CnfbEntry *syms = vars + header->vars;
+    const CnfbEntry *metas = syms + header->syms;
+    const uint32_t *meta_values = reinterpret_cast<const uint32_t *>(metas + header->metas);
+    const int32_t *literals = reinterpret_cast<const int32_t *>(meta_values + header->meta_values);
+    const char *strings = reinterpret_cast<const char *>(literals + header->literals);
+    if (expected_size != size || (header->strings > 0 && strings[header->strings - 1] != '\0')
+            || (header->literals > 0 && literals[header->literals - 1] != 0)) {
+        Logging::error("Binary CNF file ", filename, " is truncated or corrupt.");
+        throw IOException("parse error while reading CNF file");
+    }
+    auto name = [&](uint32_t offset) {
+        if (offset >= header->strings)
+            throw IOException("parse error while reading CNF file");
+        return std::string(strings + offset);
+    };
+
+    SymbolTable &table = writableSymbols();
+    for (uint32_t i = 0; i < header->vars; i++) {
+        if (vars[i].name >= header->strings)
+            throw IOException("parse error while reading CNF file");
+        const char *var = strings + vars[i].name;
+        table.setVar(table.intern(var, std::strlen(var)), vars[i].value);
+        varcount = std::max(varcount, std::abs(vars[i].value));
+    }
+    for (uint32_t i = 0; i < header->syms; i++)
+        setSymbolType(name(syms[i].name), (kconfig_symbol_type) syms[i].value);
+    for (uint32_t i = 0, v = 0; i < header->metas; i++) {
+        const std::string key = name(metas[i].name);
+        for (int32_t n = 0; n < metas[i].value; n++, v++) {
+            if (v >= header->meta_values)
+                throw IOException("parse error while reading CNF file");
+            addMetaValue(key, name(meta_values[v]));
+        }
+    }
+    varcount = std::max(varcount, header->varcount);
+    clausecount += header->clausecount;
+    // the clauses stay in the mapped file, unless they have to follow other clauses
+    if (clauses.empty() && !mapped_clauses && !picosat) {
+        mapped_clauses = std::shared_ptr<const int>(mapping, literals);
+        mapped_size = header->literals;
+    } else {
+        clauses.insert(clauses.end(), literals, literals + header->literals);
+    }
+}
+
 void PicosatCNF::readFromStream(std::istream &i) {
     std::string tmp;
     while (i >> tmp) {
@@ -110,6 +326,13 @@ void PicosatCNF::readFromStream(std::istream &i) {
 }
 
 void PicosatCNF::toFile(const std::string &filename) const {
+    const std::string binary_ext(".cnfb");
+    if (filename.size() >= binary_ext.size()
+            && filename.compare(filename.size() - binary_ext.size(), binary_ext.size(),
+                                binary_ext) == 0) {
+        toBinaryFile(filename);
+        return;
+    }
     std::ofstream out(filename);
     if (!out.good()) {
         Logging::error("Couldn't write to ", filename);
@@ -118,17 +341,66 @@ void PicosatCNF::toFile(const std::string &filename) const {
     toStream(out);
 }
 
+// XXX do not modify the output format without adjusting: readFromBinaryFile
+void PicosatCNF::toBinaryFile(const std::string &filename) const {
+    std::ofstream out(filename, std::ios::binary);
+    if (!out.good()) {
+        Logging::error("Couldn't write to ", filename);
+        return;
+    }
+    std::string strings;
+    auto intern = [&strings](const std::string &str) {
+        uint32_t offset = strings.size();
+        strings.append(str).push_back('\0');
+        return offset;
+    };
+    std::vector<CnfbEntry> vars, syms, metas;
+    std::vector<uint32_t> meta_values;
+    for (int id : symbols->variables())
+        vars.push_back({intern(symbols->str(id)), symbols->var(id)});
+    for (int id : symbols->symbols())
+        syms.push_back({intern(symbols->str(id)), symbols->type(id)});
+    for (const auto &entry : meta_information) {  // pair<string, deque<string>>
+        metas.push_back({intern(entry.first), (int32_t) entry.second.size()});
+        for (const std::string &str : entry.second)
+            meta_values.push_back(intern(str));
+    }
+    CnfbHeader header;
+    std::copy(cnfb_magic, cnfb_magic + sizeof(cnfb_magic), header.magic);
+    header.version = cnfb_version;
+    header.varcount = varcount;
+    header.clausecount = clausecount;
+    header.vars = vars.size();
+    header.syms = syms.size();
+    header.metas = metas.size();
+    header.meta_values = meta_values.size();
+    header.literals = mapped_size + clauses.size();
+    header.strings = strings.size();
+
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char *>(vars.data()), sizeof(CnfbEntry) * vars.size());
+    out.write(reinterpret_cast<const char *>(syms.data()), sizeof(CnfbEntry) * syms.size());
+    out.write(reinterpret_cast<const char *>(metas.data()), sizeof(CnfbEntry) * metas.size());
+    out.write(reinterpret_cast<const char *>(meta_values.data()),
+              sizeof(uint32_t) * meta_values.size());
+    out.write(reinterpret_cast<const char *>(mapped_clauses.get()), sizeof(int) * mapped_size);
+    out.write(reinterpret_cast<const char *>(clauses.data()), sizeof(int) * clauses.size());
+    out.write(strings.data(), strings.size());
+    if (!out.good())
+        Logging::error("Couldn't write to ", filename);
+}
+
 // XXX do not modify the output format without adjusting: readFromStream
 void PicosatCNF::toStream(std::ostream &out) const {
-    out << "c File Format Version: 2.0" << std::endl;
-    out << "c Generated by satyr" << std::endl;
-    out << "c Type info:" << std::endl;
-    out << "c c sym <symbolname> <typeid>" << std::endl;
-    out << "c with <typeid> being an integer out of:"  << std::endl;
+    out << "c File Format Version: 2.0" << '\n';
+    out << "c Generated by satyr" << '\n';
+    out << "c Type info:" << '\n';
+    out << "c c sym <symbolname> <typeid>" << '\n';
+    out << "c with <typeid> being an integer out of:"  << '\n';
     out << "c enum {S_BOOLEAN=1, S_TRISTATE=2, S_INT=3, S_HEX=4, S_STRING=5, S_OTHER=6}"
-        << std::endl;
-    out << "c variable names:" << std::endl;
-    out << "c c var <variablename> <cnfvar>" << std::endl;
+        << '\n';
+    out << "c variable names:" << '\n';
+    out << "c c var <variablename> <cnfvar>" << '\n';
 
     for (const auto &entry : meta_information) {  // pair<string, deque<string>>
         std::stringstream sj;
@@ -137,21 +409,15 @@ void PicosatCNF::toStream(std::ostream &out) const {
         for (const std::string &str : entry.second)
             sj << " " << str;
 
-        out << sj.str() << std::endl;
-    }
-    for (const auto &entry : this->symboltypes) {  // pair<string, kconfig_symbol_type>
-        const std::string &sym = entry.first;
-        int type = entry.second;
-        out << "c sym " << sym << " " << type << std::endl;
-    }
-    for (const auto &entry : this->cnfvars) {  // pair<string, int>
-        const std::string &sym = entry.first;
-        int var = entry.second;
-        out << "c var " << sym << " " << var << std::endl;
+        out << sj.str() << '\n';
     }
-    out << "p cnf " << varcount << " " << this->clausecount << std::endl;
+    for (int id : symbols->symbols())
+        out << "c sym " << symbols->name(id) << " " << symbols->type(id) << '\n';
+    for (int id : symbols->variables())
+        out << "c var " << symbols->name(id) << " " << symbols->var(id) << '\n';
+    out << "p cnf " << varcount << " " << this->clausecount << '\n';
 
-    for (const int &clause : clauses) {
+    for (const int &clause : getClauses()) {
         char sep = (clause == 0) ? '\n' : ' ';
         out << clause << sep;
     }
@@ -159,8 +425,9 @@ void PicosatCNF::toStream(std::ostream &out) const {
 
 // this method transfers the the state from other to 'this'
 void PicosatCNF::incrementWith(const PicosatCNF &other) {
-    for (const auto &entry : other.getSymbolTypes())  // pair<string, kconfig_symbol_type>
-        setSymbolType(entry.first, entry.second);
+    const SymbolTable &theirs = other.getSymbolTable();
+    for (int id : theirs.symbols())
+        setSymbolType(theirs.str(id), theirs.type(id));
 
     for (const auto &entry : other.getMetaInformation())  // pair<string, deque<string>>
         for (const std::string &item : entry.second)
@@ -174,21 +441,23 @@ void PicosatCNF::incrementWith(const PicosatCNF &other) {
     // if 'other' has fewer variables than the current cnf-object, we have to take the maximum
     int counter = std::max(other.getVarCount(), varcount);
     const int oldvarcount = varcount;
-    for (const auto &entry : other.getSymbolMap()) {  // pair<string, int>
-        int cnfvar = getCNFVar(entry.first);
+    for (int id : theirs.variables()) {
+        const std::string name = theirs.str(id);
+        const int var = theirs.var(id);
+        int cnfvar = getCNFVar(name);
         if (cnfvar) {
-            // if 'this' already has the symbol 'entry.first' we need to replace the variable-id
+            // if 'this' already has the symbol 'name' we need to replace the variable-id
             // from 'other' with the id from 'this'
-            inferenced.emplace(entry.second, cnfvar);
-            inferenced.emplace(-entry.second, -cnfvar);
-        } else if (entry.second <= oldvarcount) {
-            // if the variable from entry wasn't already mentioned but the id is smaller than
+            inferenced.emplace(var, cnfvar);
+            inferenced.emplace(-var, -cnfvar);
+        } else if (var <= oldvarcount) {
+            // if the variable wasn't already mentioned but the id is smaller than
             // varcount, we have to give it a new id to avoid conflicts
-            setCNFVar_fast(entry.first, ++counter);
-            inferenced.emplace(entry.second, counter);
-            inferenced.emplace(-entry.second, -counter);
+            setCNFVar_fast(name, ++counter);
+            inferenced.emplace(var, counter);
+            inferenced.emplace(-var, -counter);
         } else {
-            setCNFVar_fast(entry.first, entry.second);
+            setCNFVar_fast(name, var);
         }
     }
     // there are variables in the model which don't have symbols but to avoid conflicts, they need
@@ -223,25 +492,436 @@ void PicosatCNF::incrementWith(const PicosatCNF &other) {
     }
 }
 
+void PicosatCNF::mergeArchitectures(const std::map<std::string, const PicosatCNF *> &archs) {
+    static const std::string magic_on("ALWAYS_ON"), magic_off("ALWAYS_OFF");
+    static const std::string backbone_on("BACKBONE_ON"), backbone_off("BACKBONE_OFF");
+    // clauses which only consist of named variables -> selectors of the architectures having them
+    std::map<std::vector<int>, std::vector<int>> shared_clauses;
+    std::vector<int> selectors;
+
+    for (const auto &arch : archs) {  // pair<string, const PicosatCNF *>
+        const PicosatCNF &other = *arch.second;
+        const int selector = newVar();
+        setCNFVar("ARCH_" + arch.first, selector);
+        selectors.push_back(selector);
+        addMetaValue("ARCHITECTURES", arch.first);
+
+        const SymbolTable &theirs = other.getSymbolTable();
+        for (int id : theirs.symbols())
+            setSymbolType(theirs.str(id), theirs.type(id));
+
+        for (const auto &entry : other.getMetaInformation())  // pair<string, deque<string>>
+            if (entry.first != magic_on && entry.first != magic_off
+                    && entry.first != backbone_on && entry.first != backbone_off)
+                for (const std::string &item : entry.second)
+                    addMetaValue(entry.first, item);
+
+        // named variables are shared by all architectures, the others are renumbered
+        std::vector<int> translation(other.getVarCount() + 1, 0);
+        std::vector<bool> named(other.getVarCount() + 1, false);
+        for (int id : theirs.variables()) {
+            const std::string name = theirs.str(id);
+            int &var = translation[theirs.var(id)];
+            if (!var)
+                var = getCNFVar(name);
+            if (!var)
+                var = newVar();
+            if (!getCNFVar(name))
+                setCNFVar(name, var);
+            named[theirs.var(id)] = true;
+        }
+
+        std::vector<int> clause;
+        bool only_named = true;
+        for (const int &i : other.getClauses()) {
+            if (i != 0) {
+                int &var = translation[abs(i)];
+                if (!var)
+                    var = newVar();
+                only_named = only_named && named[abs(i)];
+                clause.emplace_back(i > 0 ? var : -var);
+                continue;
+            }
+            if (only_named) {
+                std::sort(clause.begin(), clause.end());
+                clause.erase(std::unique(clause.begin(), clause.end()), clause.end());
+                std::vector<int> &owners = shared_clauses[clause];
+                if (owners.empty() || owners.back() != selector)
+                    owners.push_back(selector);
+            } else {
+                pushVar(-selector);
+                for (const int &lit : clause)
+                    pushVar(lit);
+                pushClause();
+            }
+            clause.clear();
+            only_named = true;
+        }
+    }
+    // whitelisted, blacklisted and fixed items of the merged model have to hold on every
+    // architecture
+    if (!archs.empty()) {
+        const PicosatCNF &first = *archs.begin()->second;
+        for (const std::string &key : {magic_on, magic_off, backbone_on, backbone_off}) {
+            const std::deque<std::string> *items = first.getMetaValue(key);
+            if (!items)
+                continue;
+            for (const std::string &item : *items) {
+                bool everywhere = true;
+                for (const auto &arch : archs) {  // pair<string, const PicosatCNF *>
+                    const std::deque<std::string> *v = arch.second->getMetaValue(key);
+                    everywhere = everywhere && v
+                        && std::find(v->begin(), v->end(), item) != v->end();
+                }
+                if (everywhere)
+                    addMetaValue(key, item);
+            }
+        }
+    }
+    // the merged model describes at least one architecture
+    for (const int &selector : selectors)
+        pushVar(selector);
+    pushClause();
+
+    // clauses of all architectures need no guard, all other sets of architectures get one
+    std::map<std::vector<int>, int> guards;
+    for (const auto &entry : shared_clauses) {  // pair<vector<int>, vector<int>>
+        const std::vector<int> &owners = entry.second;
+        int guard = 0;
+        if (owners.size() == 1) {
+            guard = owners.front();
+        } else if (owners.size() < selectors.size()) {
+            int &g = guards[owners];
+            if (!g) {
+                g = newVar();
+                for (const int &selector : owners) {
+                    pushVar(-selector);
+                    pushVar(g);
+                    pushClause();
+                }
+            }
+            guard = g;
+        }
+        if (guard)
+            pushVar(-guard);
+        for (const int &lit : entry.first)
+            pushVar(lit);
+        pushClause();
+    }
+}
+
+bool PicosatCNF::computeBackbone() {
+    if (!checkSatisfiable())
+        return false;
+    // variable -> value in all solutions found so far
+    std::map<int, bool> candidates;
+    for (int var = 1; var <= varcount; var++)
+        if (symbols->ofVar(var) >= 0)
+            candidates.emplace(var, deref(var));
+    const size_t named = candidates.size();
+
+    // Each check asks for a solution that flips one of the candidates at
+    // least, the phases make the solver try to flip all of them. The
+    // candidates only shrink, so the clause of a check implies those of the
+    // checks before, and all of them share one selector. The clauses go to
+    // the solver only, so that they don't end up in the model.
+    const int selector = newVar();
+    while (!candidates.empty()) {
+        Picosat::picosat_select(picosat);
+        Picosat::picosat_adjust(varcount);
+        Picosat::picosat_add(-selector);
+        for (const auto &candidate : candidates) {  // pair<int, bool>
+            Picosat::picosat_add(candidate.second ? -candidate.first : candidate.first);
+            Picosat::picosat_set_default_phase_lit(candidate.first, candidate.second ? -1 : 1);
+        }
+        Picosat::picosat_add(0);
+        pushAssumption(selector);
+        const bool flipped = checkSatisfiable();
+        // the solution is read before the next clause resets the state of the solver
+        for (auto it = candidates.begin(); flipped && it != candidates.end();) {
+            if (deref(it->first) != it->second)
+                it = candidates.erase(it);
+            else
+                ++it;
+        }
+        if (!flipped)
+            break;
+    }
+    // the selector isn't assumed again, the unit clause drops the clauses of the checks
+    Picosat::picosat_select(picosat);
+    Picosat::picosat_add(-selector);
+    Picosat::picosat_add(0);
+
+    // none of the remaining candidates can be flipped
+    for (const auto &candidate : candidates) {  // pair<int, bool>
+        addMetaValue(candidate.second ? "BACKBONE_ON" : "BACKBONE_OFF",
+                     getSymbolName(candidate.first));
+        pushVar(candidate.second ? candidate.first : -candidate.first);
+        pushClause();
+    }
+    // later solutions shouldn't lean away from the values of the first one
+    Picosat::picosat_select(picosat);
+    Picosat::picosat_reset_phases();
+    Logging::debug(candidates.size(), " of ", named, " named variables are fixed by the model");
+    return true;
+}
+
+void PicosatCNF::simplify() {
+    // limits for the elimination of a variable: occurrences, length of a resolvent
+    static const unsigned int max_occurrences = 32, max_resolvent_size = 64;
+    auto lit_index = [](int lit) { return 2 * abs(lit) + (lit < 0); };
+
+    const std::vector<int> variables = symbols->variables();
+    int maxvar = varcount;
+    for (int id : variables)
+        maxvar = std::max(maxvar, abs(symbols->var(id)));
+    std::vector<bool> named(maxvar + 1, false);
+    for (int id : variables)
+        named[abs(symbols->var(id))] = true;
+
+    std::vector<std::vector<int>> db;
+    std::vector<bool> removed;
+    std::vector<std::vector<unsigned int>> occ(2 * maxvar + 2);
+    std::vector<signed char> value(maxvar + 1, 0);  // top level assignment
+    std::vector<int> units;
+    bool conflict = false;
+
+    auto assign = [&](int lit) {
+        signed char &v = value[abs(lit)];
+        if (v == 0) {
+            v = (lit > 0) ? 1 : -1;
+            units.push_back(lit);
+        } else if (v != ((lit > 0) ? 1 : -1)) {
+            conflict = true;
+        }
+    };
+    // adds the clause without duplicate and false literals, unless it is already satisfied
+    auto add_clause = [&](std::vector<int> &clause) {
+        std::sort(clause.begin(), clause.end());
+        clause.erase(std::unique(clause.begin(), clause.end()), clause.end());
+        std::vector<int> lits;
+        for (const int &lit : clause) {
+            const int v = value[abs(lit)] * ((lit > 0) ? 1 : -1);
+            if (v > 0 || std::binary_search(clause.begin(), clause.end(), -lit))
+                return;
+            if (v == 0)
+                lits.push_back(lit);
+        }
+        if (lits.size() <= 1) {
+            if (lits.empty())
+                conflict = true;
+            else
+                assign(lits.front());
+            return;
+        }
+        for (const int &lit : lits)
+            occ[lit_index(lit)].push_back(db.size());
+        db.push_back(std::move(lits));
+        removed.push_back(false);
+    };
+    auto propagate = [&]() {
+        while (!units.empty() && !conflict) {
+            const int lit = units.back();
+            units.pop_back();
+            for (const unsigned int &idx : occ[lit_index(lit)])
+                removed[idx] = true;
+            for (const unsigned int &idx : occ[lit_index(-lit)]) {
+                if (removed[idx])
+                    continue;
+                std::vector<int> &clause = db[idx];
+                clause.erase(std::find(clause.begin(), clause.end(), -lit));
+                if (clause.size() == 1) {
+                    removed[idx] = true;
+                    assign(clause.front());
+                }
+            }
+            occ[lit_index(lit)].clear();
+            occ[lit_index(-lit)].clear();
+        }
+    };
+    // returns the clauses that still contain the literal
+    auto occurrences = [&](int lit) -> const std::vector<unsigned int> & {
+        std::vector<unsigned int> &list = occ[lit_index(lit)];
+        list.erase(std::remove_if(list.begin(), list.end(),
+                                  [&](unsigned int idx) { return removed[idx]; }),
+                   list.end());
+        return list;
+    };
+
+    std::vector<int> clause;
+    for (const int &lit : getClauses()) {
+        if (lit != 0) {
+            clause.push_back(lit);
+            continue;
+        }
+        add_clause(clause);
+        clause.clear();
+    }
+    propagate();
+
+    // eliminate unnamed variables as long as the number of clauses doesn't grow
+    bool changed = true;
+    for (int round = 0; changed && round < 3 && !conflict; round++) {
+        changed = false;
+        for (int var = 1; var <= maxvar && !conflict; var++) {
+            if (named[var] || value[var] != 0)
+                continue;
+            const std::vector<unsigned int> pos = occurrences(var), neg = occurrences(-var);
+            if (pos.empty() && neg.empty())
+                continue;
+            if (pos.size() + neg.size() > max_occurrences)
+                continue;
+            std::vector<std::vector<int>> resolvents;
+            bool bounded = true;
+            for (const unsigned int &p : pos) {
+                for (const unsigned int &n : neg) {
+                    std::vector<int> resolvent;
+                    for (const int &lit : db[p])
+                        if (lit != var)
+                            resolvent.push_back(lit);
+                    for (const int &lit : db[n])
+                        if (lit != -var)
+                            resolvent.push_back(lit);
+                    std::sort(resolvent.begin(), resolvent.end());
+                    resolvent.erase(std::unique(resolvent.begin(), resolvent.end()),
+                                    resolvent.end());
+                    bool tautology = false;
+                    for (const int &lit : resolvent)
+                        tautology = tautology
+                            || std::binary_search(resolvent.begin(), resolvent.end(), -lit);
+                    if (tautology)
+                        continue;
+                    if (resolvent.size() > max_resolvent_size
+                            || resolvents.size() >= pos.size() + neg.size()) {
+                        bounded = false;
+                        break;
+                    }
+                    resolvents.push_back(std::move(resolvent));
+                }
+                if (!bounded)
+                    break;
+            }
+            if (!bounded)
+                continue;
+            // pure literals and variables defined by the tseitin transformation disappear here
+            for (const unsigned int &idx : pos)
+                removed[idx] = true;
+            for (const unsigned int &idx : neg)
+                removed[idx] = true;
+            for (std::vector<int> &resolvent : resolvents)
+                add_clause(resolvent);
+            propagate();
+            changed = true;
+        }
+    }
+    if (conflict) {
+        Logging::warn("The cnf model is unsatisfiable, it is not simplified.");
+        return;
+    }
+
+    // remove subsumed clauses, each clause is indexed by its least frequent literal
+    std::vector<unsigned int> order;
+    std::vector<unsigned int> frequency(2 * maxvar + 2, 0);
+    for (unsigned int idx = 0; idx < db.size(); idx++) {
+        if (removed[idx])
+            continue;
+        order.push_back(idx);
+        for (const int &lit : db[idx])
+            frequency[lit_index(lit)]++;
+    }
+    std::stable_sort(order.begin(), order.end(), [&db](unsigned int a, unsigned int b) {
+        return db[a].size() < db[b].size();
+    });
+    std::vector<std::vector<unsigned int>> index(2 * maxvar + 2);
+    std::vector<bool> mark(2 * maxvar + 2, false);
+    for (const unsigned int &idx : order) {
+        const std::vector<int> &c = db[idx];
+        for (const int &lit : c)
+            mark[lit_index(lit)] = true;
+        bool subsumed = false;
+        for (auto lit = c.begin(); lit != c.end() && !subsumed; ++lit)
+            for (const unsigned int &other : index[lit_index(*lit)]) {
+                subsumed = std::all_of(db[other].begin(), db[other].end(),
+                                       [&](int l) { return mark[lit_index(l)]; });
+                if (subsumed)
+                    break;
+            }
+        for (const int &lit : c)
+            mark[lit_index(lit)] = false;
+        if (subsumed) {
+            removed[idx] = true;
+            continue;
+        }
+        int rarest = c.front();
+        for (const int &lit : c)
+            if (frequency[lit_index(lit)] < frequency[lit_index(rarest)])
+                rarest = lit;
+        index[lit_index(rarest)].push_back(idx);
+    }
+
+    // renumber the variables that are named or still used
+    const int old_varcount = varcount, old_clausecount = clausecount;
+    std::vector<int> renumbered(maxvar + 1, 0);
+    for (unsigned int idx = 0; idx < db.size(); idx++)
+        if (!removed[idx])
+            for (const int &lit : db[idx])
+                renumbered[abs(lit)] = 1;
+    varcount = 0;
+    for (int var = 1; var <= maxvar; var++)
+        if (named[var] || renumbered[var])
+            renumbered[var] = ++varcount;
+    // models without any variable are taken for empty files (see CnfConfigurationModel)
+    if (varcount == 0 && old_varcount > 0)
+        varcount = 1;
+
+    SymbolTable &table = writableSymbols();
+    for (int id : variables)
+        table.setVar(id, renumbered[table.var(id)]);
+    table.reindexVars();
+
+    clearClauses();
+    // the values of named variables are kept as unit clauses
+    for (int var = 1; var <= maxvar; var++) {
+        if (named[var] && value[var] != 0) {
+            pushVar(value[var] * renumbered[var]);
+            pushClause();
+        }
+    }
+    for (unsigned int idx = 0; idx < db.size(); idx++) {
+        if (removed[idx])
+            continue;
+        for (const int &lit : db[idx])
+            pushVar((lit > 0) ? renumbered[lit] : -renumbered[-lit]);
+        pushClause();
+    }
+    Logging::info("simplified cnf from ", old_varcount, " variables and ", old_clausecount,
+                  " clauses to ", varcount, " variables and ", clausecount, " clauses");
+}
+
+SymbolTable &PicosatCNF::writableSymbols() {
+    if (symbols.use_count() > 1)
+        symbols = std::make_shared<SymbolTable>(*symbols);
+    return *symbols;
+}
+
 kconfig_symbol_type PicosatCNF::getSymbolType(const std::string &name) const {
-    const auto &it = this->symboltypes.find(name); // pair<string, kconfig_symbol_type>
-    return (it == this->symboltypes.end()) ? K_S_UNKNOWN : it->second;
+    const int id = symbols->find(name);
+    return (id < 0 || !symbols->hasType(id)) ? K_S_UNKNOWN : symbols->type(id);
 }
 
 void PicosatCNF::setSymbolType(const std::string &sym, kconfig_symbol_type type) {
-    std::string config_sym = "CONFIG_" + sym;
-    this->associatedSymbols[config_sym] = sym;
+    SymbolTable &table = writableSymbols();
+    const int id = table.intern(sym);
+    table.setAssociated(table.intern("CONFIG_" + sym), id);
 
-    if (type == K_S_TRISTATE) {
-        std::string config_sym_mod = "CONFIG_" + sym + "_MODULE";
-        this->associatedSymbols[config_sym_mod] = sym;
-    }
-    this->symboltypes[sym] = type;
+    if (type == K_S_TRISTATE)
+        table.setAssociated(table.intern("CONFIG_" + sym + "_MODULE"), id);
+    table.setType(id, type);
 }
 
 int PicosatCNF::getCNFVar(const std::string &var) const {
-    const auto &it = this->cnfvars.find(var); // pair<string, int>
-    return (it == this->cnfvars.end()) ? 0 : it->second;
+    const int id = symbols->find(var);
+    return (id < 0) ? 0 : symbols->var(id);
 }
 
 void PicosatCNF::setCNFVar(const std::string &var, int CNFVar) {
@@ -251,13 +931,27 @@ void PicosatCNF::setCNFVar(const std::string &var, int CNFVar) {
 }
 
 void PicosatCNF::setCNFVar_fast(const std::string &var, int CNFVar) {
-    this->cnfvars[var] = CNFVar;
-    this->boolvars[CNFVar] = var;
+    SymbolTable &table = writableSymbols();
+    table.setVar(table.intern(var), CNFVar);
 }
 
 const std::string PicosatCNF::getSymbolName(int CNFVar) const {
-    const auto &it = this->boolvars.find(CNFVar);
-    return it == this->boolvars.end() ? "" : it->second;
+    const int id = symbols->ofVar(CNFVar);
+    return (id < 0) ? "" : symbols->str(id);
+}
+
+void PicosatCNF::clearClauses() {
+    // the solver instance would keep the clauses
+    if (picosat) {
+        Picosat::picosat_select(picosat);
+        Picosat::picosat_reset();
+        picosat = nullptr;
+    }
+    mapped_clauses.reset();
+    mapped_size = 0;
+    clauses.clear();
+    clausecount = 0;
+    pushed_clauses_index = 0;
 }
 
 void PicosatCNF::pushVar(int v) {
@@ -305,17 +999,20 @@ void PicosatCNF::pushAssumption(const std::string &v, bool val) {
 }
 
 bool PicosatCNF::checkSatisfiable() {
-    // make sure the current data is stored within picosat
-    if (this != currentContext){
-        // if not, reset the context....
-        if (picosatIsInitalized)
-            Picosat::picosat_reset();
+    // each cnf has its own solver instance, which keeps the clauses pushed so far
+    if (!picosat) {
         Picosat::picosat_init();
-        picosatIsInitalized = true;
-        // and load the current context
-        currentContext = this;
+        picosat = Picosat::picosat_current();
         Picosat::picosat_set_global_default_phase(defaultPhase);
         pushed_clauses_index = 0;
+        if (mapped_size > 0) {
+            Picosat::picosat_adjust(varcount);
+            const int *mapped = mapped_clauses.get();
+            for (unsigned int i = 0; i < mapped_size; ++i)
+                Picosat::picosat_add(mapped[i]);
+        }
+    } else {
+        Picosat::picosat_select(picosat);
     }
     if (pushed_clauses_index < clauses.size()) {
         // tell picosat how many different variables it will receive
@@ -329,7 +1026,18 @@ bool PicosatCNF::checkSatisfiable() {
         Picosat::picosat_assume(assumption);
 
     assumptions.clear();
-    return Picosat::picosat_sat(-1) == PICOSAT_SATISFIABLE;
+    // the limit counts the propagations of the instance since its creation
+    Picosat::picosat_set_propagation_limit(
+        propagation_budget ? Picosat::picosat_propagations() + propagation_budget : ~0ull);
+    switch (Picosat::picosat_sat(-1)) {
+    case PICOSAT_SATISFIABLE:
+        return true;
+    case PICOSAT_UNSATISFIABLE:
+        return false;
+    default:
+        throw SatBudgetExceeded("Picosat: exceeded the budget of "
+                                + std::to_string(propagation_budget) + " propagations");
+    }
 }
 
 void PicosatCNF::pushAssumptions(std::map<std::string, bool> &a) {
@@ -341,6 +1049,7 @@ void PicosatCNF::pushAssumptions(std::map<std::string, bool> &a) {
 }
 
 bool PicosatCNF::deref(int s) const {
+    Picosat::picosat_select(picosat);
     return Picosat::picosat_deref(s) == 1;
 }
 
@@ -354,15 +1063,50 @@ bool PicosatCNF::deref(const char *c) const {
     return this->deref(cnfvar);
 }
 
-const std::string *PicosatCNF::getAssociatedSymbol(const std::string &var) const {
-    const auto &it = this->associatedSymbols.find(var); // pair<string, string>
-    return (it == this->associatedSymbols.end()) ? nullptr : &(it->second);
+bool PicosatCNF::hasAssociatedSymbol(const std::string &var) const {
+    const int id = symbols->find(var);
+    return id >= 0 && symbols->associated(id) >= 0;
 }
 
 const int *PicosatCNF::failedAssumptions() const {
+    Picosat::picosat_select(picosat);
     return Picosat::picosat_failed_assumptions();
 }
 
+std::vector<int> PicosatCNF::minimalUnsatisfiableSubset() const {
+    const std::vector<int> all = getClauses();
+    std::vector<int> mus;
+    if (all.empty())
+        return mus;
+
+    Picosat::picosat_init();
+    // the i-th clause (counting from 1) is enabled by the selector variable varcount + i
+    int selectors = 0;
+    bool first = true;
+    for (const int &lit : all) {
+        if (first)
+            Picosat::picosat_add(-(varcount + ++selectors));
+        Picosat::picosat_add(lit);
+        first = (lit == 0);
+    }
+    for (int i = 1; i <= selectors; i++)
+        Picosat::picosat_assume(varcount + i);
+    if (Picosat::picosat_sat(-1) == PICOSAT_UNSATISFIABLE) {
+        std::vector<bool> needed(selectors + 1, false);
+        for (const int *p = Picosat::picosat_mus_assumptions(nullptr, nullptr, 1); *p; p++)
+            needed[*p - varcount] = true;
+        int i = 1;
+        for (const int &lit : all) {
+            if (needed[i])
+                mus.push_back(lit);
+            if (lit == 0)
+                i++;
+        }
+    }
+    Picosat::picosat_reset();
+    return mus;
+}
+
 void PicosatCNF::addMetaValue(const std::string &key, const std::string &value) {
     std::deque<std::string> &values = meta_information[key];
     if (std::find(values.begin(), values.end(), value) == values.end())
@@ -377,6 +1121,12 @@ const std::deque<std::string> *PicosatCNF::getMetaValue(const std::string &key)
     return &(i->second);
 }
 
+std::vector<int> PicosatCNF::getClauses() const {
+    std::vector<int> all(mapped_clauses.get(), mapped_clauses.get() + mapped_size);
+    all.insert(all.end(), clauses.begin(), clauses.end());
+    return all;
+}
+
 int PicosatCNF::newVar() {
     return ++varcount;
 }
@@ -26,8 +26,10 @@
 
 #include "Kconfig.h"
 
+#include <cstdint>
 #include <vector>
 #include <map>
+#include <memory>
 #include <string>
 #include <deque>
 
@@ -39,47 +41,150 @@ namespace Picosat {
         SAT_DEFAULT = 2,
         SAT_RANDOM  = 3,
     };
+    // a solver instance, see picosat.h
+    struct PicoSAT;
 } // namespace Picosat
 
 
 namespace kconfig {
+    /**
+     * \brief interned names of the variables and Kconfig symbols of a cnf
+     *
+     * Each name is stored once in a string pool and gets a dense id, which
+     * is looked up in an open addressing hash table. The record of a name
+     * holds its cnf variable, its symbol type and the Kconfig symbol it is
+     * associated with, e.g., FOO for CONFIG_FOO_MODULE. The names of the cnf
+     * variables are found in a vector indexed by the variable.
+     */
+    class SymbolTable {
+        struct Record {
+            uint32_t name, length, hash;
+            int var = 0;
+            int associated = -1;
+            kconfig_symbol_type type = K_S_UNKNOWN;
+            bool has_var = false, has_type = false;
+        };
+        std::vector<char> pool;
+        std::vector<Record> records;
+        //! ids of the names, -1 for free slots, the size is a power of two
+        std::vector<int> slots;
+        //! cnf variable -> id of its name, -1 if it has none
+        std::vector<int> var_names;
+        size_t var_count = 0;
+
+        int lookup(const char *name, size_t length, uint32_t hash) const;
+        std::vector<int> sorted(bool Record::*has) const;
+
+    public:
+        //! \return the id of the name, -1 if it is unknown
+        int find(const std::string &name) const { return find(name.data(), name.size()); }
+        int find(const char *name, size_t length) const;
+        //! \return the id of the name, which is added if it is unknown
+        int intern(const std::string &name) { return intern(name.data(), name.size()); }
+        int intern(const char *name, size_t length);
+        size_t size() const { return records.size(); }
+        //! the name is '\0' terminated and stays valid until the next name is interned
+        const char *name(int id) const { return pool.data() + records[id].name; }
+        std::string str(int id) const { return std::string(name(id), records[id].length); }
+
+        //! the cnf variable of the name, 0 if it has none
+        int var(int id) const { return records[id].var; }
+        void setVar(int id, int var);
+        //! \return the id of the name of the cnf variable, -1 if it has none
+        int ofVar(int var) const {
+            return (var > 0 && var < (int) var_names.size()) ? var_names[var] : -1;
+        }
+        //! number of names with a cnf variable
+        size_t varCount() const { return var_count; }
+        //! maps all variables to their names again, e.g., after they have been renumbered
+        void reindexVars();
+
+        bool hasType(int id) const { return records[id].has_type; }
+        kconfig_symbol_type type(int id) const { return records[id].type; }
+        void setType(int id, kconfig_symbol_type type);
+        //! the id of the Kconfig symbol the name belongs to, -1 if there is none
+        int associated(int id) const { return records[id].associated; }
+        void setAssociated(int id, int symbol) { records[id].associated = symbol; }
+
+        //! \return the ids of the names with a cnf variable, ordered by name
+        std::vector<int> variables() const { return sorted(&Record::has_var); }
+        //! \return the ids of the names with a symbol type, ordered by name
+        std::vector<int> symbols() const { return sorted(&Record::has_type); }
+    };
+
     class PicosatCNF {
+        //! the solver instance of this cnf, created on the first call of checkSatisfiable
+        Picosat::PicoSAT *picosat = nullptr;
         std::vector<int> clauses;
+        /** clauses of a model that was read from a binary file, they precede 'clauses'.
+            All copies of this cnf share the read-only memory mapping of the file. **/
+        std::shared_ptr<const int> mapped_clauses;
+        unsigned int mapped_size = 0;
         std::vector<int> assumptions;
         unsigned int pushed_clauses_index = 0;
-        //! this map contains the the type of each Kconfig symbol
-        std::map<std::string, kconfig_symbol_type> symboltypes;
-
-        /**
-        * \brief mapping between boolean variable names and their cnf-id
-        *  Keep in sync with "booleanvars"
-        */
-        std::map<std::string, int> cnfvars;
-        /** mapping between the names of boolean variables and symbols
-            Some boolean variable represent model symbols. if so, the have
-            to be stored in this map.
-            Example:
-            { "CONFIG_FOO"  -> "FOO", "CONFIG_FOO_MODULE" -> "FOO" }
-        **/
-        std::map<std::string, std::string> associatedSymbols;
-        /** contains the variable name for cnf-id.
-            Not all cnf-id will have a name. Must kept in sync with "cnfvars"
-        **/
-        std::map<int, std::string> boolvars;
+        /** names of the variables and the Kconfig symbols with their types.
+            Copies of this cnf share the table until one of them changes it. **/
+        std::shared_ptr<SymbolTable> symbols;
         std::map<std::string, std::deque<std::string>> meta_information;
         Picosat::SATMode defaultPhase;
         int varcount = 0;
         int clausecount = 0;
+        static unsigned long long propagation_budget;
         inline void setCNFVar_fast(const std::string &var, int CNFVar);
+        //! the table of this cnf, which is copied first if it is shared
+        SymbolTable &writableSymbols();
+        void readFromBinaryFile(const std::string &filename);
+        void toBinaryFile(const std::string &filename) const;
     public:
         explicit PicosatCNF(Picosat::SATMode = Picosat::SAT_MIN);
+        //! copies the formula, the copy gets a solver instance of its own
+        PicosatCNF(const PicosatCNF &);
         PicosatCNF(const PicosatCNF &, Picosat::SATMode);
+        PicosatCNF &operator=(const PicosatCNF &) = delete;
         ~PicosatCNF();
+        //! reads a model in the text format or in the binary format written by toFile()
         void readFromFile(const std::string &filename);
         void readFromStream(std::istream &i);
+        //! writes the model, in the binary format if the filename ends with '.cnfb'
         void toFile(const std::string &filename) const;
         void toStream(std::ostream &out) const;
         void incrementWith(const PicosatCNF &);
+        /**
+         * \brief merges the models of several architectures into this (empty) cnf
+         *
+         * The clauses of each architecture are guarded by the selector variable
+         * ARCH_<name>, and at least one selector has to be enabled. Clauses that
+         * only consist of named variables are stored once for all architectures
+         * that contain them. The names of the architectures are stored in the
+         * meta value ARCHITECTURES.
+         */
+        void mergeArchitectures(const std::map<std::string, const PicosatCNF *> &archs);
+        /**
+         * \brief simplifies the clauses before the model is written
+         *
+         * Runs top level unit propagation, eliminates variables without a name
+         * (e.g., the helper variables of the tseitin transformation) by
+         * resolution, as long as this doesn't increase the number of clauses, and
+         * removes duplicate and subsumed clauses. Afterwards, the variables are
+         * renumbered. The simplified cnf is satisfiable under the same
+         * assignments of the named variables. The names and the meta
+         * information are kept.
+         */
+        void simplify();
+        /**
+         * \brief finds the named variables that have the same value in all solutions
+         *
+         * Each check asks for a solution that flips one of the remaining
+         * candidates at least, and rules out all candidates it flips. Once
+         * there is no such solution, the remaining candidates are fixed. The
+         * names of the fixed variables are stored in the meta values
+         * BACKBONE_ON and BACKBONE_OFF, and their values are added as unit
+         * clauses. The checks take one unnamed variable.
+         * @returns false if the cnf is unsatisfiable, it has no backbone then
+         */
+        bool computeBackbone();
+        //! removes all clauses, the variables and their names are kept
+        void clearClauses();
         kconfig_symbol_type getSymbolType(const std::string &name) const;
         void setSymbolType(const std::string &sym, kconfig_symbol_type type);
         int getCNFVar(const std::string &var) const;
@@ -92,7 +197,21 @@ namespace kconfig {
         void pushAssumption(int v);
         void pushAssumption(const std::string &v,bool val);
         void pushAssumptions(std::map<std::string, bool> &a);
+        /**
+         * Checks the clauses under the pushed assumptions, which are cleared afterwards
+         * @returns true, if satisfiable, false otherwise
+         * @throws SatBudgetExceeded if the check needed more propagations than its budget
+         */
         bool checkSatisfiable();
+        /**
+         * Limits the unit propagations of each call of checkSatisfiable() in
+         * all cnfs, which is roughly proportional to the time of the check.
+         * @param budget 0 disables the limit (default)
+         */
+        static void setPropagationBudget(unsigned long long budget) {
+            propagation_budget = budget;
+        }
+        static unsigned long long getPropagationBudget() { return propagation_budget; }
         /** returns cnf-id of assumtions, that cause unresolvable conflicts.
             If checkSatisfiable returns false, this returns an array of assumptions
             that derived unsatisfiability (= failed assumptions).
@@ -100,18 +219,36 @@ namespace kconfig {
             @returns array if of failed cnf-ids
         **/
         const int *failedAssumptions() const;
+        /**
+         * \brief computes a minimal unsatisfiable subset (MUS) of the clauses
+         *
+         * Each clause is guarded by a selector variable, all selectors are
+         * assumed and picosat reduces the failed ones to a minimal set, as
+         * picomus does. The computation runs on a solver instance of its own,
+         * the instance of this cnf is left alone.
+         * @returns the clauses of the subset in their original order, each
+         *     terminated by 0, or nothing if the clauses are satisfiable
+         */
+        std::vector<int> minimalUnsatisfiableSubset() const;
         bool deref(int s) const;
         bool deref(const std::string &s) const;
         bool deref(const char *s) const;
         int getVarCount() const { return varcount; }
         int getClauseCount() const { return clausecount; }
-        const std::vector<int> &getClauses() const { return clauses; }
-        int newVar();
-        const std::string *getAssociatedSymbol(const std::string &var) const;
-        const std::map<std::string, int> &getSymbolMap() const { return cnfvars; }
-        const std::map<std::string, kconfig_symbol_type> &getSymbolTypes() const {
-            return symboltypes;
+        //! returns the literals of all clauses, each clause is terminated by 0
+        std::vector<int> getClauses() const;
+        //! the number of literals in getClauses(), including the terminating zeros
+        unsigned int getLiteralCount() const { return mapped_size + clauses.size(); }
+        //! \return getClauses()[i], without copying the clauses
+        int getLiteral(unsigned int i) const {
+            return i < mapped_size ? mapped_clauses.get()[i] : clauses[i - mapped_size];
         }
+        //! returns the literals pushed into this cnf, i.e., without the clauses of a binary file
+        const std::vector<int> &getPushedClauses() const { return clauses; }
+        int newVar();
+        //! \return true if the variable belongs to a Kconfig symbol
+        bool hasAssociatedSymbol(const std::string &var) const;
+        const SymbolTable &getSymbolTable() const { return *symbols; }
         const std::map<std::string, std::deque<std::string>> &getMetaInformation() const {
             return meta_information;
         }
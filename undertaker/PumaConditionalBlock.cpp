@@ -38,6 +38,7 @@
 #include <Puma/PreSonIterator.h>
 #include <Puma/StrCol.h>
 
+#include <boost/filesystem.hpp>
 #include <set>
 
 using namespace Puma;
@@ -159,6 +160,21 @@ void PumaConditionalBlockBuilder::iterateNodes (PreTree *node) {
         i.currentItem()->accept(*this);
 }
 
+ConditionalBlock *PumaConditionalBlockBuilder::createDummyElseBlock(ConditionalBlock *parent,
+                                                                    ConditionalBlock *prev) {
+    auto tok = new Puma::Token(TOK_PRE_ELSE, Puma::Token::pre_id, "#else");
+    auto ptok = new Puma::PreTreeToken(tok);
+
+    auto tok2 = new Puma::Token(TOK_PRE_ELSE, Puma::Token::pre_id, "");
+    auto ptok2 = new Puma::PreTreeToken(tok2);
+
+    auto node = new Puma::PreElseDirective(ptok, ptok2);
+
+    auto newBlock = new PumaConditionalBlock(_file, parent, prev, node, _nodeNum++, *this);
+    newBlock->setDummyBlock();
+    return newBlock;
+}
+
 void undertaker_normalizations(Puma::Unit *);
 
 ConditionalBlock *PumaConditionalBlockBuilder::parse(const std::string &filename) {
@@ -625,6 +641,9 @@ void PumaConditionalBlockBuilder::resolve_includes(Puma::Unit *unit) {
                 removeIncludeGuard(file);
                 mc.paste_before(s, file);
                 already_seen.insert(file);
+                _included.push_back(file->name());
+            } else if (!file) {
+                missingInclude(unit->name(), include);
             }
             mc.kill(s, e);
             mc.commit();
@@ -634,6 +653,24 @@ void PumaConditionalBlockBuilder::resolve_includes(Puma::Unit *unit) {
     }
 }
 
+// records where the file of an unresolved #include would have been found
+void PumaConditionalBlockBuilder::missingInclude(const std::string &filename,
+                                                 const std::string &argument) {
+    const std::string::size_type open = argument.find_first_of("\"<");
+    if (open == std::string::npos)
+        return;
+    const std::string::size_type close = argument.find(argument[open] == '"' ? '"' : '>',
+                                                       open + 1);
+    if (close == std::string::npos)
+        return;
+    const std::string name = argument.substr(open + 1, close - open - 1);
+
+    if (argument[open] == '"')
+        _missing.push_back((boost::filesystem::path(filename).parent_path() / name).string());
+    for (const std::string &path : _includePaths)
+        _missing.push_back((boost::filesystem::path(path) / name).string());
+}
+
 void PumaConditionalBlockBuilder::reset_MacroManager(Puma::Unit *unit) {
     Puma::Token *s, *e;
 
@@ -116,7 +116,7 @@ public:
 /* PumaConditionalBlockBuilder                                          */
 /************************************************************************/
 
-class PumaConditionalBlockBuilder : public Puma::PreVisitor {
+class PumaConditionalBlockBuilder : public Puma::PreVisitor, public ConditionalBlockBuilder {
     unsigned long _nodeNum;
     void iterateNodes (Puma::PreTree *) final override;
     // Stack of open conditional blocks. Pushed to when entering #ifdef
@@ -138,6 +138,7 @@ class PumaConditionalBlockBuilder : public Puma::PreVisitor {
 
     void visitDefineHelper(Puma::PreTreeComposite *node, bool define);
     void resolve_includes(Puma::Unit *);
+    void missingInclude(const std::string &filename, const std::string &argument);
     void reset_MacroManager(Puma::Unit *unit);
     ConditionalBlock *parse(const std::string &filename);
 
@@ -150,7 +151,9 @@ public:
     ~PumaConditionalBlockBuilder() { _cpp->freeSyntaxTree(); };
     Puma::PreprocessorParser *cpp_parser() { return _cpp.get(); }
 
-    ConditionalBlock *topBlock() { return _top; }
+    ConditionalBlock *topBlock() final override { return _top; }
+    ConditionalBlock *createDummyElseBlock(ConditionalBlock *parent,
+                                           ConditionalBlock *prev) final override;
 
     void visitPreProgram_Pre (Puma::PreProgram *)                                final override;
     void visitPreProgram_Post (Puma::PreProgram *)                               final override;
@@ -164,7 +167,6 @@ public:
     void visitPreDefineFunctionDirective_Pre(Puma::PreDefineFunctionDirective *) final override;
     void visitPreUndefDirective_Pre (Puma::PreUndefDirective *)                  final override;
 
-    unsigned long *getNodeNum() { return &_nodeNum; }
     static void addIncludePath(const char *);
 };
 #endif
@@ -28,6 +28,10 @@
 #include "StringJoiner.h"
 #include "RsfReader.h"
 #include "Logging.h"
+#include "PicosatCNF.h"
+#include "CNFBuilder.h"
+#include "bool.h"
+#include "cpp14.h"
 
 #include <boost/filesystem.hpp>
 #include <boost/regex.hpp>
@@ -49,6 +53,8 @@ RsfConfigurationModel::RsfConfigurationModel(const std::string &filename) {
         Logging::warn("Couldn't open ", filepath.string(), " checking symbol types will fail");
         _rsf = new ItemRsfReader();  // create empty ItemRsfReader
     }
+    // the symbol types of the .rsf file change the results as well
+    setIdentity({filename, filepath.string()});
     // set configuration space regex
     const StringList *cfg_space_regex = _model->getMetaValue("CONFIGURATION_SPACE_REGEX");
     if (cfg_space_regex != nullptr && cfg_space_regex->size() > 0) {
@@ -60,6 +66,7 @@ RsfConfigurationModel::RsfConfigurationModel(const std::string &filename) {
     if (_model->size() == 0)
         // if the model is empty (e.g., if /dev/null was loaded), it cannot possibly be complete
         _model->addMetaValue("CONFIGURATION_SPACE_INCOMPLETE", "1");
+    loadBackbone(filename);
 }
 
 RsfConfigurationModel::~RsfConfigurationModel() {
@@ -120,6 +127,35 @@ void RsfConfigurationModel::doIntersectPreprocess(std::set<std::string> &item_se
     }
 }
 
+std::unique_ptr<kconfig::PicosatCNF> RsfConfigurationModel::createCNF() const {
+    auto cnf = make_unique<kconfig::PicosatCNF>();
+    // the formulas of doIntersectPreprocess(), with the constants as free as in the checks
+    kconfig::CNFBuilder builder(cnf.get(), "", false, kconfig::CNFBuilder::ConstantPolicy::FREE);
+    auto push = [&builder](const std::string &formula) {
+        kconfig::BoolExp *exp = kconfig::BoolExp::parseString(formula);
+        if (!exp) {
+            // leaving out a constraint only leaves out fixed items
+            Logging::debug("failed to parse '", formula, "'");
+            return;
+        }
+        builder.pushClause(exp);
+        exp->release();
+    };
+    for (const auto &entry : *_model)  // pair<string, string>
+        if (entry.second != "")
+            push(entry.first + " -> (" + entry.second + ")");
+    // doIntersect() only sets the items of ALWAYS_ON and ALWAYS_OFF that are in the model
+    if (const StringList *always_on = getWhitelist())
+        for (const std::string &str : *always_on)
+            if (containsSymbol(str))
+                push(str);
+    if (const StringList *always_off = getBlacklist())
+        for (const std::string &str : *always_off)
+            if (containsSymbol(str))
+                push("!" + str);
+    return cnf;
+}
+
 bool RsfConfigurationModel::isBoolean(const std::string &item) const {
     const std::string *value = _rsf->getValue(item);
     if (value && (*value == "boolean" || *value == "bool" ))
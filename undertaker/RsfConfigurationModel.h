@@ -39,6 +39,8 @@ class RsfConfigurationModel : public ConfigurationModel {
 
     void addMetaValue(const std::string &key, const std::string &val) const final override;
 
+    std::unique_ptr<kconfig::PicosatCNF> createCNF() const final override;
+
 public:
     //! Loads the configuration model from file
     //! \param filename filepath to the model file. (NB: The basename is taken as architecture name.)
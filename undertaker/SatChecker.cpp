@@ -31,7 +31,9 @@
 #include "CnfConfigurationModel.h"
 #include "Logging.h"
 #include "CNFBuilder.h"
+#include "KconfigWhitelist.h"
 #include "exceptions/CNFBuilderError.h"
+#include "exceptions/SatBudgetExceeded.h"
 #include "cpp14.h"
 #include "Tools.h"
 #include "StringJoiner.h"
@@ -40,14 +42,50 @@
 #include <boost/regex.hpp>
 #include <pstreams/pstream.h>
 
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
 #include <map>
 #include <ostream>
 #include <sstream>
+#include <stdexcept>
+#include <utility>
 #include <vector>
 
 using kconfig::PicosatCNF;
 using kconfig::CNFBuilder;
+using kconfig::BoolExp;
 
+namespace {
+    size_t words(size_t bits) { return (bits + 63) / 64; }
+
+    bool testBit(const SatChecker::AssignmentMap::Bits &bits, size_t i) {
+        return (bits[i / 64] >> (i % 64)) & 1;
+    }
+
+    void setBit(SatChecker::AssignmentMap::Bits &bits, size_t i) {
+        bits[i / 64] |= uint64_t(1) << (i % 64);
+    }
+
+    // builds an assignment from entries that are added in the order of their names
+    struct EntryCollector {
+        std::shared_ptr<SatChecker::AssignmentMap::Names> names =
+            std::make_shared<SatChecker::AssignmentMap::Names>();
+        SatChecker::AssignmentMap::Bits values;
+
+        void add(const std::string &name, bool value) {
+            if (names->size() % 64 == 0)
+                values.push_back(0);
+            if (value)
+                setBit(values, names->size());
+            names->add(name);
+        }
+
+        SatChecker::AssignmentMap map() {
+            return SatChecker::AssignmentMap(names, std::move(values));
+        }
+    };
+} // namespace
 
 /************************************************************************/
 /* SatChecker                                                           */
@@ -78,10 +116,21 @@ void SatChecker::loadCnfModel(const ConfigurationModel *m) {
 }
 
 const SatChecker::AssignmentMap &SatChecker::getAssignment() {
-    for (const auto &entry : _cnf->getSymbolMap()) {  // pair<string, int>
-        bool selected = this->_cnf->deref(entry.second);
-        assignmentTable.emplace(entry.first, selected);
+    const kconfig::SymbolTable &symbols = _cnf->getSymbolTable();
+    // the table is only built again when the cnf got new names
+    if (!_names || _names->size() != symbols.varCount()
+            || _names_varcount != _cnf->getVarCount()) {
+        auto names = std::make_shared<AssignmentMap::Names>();
+        for (int id : symbols.variables())
+            names->add(symbols.str(id), symbols.var(id));
+        _names = names;
+        _names_varcount = _cnf->getVarCount();
     }
+    AssignmentMap::Bits values(words(_names->size()), 0);
+    for (size_t i = 0; i < _names->size(); i++)
+        if (_cnf->deref(_names->vars[i]))
+            setBit(values, i);
+    assignmentTable = AssignmentMap(_names, std::move(values));
     return assignmentTable;
 }
 
@@ -90,53 +139,40 @@ bool SatChecker::operator()(const std::string &formula) {
     return _cnf->checkSatisfiable();
 }
 
+bool SatChecker::operator()(BoolExp *formula) {
+    CNFBuilder builder(_cnf.get(), "", true, CNFBuilder::ConstantPolicy::FREE);
+    builder.pushClause(formula);
+    return _cnf->checkSatisfiable();
+}
+
 bool SatChecker::checkMUS() {
-    // call picosat in quiet mode with stdin as input and stdout as output
-    redi::pstream cmd_process("picomus - -");
-    // write to stdin of the process
-    cmd_process << "p cnf " << _cnf->getVarCount() << " " << _cnf->getClauseCount() << std::endl;
-    for (const int &clause : _cnf->getClauses()) {
-        char sep = (clause == 0) ? '\n' : ' ';
-        cmd_process << clause << sep;
-    }
-    // send eof and tell cmd_process we will start reading from stdout of cmd
-    redi::peof(cmd_process);
-    cmd_process.out();
-    // read everything from cmd_process's stdout and close it
-    std::stringstream ss;
-    ss << cmd_process.rdbuf();
-    cmd_process.close();
-    // remove first line from ss (=UNSATISFIABLE)
-    std::string garbage;
-    std::getline(ss, garbage);
+    const std::vector<int> mus = _cnf->minimalUnsatisfiableSubset();
+    if (mus.empty()) {
+        Logging::error("Formula is satisfiable, skipping MUS analysis.");
+        return false;
+    }
+    musData.vars = _cnf->getVarCount();
+    musData.lines = std::count(mus.begin(), mus.end(), 0);
 
-    // create a string from DIMACs CNF Format (=picomus result) to a more readable CNF Format
+    // create a more readable CNF Format from the clauses of the MUS
     // Note: The formula might be incomplete, since a lot operators create new CNF-IDs without
     // having a destinct Symbolname, which are ignored in this output
-    std::string p, cnfstr;
-    ss >> p >> cnfstr >> musData.vars >> musData.lines;
-    if (p != "p" || cnfstr != "cnf") {
-        Logging::error("Mismatched output format, skipping MUS analysis.");
-        return false;
-    }
     UniqueStringJoiner sj;
     StringJoiner clause;
-    for (int i = 0, tmp; i < musData.lines; i++) {
-        clause.clear();
-        // process a line (i.e.: int int -int 0, where 0 terminates the clause)
-        while (ss >> tmp) {
-            if (tmp == 0)
-                break;
-            const std::string &sym = _cnf->getSymbolName(abs(tmp));
-            if (sym == "")
-                continue;
-            if (tmp < 0)
-                clause.emplace_back("!" + sym);
-            else
-                clause.emplace_back(sym);
+    for (const int &lit : mus) {
+        if (lit == 0) {
+            if (clause.size() > 0)  // collect only clauses with valid symbols
+                sj.emplace_back("(" + clause.join(" v ") + ")");
+            clause.clear();
+            continue;
         }
-        if (clause.size() > 0)  // collect only clauses with valid symbols
-            sj.emplace_back("(" + clause.join(" v ") + ")");
+        const std::string sym = _cnf->getSymbolName(abs(lit));
+        if (sym == "")
+            continue;
+        if (lit < 0)
+            clause.emplace_back("!" + sym);
+        else
+            clause.emplace_back(sym);
     }
     musData.minimized_formula = sj.join(" ^ ");
     return true;
@@ -157,6 +193,195 @@ void SatChecker::writeMUS(std::ostream &out, bool writeStatistics) const {
 /* Satchecker::AssignmentMap                                            */
 /************************************************************************/
 
+void SatChecker::AssignmentMap::Names::add(const std::string &name, int var) {
+    assert(names.empty() || names.back() < name);
+    names.push_back(name);
+    vars.push_back(var);
+    hashes.push_back(std::hash<std::string>()(name));
+}
+
+int SatChecker::AssignmentMap::Names::find(const std::string &name) const {
+    const auto it = std::lower_bound(names.begin(), names.end(), name);
+    return (it == names.end() || *it != name) ? -1 : it - names.begin();
+}
+
+SatChecker::AssignmentMap::const_iterator::value_type
+SatChecker::AssignmentMap::const_iterator::operator*() const {
+    return value_type(map->names->names[pos], testBit(map->values, pos));
+}
+
+size_t SatChecker::AssignmentMap::Hash::operator()(const AssignmentMap &map) const {
+    // the sum doesn't depend on the order of the entries, hence neither on the table
+    size_t hash = 0;
+    for (size_t w = 0; w < map.present.size(); w++) {
+        for (uint64_t word = map.present[w]; word; word &= word - 1) {
+            const size_t i = w * 64 + __builtin_ctzll(word);
+            hash += map.names->hashes[i] ^ (testBit(map.values, i) ? 0x9e3779b97f4a7c15 : 0);
+        }
+    }
+    return hash;
+}
+
+SatChecker::AssignmentMap::AssignmentMap(std::shared_ptr<const Names> names, Bits values)
+        : names(std::move(names)), present(words(this->names->size()), ~uint64_t(0)),
+          values(std::move(values)) {
+    assert(this->values.size() == present.size());
+    // the bits beyond the table stay clear, so the maps can be compared word by word
+    if (this->names->size() % 64 != 0) {
+        present.back() >>= 64 - this->names->size() % 64;
+        this->values.back() &= present.back();
+    }
+}
+
+size_t SatChecker::AssignmentMap::nextEntry(size_t pos) const {
+    const size_t n = tableSize();
+    while (pos < n) {
+        const uint64_t word = present[pos / 64] >> (pos % 64);
+        if (word)
+            return pos + __builtin_ctzll(word);
+        pos = (pos / 64 + 1) * 64;
+    }
+    return n;
+}
+
+SatChecker::AssignmentMap::const_iterator
+SatChecker::AssignmentMap::find(const std::string &name) const {
+    const int pos = names ? names->find(name) : -1;
+    if (pos < 0 || !testBit(present, pos))
+        return end();
+    return const_iterator(this, pos);
+}
+
+bool SatChecker::AssignmentMap::at(const std::string &name) const {
+    const auto it = find(name);
+    if (it == end())
+        throw std::out_of_range("AssignmentMap: no value for " + name);
+    return (*it).second;
+}
+
+size_t SatChecker::AssignmentMap::size() const {
+    size_t count = 0;
+    for (const uint64_t &word : present)
+        count += __builtin_popcountll(word);
+    return count;
+}
+
+bool SatChecker::AssignmentMap::emplace(const std::string &name, bool value) {
+    int pos = names ? names->find(name) : -1;
+    if (pos < 0) {
+        // copy the table with the new name, the following entries move up by one
+        const size_t n = tableSize();
+        const size_t at = names ? std::lower_bound(names->names.begin(), names->names.end(), name)
+                                      - names->names.begin()
+                                : 0;
+        auto table = std::make_shared<Names>();
+        Bits p(words(n + 1), 0), v(words(n + 1), 0);
+        for (size_t i = 0; i < n; i++) {
+            if (i == at)
+                table->add(name);
+            const size_t j = table->size();
+            table->add(names->names[i], names->vars[i]);
+            if (testBit(present, i))
+                setBit(p, j);
+            if (testBit(values, i))
+                setBit(v, j);
+        }
+        if (at == n)
+            table->add(name);
+        names = table;
+        present.swap(p);
+        values.swap(v);
+        pos = at;
+    } else if (testBit(present, pos)) {
+        return false;
+    }
+    setBit(present, pos);
+    if (value)
+        setBit(values, pos);
+    return true;
+}
+
+SatChecker::AssignmentMap SatChecker::AssignmentMap::select(Filter &filter) const {
+    if (!names)
+        return *this;
+    if (filter.names != names) {
+        filter.mask.assign(words(names->size()), 0);
+        for (size_t i = 0; i < names->size(); i++)
+            if (filter.accept(names->names[i]))
+                setBit(filter.mask, i);
+        filter.names = names;
+    }
+    AssignmentMap result(*this);
+    for (size_t w = 0; w < present.size(); w++) {
+        result.present[w] &= filter.mask[w];
+        result.values[w] &= filter.mask[w];
+    }
+    return result;
+}
+
+SatChecker::AssignmentMap SatChecker::AssignmentMap::difference(const AssignmentMap &other) const {
+    if (names == other.names) {
+        AssignmentMap result(*this);
+        for (size_t w = 0; w < present.size(); w++) {
+            const uint64_t same = other.present[w] & ~(values[w] ^ other.values[w]);
+            result.present[w] &= ~same;
+            result.values[w] &= ~same;
+        }
+        return result;
+    }
+    EntryCollector collector;
+    for (const auto &entry : *this) {  // pair<string, bool>
+        const auto it = other.find(entry.first);
+        if (it == other.end() || (*it).second != entry.second)
+            collector.add(entry.first, entry.second);
+    }
+    return collector.map();
+}
+
+SatChecker::AssignmentMap SatChecker::AssignmentMap::intersect(
+        const std::list<AssignmentMap> &maps) {
+    if (maps.empty())
+        return AssignmentMap();
+    const AssignmentMap &first = maps.front();
+    const bool shared = std::all_of(maps.begin(), maps.end(), [&first](const AssignmentMap &m) {
+        return m.names == first.names;
+    });
+    if (shared) {
+        AssignmentMap result(first);
+        for (const AssignmentMap &m : maps) {
+            for (size_t w = 0; w < result.present.size(); w++) {
+                const uint64_t same = m.present[w] & ~(m.values[w] ^ first.values[w]);
+                result.present[w] &= same;
+                result.values[w] &= same;
+            }
+        }
+        return result;
+    }
+    EntryCollector collector;
+    for (const auto &entry : first) {  // pair<string, bool>
+        const bool common = std::all_of(maps.begin(), maps.end(), [&entry](const AssignmentMap &m) {
+            const auto it = m.find(entry.first);
+            return it != m.end() && (*it).second == entry.second;
+        });
+        if (common)
+            collector.add(entry.first, entry.second);
+    }
+    return collector.map();
+}
+
+bool SatChecker::AssignmentMap::operator==(const AssignmentMap &other) const {
+    if (names == other.names)
+        return present == other.present && values == other.values;
+    if (size() != other.size())
+        return false;
+    for (const auto &entry : *this) {  // pair<string, bool>
+        const auto it = other.find(entry.first);
+        if (it == other.end() || (*it).second != entry.second)
+            return false;
+    }
+    return true;
+}
+
 void SatChecker::AssignmentMap::setEnabledBlocks(std::vector<bool> &blocks) {
     static const boost::regex block_regexp("^B(\\d+)$");
     for (const auto &entry : *this) {  // pair<string, bool>
@@ -365,7 +590,11 @@ int SatChecker::AssignmentMap::formatCommented(std::ostream &out, const CppFile
     Puma::TokenStream stream;
     sighandler_t oldaction;
 
-    PumaConditionalBlock *topBlock = (PumaConditionalBlock *)file.topBlock();
+    PumaConditionalBlock *topBlock = dynamic_cast<PumaConditionalBlock *>(file.topBlock());
+    if (!topBlock) {
+        Logging::error("commented sources need the Puma parser (-p puma)");
+        return 0;
+    }
     Puma::Unit *unit = topBlock->unit();
     if (!unit) {
         // in this case we have lost. this can happen e.g. on an empty
@@ -497,62 +726,22 @@ void SatChecker::pprintAssignments(std::ostream &out,
     out << "I: Found " << solutions.size() << " assignments" << std::endl;
     out << "I: Entries in missingSet: " << missingSet.size() << std::endl;
 
-    std::map<std::string, bool> common_subset;
-
-    for (const auto &conf : solutions) {  // AssignmentMap
-        for (const auto &entry : conf) {  // pair<string, bool>
-            const std::string &name = entry.first;
-            const bool &valid = entry.second;
-
-            if (model && !model->inConfigurationSpace(name))
-                continue;
-
-            if (conf == solutions.front()) {
-                // Copy first assignment to common subset map
-                common_subset[name] = valid;
-            } else {
-                if (common_subset.find(name) != common_subset.end()
-                    && common_subset[name] != valid) {
-                    // In this assignment the symbol has a different
-                    // value, remove it from the common subset map
-                    common_subset.erase(name);
-                }
-            }
-        }
-    }
-
-    // Remove all items from common subset, that are not in all assignments
-    for (const auto &entry : common_subset) {  // pair<string, bool>
-        const std::string &name = entry.first;
-        for (auto &conf : solutions) {  // AssignmentMap
-            if (conf.find(name) == conf.end())
-                common_subset.erase(name);
-        }
-    }
+    AssignmentMap::Filter inModel([model](const std::string &name) {
+        return !model || model->inConfigurationSpace(name);
+    });
+    std::list<AssignmentMap> relevant;
+    for (const auto &conf : solutions)  // AssignmentMap
+        relevant.push_back(conf.select(inModel));
+    const AssignmentMap common_subset = AssignmentMap::intersect(relevant);
 
     out << "I: In all assignments the following symbols are equally set" << std::endl;
-    for (const auto &entry : common_subset) {  // pair<string, bool>
-        const std::string &name = entry.first;
-        const bool &valid = entry.second;
-        out << name << "=" << (valid ? 1 : 0) << std::endl;
-    }
+    common_subset.formatAll(out);
 
     out << "I: All differences in the assignments" << std::endl;
     int i = 0;
-    for (const auto &conf : solutions) {  // AssignmentMap
+    for (const auto &conf : relevant) {  // AssignmentMap
         out << "I: Config " << i++ << std::endl;
-        for (const auto &entry : conf) {  // pair<string, bool>
-            const std::string &name = entry.first;
-            const bool &valid = entry.second;
-
-            if (model && !model->inConfigurationSpace(name))
-                continue;
-
-            if (common_subset.find(name) != common_subset.end())
-                continue;
-
-            out << name << "=" << (valid ? 1 : 0) << std::endl;
-        }
+        conf.difference(common_subset).formatAll(out);
     }
 }
 
@@ -566,10 +755,7 @@ bool BaseExpressionSatChecker::operator()(const std::set<std::string> &assumeSym
     for (const std::string &str : assumeSymbols)
         _cnf->pushAssumption(str, true);
 
-    bool res = _cnf->checkSatisfiable();
-    if (res)
-        assignmentTable.clear();
-    return res;
+    return _cnf->checkSatisfiable();
 }
 
 BaseExpressionSatChecker::BaseExpressionSatChecker(std::string base_expression,
@@ -577,3 +763,274 @@ BaseExpressionSatChecker::BaseExpressionSatChecker(std::string base_expression,
         : SatChecker(model) {
     CNFBuilder builder(_cnf.get(), base_expression, true, CNFBuilder::ConstantPolicy::BOUND);
 }
+
+/************************************************************************/
+/* IncrementalSatChecker                                                */
+/************************************************************************/
+
+int IncrementalSatChecker::_slice_depth = -1;
+
+IncrementalSatChecker::IncrementalSatChecker(const ConfigurationModel *model)
+        : _model(model) {
+    loadModel();
+    _model_vars = _cnf->getVarCount();
+}
+
+void IncrementalSatChecker::loadModel() {
+    _sliced = nullptr;
+    if (_model && _model->getModelVersionIdentifier() == "cnf") {
+        const auto *cnf_model = dynamic_cast<const CnfConfigurationModel *>(_model);
+        _cnf = make_unique<PicosatCNF>(*cnf_model->getCNF(), Picosat::SAT_MAX);
+        if (_slice_depth != 0) {
+            // keep the variables, the clauses are pushed by loadCone()
+            _cnf->clearClauses();
+            _sliced = cnf_model;
+        }
+    } else {
+        _cnf = make_unique<PicosatCNF>(Picosat::SAT_MAX);
+    }
+    _builder = make_unique<CNFBuilder>(_cnf.get(), "", true, CNFBuilder::ConstantPolicy::FREE, 0,
+                                       CNFBuilder::Encoding::POLARITY);
+    _cone = CnfConfigurationModel::Cone();
+    _scanned = 0;
+}
+
+bool IncrementalSatChecker::loadCone(const std::vector<int> &assumptions, int depth) {
+    if (!_sliced)
+        return true;
+    // the variables of the model keep their numbers in _cnf
+    const std::vector<int> &literals = _cnf->getPushedClauses();
+    std::vector<int> vars(literals.begin() + _scanned, literals.end());
+    vars.insert(vars.end(), assumptions.begin(), assumptions.end());
+    bool complete = _sliced->pushCone(_cnf.get(), vars, _cone, depth);
+    _scanned = _cnf->getPushedClauses().size();
+    return complete;
+}
+
+void IncrementalSatChecker::beginQuery() {
+    // every retired query leaves its variables and clauses behind, which slows
+    // down each following check. Once they outgrow the model, start over.
+    if (_cnf->getVarCount() > 2 * _model_vars)
+        loadModel();
+    _activation = _cnf->newVar();
+    _builder->setGuard(_activation);
+}
+
+void IncrementalSatChecker::addFormula(const std::string &formula) {
+    if (formula.empty())
+        return;
+    BoolExp *exp = BoolExp::parseString(formula);
+    if (!exp)
+        throw CNFBuilderError("CNFBuilder: Couldn't parse: " + formula);
+    _builder->pushClause(exp);
+    exp->release();
+}
+
+void IncrementalSatChecker::addFormula(BoolExp *formula) {
+    _builder->pushClause(formula);
+}
+
+bool IncrementalSatChecker::operator()(const std::string &formula) {
+    addFormula(formula);
+    return checkAssuming(AssignmentMap());
+}
+
+bool IncrementalSatChecker::operator()(BoolExp *formula) {
+    addFormula(formula);
+    return checkAssuming(AssignmentMap());
+}
+
+bool IncrementalSatChecker::checkAssuming(const AssignmentMap &assumptions) {
+    std::vector<int> literals;
+    for (const auto &entry : assumptions) {  // pair<string, bool>
+        int var = _cnf->getCNFVar(entry.first);
+        if (var == 0) {
+            // variables the formulas don't mention are free
+            var = _cnf->newVar();
+            _cnf->setCNFVar(entry.first, var);
+        }
+        literals.push_back(entry.second ? var : -var);
+    }
+    if (_activation)
+        literals.push_back(_activation);
+
+    bool complete = loadCone(literals, _slice_depth);
+    for (int literal : literals)
+        _cnf->pushAssumption(literal);
+    if (!_cnf->checkSatisfiable())
+        return false;
+    if (complete)
+        return true;
+    // the clauses beyond the depth limit may contradict the assignment
+    loadCone(literals, -1);
+    for (int literal : literals)
+        _cnf->pushAssumption(literal);
+    return _cnf->checkSatisfiable();
+}
+
+bool IncrementalSatChecker::deref(const std::string &var) const {
+    // variables the formulas don't mention are free, false is as good as true
+    int cnfvar = _cnf->getCNFVar(var);
+    return cnfvar != 0 && _cnf->deref(cnfvar);
+}
+
+std::list<std::string> IncrementalSatChecker::checkArchitectures(
+        const std::deque<std::string> &archs) {
+    std::list<std::string> satisfiable;
+    std::set<std::string> witnessed;
+    for (const std::string &arch : archs) {
+        if (witnessed.count(arch) == 0) {
+            AssignmentMap assumptions;
+            assumptions.emplace("ARCH_" + arch, true);
+            if (!checkAssuming(assumptions))
+                continue;
+            // the assignment satisfies the query on all architectures it selects
+            for (const std::string &other : archs)
+                if (deref("ARCH_" + other))
+                    witnessed.insert(other);
+        }
+        satisfiable.push_back(arch);
+    }
+    return satisfiable;
+}
+
+void IncrementalSatChecker::endQuery() {
+    if (!_activation)
+        return;
+    // the clauses of the query are satisfied from now on
+    _cnf->pushVar(-_activation);
+    _cnf->pushClause();
+    _activation = 0;
+    _builder->setGuard(0);
+}
+
+IncrementalSatChecker &IncrementalSatChecker::forModel(const ConfigurationModel *model) {
+    // solver instances must not be shared between threads
+    static thread_local std::map<const ConfigurationModel *,
+                                 std::unique_ptr<IncrementalSatChecker>> checkers;
+    std::unique_ptr<IncrementalSatChecker> &checker = checkers[model];
+    if (!checker)
+        checker = make_unique<IncrementalSatChecker>(model);
+    return *checker;
+}
+
+/************************************************************************/
+/* SatResultCache                                                       */
+/************************************************************************/
+
+std::string SatResultCache::_directory;
+
+namespace {
+    std::string trimmed(const std::string &str) {
+        size_t begin = str.find_first_not_of(" \t\n");
+        if (begin == std::string::npos)
+            return "";
+        return str.substr(begin, str.find_last_not_of(" \t\n") - begin + 1);
+    }
+
+    // splits the formula at its top level '&&', a formula with
+    // other top level operators is a single conjunct
+    std::vector<std::string> conjuncts(const std::string &formula) {
+        std::vector<std::string> result;
+        int depth = 0;
+        size_t begin = 0;
+        for (size_t i = 0; i + 1 < formula.size(); i++) {
+            if (formula[i] == '(') {
+                depth++;
+            } else if (formula[i] == ')') {
+                depth--;
+            } else if (depth == 0) {
+                const char next = formula[i + 1];
+                if (formula[i] == '&' && next == '&') {
+                    result.push_back(trimmed(formula.substr(begin, i - begin)));
+                    begin = i + 2;
+                } else if ((formula[i] == '|' && next == '|') || (formula[i] == '-' && next == '>')) {
+                    return {trimmed(formula)};
+                }
+            }
+        }
+        result.push_back(trimmed(formula.substr(begin)));
+        return result;
+    }
+} // namespace
+
+std::string SatResultCache::canonicalize(const ConfigurationModel *model,
+                                         const std::vector<std::string> &formulas) {
+    static const boost::regex local_var("\\<(B[0-9]+\\>|FILE_[^[:space:]()]+)");
+    // other models constrain the files only in the formulas, but a cnf model
+    // constrains FILE_<path> by name
+    const bool rename_files = !model || model->getModelVersionIdentifier() != "cnf";
+    std::map<std::string, std::string> renamed;
+    std::stringstream text;
+
+    text << (model ? model->getIdentity() : "") << "\n";
+    // the ignored items are free variables in every check
+    for (const std::string &item : KconfigWhitelist::getIgnorelist())
+        text << item << " ";
+    for (const std::string &formula : formulas) {
+        std::string local;
+        auto last = formula.cbegin();
+        for (boost::sregex_iterator it(formula.begin(), formula.end(), local_var), end;
+             it != end; ++it) {
+            if (!rename_files && undertaker::starts_with(it->str(), "FILE_"))
+                continue;
+            local.append(last, (*it)[0].first);
+            local += renamed.emplace(it->str(), "@" + std::to_string(renamed.size())).first->second;
+            last = (*it)[0].second;
+        }
+        local.append(last, formula.cend());
+
+        std::vector<std::string> parts = conjuncts(local);
+        std::sort(parts.begin(), parts.end());
+        text << "\n;";
+        for (const std::string &part : parts)
+            if (!part.empty())
+                text << "\n" << part;
+    }
+    return text.str();
+}
+
+bool SatResultCache::lookup(const std::string &canonical, std::string &result) {
+    // different texts may have the same hash, hence the file contains the text
+    std::ifstream in(undertaker::cacheFilename(_directory, canonical));
+    std::string stored_result;
+    if (!std::getline(in, stored_result))
+        return false;
+    std::stringstream text;
+    text << in.rdbuf();
+    if (text.str() != canonical)
+        return false;
+    result = stored_result;
+    return true;
+}
+
+void SatResultCache::store(const std::string &canonical, const std::string &result) {
+    const std::string filename = undertaker::cacheFilename(_directory, canonical);
+    if (!undertaker::writeFileAtomically(filename, result + "\n" + canonical))
+        Logging::debug("Couldn't write ", filename);
+}
+
+/************************************************************************/
+/* FileBudget                                                           */
+/************************************************************************/
+
+const char *const FileBudget::timeout_reason = "the time budget of the file is exhausted";
+
+FileBudget::FileBudget(unsigned int seconds, Cancellation cancelled)
+        : _deadline(seconds ? std::chrono::steady_clock::now() + std::chrono::seconds(seconds)
+                            : std::chrono::steady_clock::time_point::max()),
+          _cancelled(std::move(cancelled)) {}
+
+bool FileBudget::exhausted() const {
+    return cancelled() || std::chrono::steady_clock::now() >= _deadline;
+}
+
+void FileBudget::check() const {
+    if (exhausted())
+        throw SatBudgetExceeded(timeout_reason);
+}
+
+void FileBudget::markUnknown(const std::string &block, const std::string &reason) {
+    Logging::warn(block, ": unknown, ", reason);
+    _unknown.push_back(block);
+}
@@ -27,11 +27,19 @@
 #define sat_checker_h__
 
 #include "PicosatCNF.h"
+#include "CNFBuilder.h"
+#include "CnfConfigurationModel.h"
 
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
 #include <map>
 #include <set>
 #include <list>
 #include <memory>
+#include <string>
+#include <vector>
 
 typedef std::set<std::string> MissingSet;
 
@@ -64,6 +72,8 @@ public:
      * @throws CnfBuilderError when a syntax error occured
      */
     bool operator()(const std::string &formula);
+    //! checks the expression, which is encoded without formatting and parsing it
+    bool operator()(kconfig::BoolExp *formula);
 
     static bool check(const std::string &sat);
 
@@ -77,21 +87,105 @@ public:
      *
      *   - key:   something like 'B42'
      *   - value: true if set, false if unset or unknown
+     *
+     * The names are kept in a table that is sorted by name and shared by
+     * all assignments of a checker. The map itself only holds two bit
+     * vectors over the entries of the table, one for the names that are
+     * part of the map and one for their values. Hence, assignments of the
+     * same checker are copied, hashed and compared word by word.
      */
-    struct AssignmentMap : public std::map<std::string, bool> {
+    class AssignmentMap {
+    public:
+        typedef std::vector<uint64_t> Bits;
+
+        //! names in alphabetical order, with their cnf variable (or 0) and hash
+        struct Names {
+            std::vector<std::string> names;
+            std::vector<int> vars;
+            std::vector<size_t> hashes;
+
+            void add(const std::string &name, int var = 0);
+            //! \return the position of the name, -1 if it is missing
+            int find(const std::string &name) const;
+            size_t size() const { return names.size(); }
+        };
+
         /**
-            * \brief order independent content comparison
-            *
-            * This method compares if two assignments are equivalent.
-            */
-        bool operator==(const AssignmentMap &other) const {
-            for (const auto &entry : *this) {  // pair<string, bool>
-                auto ot = other.find(entry.first);
-                if (ot == other.end() || (*ot).second != entry.second)
-                    return false;
+         * \brief predicate on the names of an assignment
+         *
+         * The filter remembers which entries of the last name table it
+         * was applied to match, so it tests each name only once.
+         */
+        class Filter {
+            std::function<bool(const std::string &)> accept;
+            std::shared_ptr<const Names> names;
+            Bits mask;
+            friend class AssignmentMap;
+
+        public:
+            explicit Filter(std::function<bool(const std::string &)> accept)
+                : accept(std::move(accept)) {}
+        };
+
+        //! iterates the entries in the order of their names
+        class const_iterator {
+            const AssignmentMap *map;
+            size_t pos;
+
+        public:
+            typedef std::pair<const std::string &, bool> value_type;
+
+            const_iterator(const AssignmentMap *map, size_t pos)
+                : map(map), pos(map->nextEntry(pos)) {}
+            value_type operator*() const;
+            const_iterator &operator++() {
+                pos = map->nextEntry(pos + 1);
+                return *this;
             }
-            return true;
-        }
+            bool operator==(const const_iterator &other) const { return pos == other.pos; }
+            bool operator!=(const const_iterator &other) const { return pos != other.pos; }
+        };
+
+        struct Hash {
+            size_t operator()(const AssignmentMap &) const;
+        };
+
+        AssignmentMap() = default;
+        //! assigns a value to each name of the table
+        AssignmentMap(std::shared_ptr<const Names> names, Bits values);
+
+        const_iterator begin() const { return const_iterator(this, 0); }
+        const_iterator end() const { return const_iterator(this, tableSize()); }
+        const_iterator find(const std::string &name) const;
+        //! \throws std::out_of_range if the name is not part of the map
+        bool at(const std::string &name) const;
+        size_t size() const;
+        bool empty() const { return size() == 0; }
+
+        /**
+         * Adds the name with the given value, unless it is already part of
+         * the map. Names missing in the table are inserted into a copy of
+         * the table, hence this is meant for small maps.
+         * \return true if the name has been added
+         */
+        bool emplace(const std::string &name, bool value);
+
+        //! \return the entries whose names pass the filter
+        AssignmentMap select(Filter &filter) const;
+        //! \return the entries that are missing in the other map or differ from it
+        AssignmentMap difference(const AssignmentMap &other) const;
+        //! \return the entries that are part of all given maps with the same value
+        static AssignmentMap intersect(const std::list<AssignmentMap> &maps);
+
+        /**
+         * \brief content comparison
+         *
+         * This method compares if two assignments contain the same names
+         * with the same values. Assignments with different name tables
+         * are compared name by name.
+         */
+        bool operator==(const AssignmentMap &other) const;
+        bool operator!=(const AssignmentMap &other) const { return !(*this == other); }
 
         /**
          * \brief collect enabled blocks
@@ -179,7 +273,15 @@ public:
          */
         int formatCombined(const CppFile &file, const ConfigurationModel *model,
             const MissingSet& missingSet, unsigned number) const;
-    }; // end struct AssignmentMap
+
+    private:
+        std::shared_ptr<const Names> names;
+        Bits present, values;
+
+        size_t tableSize() const { return names ? names->size() : 0; }
+        //! \return the first entry of the map at or after pos, tableSize() if there is none
+        size_t nextEntry(size_t pos) const;
+    }; // end class AssignmentMap
 
     // After doing the check, you can get the assignments for the formula
     const AssignmentMap &getAssignment();
@@ -196,6 +298,9 @@ public:
 protected:
     std::unique_ptr<kconfig::PicosatCNF> _cnf;
     AssignmentMap assignmentTable;
+    //! names of the cnf variables, shared by the assignments
+    std::shared_ptr<const AssignmentMap::Names> _names;
+    int _names_varcount = 0;
 };
 
 /************************************************************************/
@@ -209,4 +314,161 @@ public:
     virtual ~BaseExpressionSatChecker() {}
     bool operator()(const std::set<std::string> &assumeSymbols);
 };
+
+/************************************************************************/
+/* IncrementalSatChecker                                                */
+/************************************************************************/
+
+/**
+ * \brief SAT checker that keeps a cnf model loaded across many queries
+ *
+ * The model is loaded into the solver only once. All formulas of a query
+ * are guarded by an activation literal, which is assumed while checking
+ * and permanently disabled when the query ends. Hence, the queries don't
+ * influence each other, but the solver keeps what it learned about the
+ * model. When the retired queries have grown larger than the model, the
+ * model is loaded into a fresh solver.
+ *
+ * Unless slicing is disabled, only the cone of influence of the queries is
+ * loaded from a cnf model, i.e., the clauses connected to their variables.
+ * The other clauses can't change the result of a check.
+ *
+ * A checker must not be shared between threads, forModel() gives each
+ * thread checkers of its own.
+ */
+class IncrementalSatChecker : public SatChecker {
+    const ConfigurationModel *_model;
+    int _model_vars;
+    int _activation = 0;
+    //! encodes the formulas of all queries, which share the encoding of their common subexpressions
+    std::unique_ptr<kconfig::CNFBuilder> _builder;
+    //! the model whose cone is loaded on demand, nullptr if the model is loaded completely
+    const CnfConfigurationModel *_sliced = nullptr;
+    CnfConfigurationModel::Cone _cone;
+    //! number of literals of _cnf whose variables are already in the cone
+    size_t _scanned = 0;
+    static int _slice_depth;
+
+    void loadModel();
+    bool loadCone(const std::vector<int> &assumptions, int depth);
+
+public:
+    explicit IncrementalSatChecker(const ConfigurationModel *);
+    virtual ~IncrementalSatChecker() {}
+
+    //! starts a new query, each query has to be finished with endQuery()
+    void beginQuery();
+    //! adds the formula to the current query without checking it
+    void addFormula(const std::string &formula);
+    void addFormula(kconfig::BoolExp *formula);
+    /**
+     * Adds the formula to the current query and checks all formulas
+     * of the query together with the model
+     * @returns true, if satisfiable, false otherwise
+     * @throws CnfBuilderError when a syntax error occured
+     */
+    bool operator()(const std::string &formula);
+    bool operator()(kconfig::BoolExp *formula);
+    /**
+     * Checks the formulas of the current query together with the model,
+     * assuming the given variable assignments
+     * @returns true, if satisfiable, false otherwise
+     */
+    bool checkAssuming(const AssignmentMap &assumptions);
+    //! value of the variable in the assignment found by the last satisfiable check
+    bool deref(const std::string &var) const;
+    /**
+     * Checks the formulas of the current query on each architecture of a model
+     * merged by 'rsf2cnf -a'
+     * @param archs the architectures of the merged model
+     * @returns the architectures on which the query is satisfiable
+     */
+    std::list<std::string> checkArchitectures(const std::deque<std::string> &archs);
+    //! retracts all formulas of the current query
+    void endQuery();
+
+    //! returns the calling thread's checker for the given cnf model
+    static IncrementalSatChecker &forModel(const ConfigurationModel *);
+
+    /**
+     * Sets how many steps the cone of influence follows the clauses of a cnf model
+     * @param depth 0 loads the whole model, a negative depth loads the whole cone.
+     *     Otherwise, a satisfiable check is repeated with the whole cone.
+     */
+    static void setSliceDepth(int depth) { _slice_depth = depth; }
+};
+
+/************************************************************************/
+/* SatResultCache                                                       */
+/************************************************************************/
+
+/**
+ * \brief on-disk store for the results of satisfiability checks
+ *
+ * The results are kept in a directory, which may be shared by several
+ * processes and runs. A result is looked up by the canonical text of the
+ * checked formulas: block and file variables are renamed in the order of
+ * their appearance, and the conjuncts of each formula are sorted. Hence,
+ * files with the same #ifdef structure share their results. On cnf models,
+ * file variables keep their names, since the model constrains them by name.
+ */
+class SatResultCache {
+    static std::string _directory;
+
+public:
+    //! enables the cache, the results are stored below the given directory
+    static void setDirectory(const std::string &directory) { _directory = directory; }
+    static bool isEnabled() { return !_directory.empty(); }
+    //! canonical text of the formulas, which are checked on the model in the given order
+    static std::string canonicalize(const ConfigurationModel *,
+                                    const std::vector<std::string> &formulas);
+    //! \return false if no result is stored for the canonical text
+    static bool lookup(const std::string &canonical, std::string &result);
+    static void store(const std::string &canonical, const std::string &result);
+};
+
+/************************************************************************/
+/* FileBudget                                                           */
+/************************************************************************/
+
+/**
+ * \brief time budget for the checks on the blocks of a single file
+ *
+ * Each check is limited by PicosatCNF::setPropagationBudget(), all checks
+ * of a file together by the time given to the budget. Blocks whose checks
+ * exceed the propagation budget, and the blocks left over when the time
+ * has run out, are recorded as unknown. The analysis continues with the
+ * next block, so the results of the other blocks are kept.
+ *
+ * A job that is abandoned by its watchdog is cancelled. From then on, its
+ * budget is exhausted, and the job doesn't write any further reports.
+ */
+class FileBudget {
+    std::chrono::steady_clock::time_point _deadline;
+    std::shared_ptr<const std::atomic<bool>> _cancelled;
+    std::list<std::string> _unknown;
+
+public:
+    //! set once the job of the file has been abandoned
+    typedef std::shared_ptr<const std::atomic<bool>> Cancellation;
+
+    //! the reason recorded for the blocks left over when the time has run out
+    static const char *const timeout_reason;
+
+    /**
+     * \param seconds the time for all checks of the file, 0 means no limit
+     * \param cancelled the flag of the job, nullptr if it can't be cancelled
+     */
+    explicit FileBudget(unsigned int seconds, Cancellation cancelled = nullptr);
+    //! true if the time of the file has run out or the job has been cancelled
+    bool exhausted() const;
+    //! true if the job has been cancelled, its results aren't wanted anymore
+    bool cancelled() const { return _cancelled && *_cancelled; }
+    //! \throws SatBudgetExceeded with timeout_reason if the time of the file has run out
+    void check() const;
+    //! records the outcome of the block as unknown
+    void markUnknown(const std::string &block, const std::string &reason);
+    //! the blocks recorded as unknown, in the order of markUnknown()
+    const std::list<std::string> &getUnknown() const { return _unknown; }
+};
 #endif
@@ -0,0 +1,698 @@
+/*
+ *   undertaker - analyze preprocessor blocks in code
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "ScannerConditionalBlock.h"
+#include "Logging.h"
+
+#include <boost/filesystem.hpp>
+#include <algorithm>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+/************************************************************************/
+/* static functions                                                     */
+/************************************************************************/
+
+static inline bool is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v';
+}
+
+static inline bool is_ident_start(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || c == '$';
+}
+
+static inline bool is_ident(char c) {
+    return is_ident_start(c) || (c >= '0' && c <= '9');
+}
+
+static std::string trim(const std::string &s) {
+    std::string::size_type start = 0, end = s.size();
+    while (start < end && is_space(s[start]))
+        ++start;
+    while (end > start && is_space(s[end - 1]))
+        --end;
+    return s.substr(start, end - start);
+}
+
+//! \return the identifier at the start of s, leading whitespace is skipped
+static std::string leading_identifier(const std::string &s, std::string::size_type *end = nullptr) {
+    std::string::size_type start = 0;
+    while (start < s.size() && is_space(s[start]))
+        ++start;
+    std::string::size_type i = start;
+    if (i < s.size() && is_ident_start(s[i]))
+        while (i < s.size() && is_ident(s[i]))
+            ++i;
+    if (end)
+        *end = i;
+    return s.substr(start, i - start);
+}
+
+//! \return the position after the string or character literal starting at pos
+static std::string::size_type skip_literal(const std::string &s, std::string::size_type pos) {
+    const char quote = s[pos++];
+    while (pos < s.size() && s[pos] != quote)
+        pos += (s[pos] == '\\') ? 2 : 1;
+    return std::min(pos + 1, s.size());
+}
+
+//! \return the position after the parenthesized list starting at pos, npos if it isn't closed
+static std::string::size_type split_arguments(const std::string &s, std::string::size_type pos,
+                                              std::vector<std::string> &args) {
+    int depth = 0;
+    std::string::size_type start = pos + 1;
+    while (pos < s.size()) {
+        const char c = s[pos];
+        if (c == '"' || c == '\'') {
+            pos = skip_literal(s, pos);
+            continue;
+        } else if (c == '(') {
+            depth++;
+        } else if (c == ')' && --depth == 0) {
+            args.push_back(s.substr(start, pos - start));
+            return pos + 1;
+        } else if (c == ',' && depth == 1) {
+            args.push_back(s.substr(start, pos - start));
+            start = pos + 1;
+        }
+        ++pos;
+    }
+    return std::string::npos;
+}
+
+/// \brief replaces IS_ENABLED/IS_BUILTIN/IS_MODULE - Makros, like the Puma normalizations
+static std::string normalize_defined_makros(const std::string &exp) {
+    std::string result;
+    std::string::size_type i = 0;
+    while (i < exp.size()) {
+        if (!is_ident_start(exp[i])) {
+            result += exp[i++];
+            continue;
+        }
+        std::string::size_type end = i;
+        while (end < exp.size() && is_ident(exp[end]))
+            ++end;
+        const std::string name = exp.substr(i, end - i);
+        std::string::size_type close;
+        std::string arg;
+        if ((name == "IS_BUILTIN" || name == "IS_MODULE" || name == "IS_ENABLED")
+                && end < exp.size() && exp[end] == '('
+                && !(arg = leading_identifier(exp.substr(end + 1), &close)).empty()
+                && arg.size() == close && end + 1 + close < exp.size()
+                && exp[end + 1 + close] == ')') {
+            if (name == "IS_BUILTIN")
+                result += "defined(" + arg + ")";
+            else if (name == "IS_MODULE")
+                result += "defined(" + arg + "_MODULE)";
+            else
+                result += "(defined(" + arg + ") || defined(" + arg + "_MODULE))";
+            i = end + close + 2;
+        } else {
+            result += name;
+            i = end;
+        }
+    }
+    return result;
+}
+
+/// \brief checks for '#define FOO 0', which is handled like '#undef FOO'
+static bool is_define_null(const std::string &rest) {
+    std::string::size_type i = 0;
+    while (i < rest.size() && is_space(rest[i]))
+        ++i;
+    if (i == 0 || i >= rest.size() || rest[i] != '0')
+        return false;
+    return i + 1 == rest.size() || !(is_ident(rest[i + 1]) || rest[i + 1] == '.');
+}
+
+namespace {
+    //! read-only mapping of a whole file, other files than regular ones are read into memory
+    class MappedFile {
+        const char *_data = nullptr;
+        size_t _size = 0;
+        bool _good = false;
+        bool _mapped = false;
+        std::string _buffer;  // contents of a file that can't be mapped, e.g., /dev/null
+
+    public:
+        explicit MappedFile(const std::string &filename) {
+            int fd = open(filename.c_str(), O_RDONLY);
+            struct stat st;
+            if (fd < 0 || fstat(fd, &st) != 0) {
+                if (fd >= 0)
+                    close(fd);
+                return;
+            }
+            if (!S_ISREG(st.st_mode)) {
+                char chunk[4096];
+                ssize_t n;
+                while ((n = read(fd, chunk, sizeof(chunk))) > 0)
+                    _buffer.append(chunk, n);
+                _good = n == 0;
+                _data = _buffer.data();
+                _size = _buffer.size();
+            } else if ((_size = st.st_size) > 0) {
+                void *addr = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (addr != MAP_FAILED) {
+                    madvise(addr, _size, MADV_SEQUENTIAL);
+                    _data = static_cast<const char *>(addr);
+                    _good = _mapped = true;
+                }
+            } else {
+                _good = true;
+            }
+            close(fd);
+        }
+        ~MappedFile() {
+            if (_mapped)
+                munmap(const_cast<char *>(_data), _size);
+        }
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator=(const MappedFile &) = delete;
+
+        bool good() const { return _good; }
+        const char *data() const { return _data; }
+        size_t size() const { return _size; }
+    };
+} // namespace
+
+/************************************************************************/
+/* ScannerConditionalBlock                                              */
+/************************************************************************/
+
+const std::string ScannerConditionalBlock::getName() const {
+    if (!_parent) {
+        return "B00"; // top level block, represents file
+    } else {
+        std::string s("B");
+        s += std::to_string(_number);
+        if (useBlockWithFilename)
+            // get the normalized file variable without "FILE" prefix and append to the block name
+            s += &fileVar()[4];
+        return s;
+    }
+}
+
+/************************************************************************/
+/* ScannerConditionalBlockBuilder                                       */
+/************************************************************************/
+
+std::list<std::string> ScannerConditionalBlockBuilder::_includePaths;
+
+void ScannerConditionalBlockBuilder::addIncludePath(const char *path) {
+    _includePaths.push_back(path);
+}
+
+bool ScannerConditionalBlockBuilder::scan(const std::string &filename,
+                                          DirectiveList &directives) {
+    MappedFile file(filename);
+    if (!file.good())
+        return false;
+
+    const char *buf = file.data();
+    const size_t size = file.size();
+    unsigned int line = 1;
+    size_t i = 0, line_offset = 0;  // line_offset: start of the current physical line
+    bool line_start = true;         // only whitespace and comments on the logical line so far
+    bool code = false;              // code since the last directive
+
+    // newlines within comments and continuations advance the physical line
+    auto newline = [&](size_t pos) {
+        ++line;
+        line_offset = pos + 1;
+    };
+    auto continuation = [&](size_t pos) -> size_t {
+        // returns the length of a backslash-newline at pos, 0 if there is none
+        if (buf[pos] != '\\')
+            return 0;
+        if (pos + 1 < size && buf[pos + 1] == '\n')
+            return 2;
+        if (pos + 2 < size && buf[pos + 1] == '\r' && buf[pos + 2] == '\n')
+            return 3;
+        return 0;
+    };
+    // skips a comment starting at pos, appends nothing; returns the position after it
+    auto skip_comment = [&](size_t pos) -> size_t {
+        if (buf[pos + 1] == '*') {
+            for (pos += 2; pos < size; ++pos) {
+                if (buf[pos] == '\n')
+                    newline(pos);
+                else if (buf[pos] == '*' && pos + 1 < size && buf[pos + 1] == '/')
+                    return pos + 2;
+            }
+            return size;
+        }
+        // line comment, continues on the next line after a backslash-newline
+        while (pos < size && buf[pos] != '\n') {
+            if (size_t len = continuation(pos)) {
+                newline(pos + len - 1);
+                pos += len;
+            } else {
+                ++pos;
+            }
+        }
+        return pos;
+    };
+    auto is_comment = [&](size_t pos) {
+        return buf[pos] == '/' && pos + 1 < size && (buf[pos + 1] == '*' || buf[pos + 1] == '/');
+    };
+
+    while (i < size) {
+        const char c = buf[i];
+        if (size_t len = continuation(i)) {
+            newline(i + len - 1);
+            i += len;
+        } else if (c == '\n') {
+            newline(i++);
+            line_start = true;
+        } else if (is_space(c)) {
+            ++i;
+        } else if (is_comment(i)) {
+            i = skip_comment(i);
+        } else if (c == '#' && line_start) {
+            Directive directive;
+            directive.line = line;
+            directive.col = i - line_offset + 1;
+            directive.onlyWhitespaceBefore = !code;
+            std::string text;
+            for (++i; i < size && buf[i] != '\n';) {
+                if (size_t len = continuation(i)) {
+                    newline(i + len - 1);
+                    i += len;
+                } else if (is_comment(i)) {
+                    i = skip_comment(i);
+                } else if (buf[i] == '"' || buf[i] == '\'') {
+                    const char quote = buf[i];
+                    text += buf[i++];
+                    while (i < size && buf[i] != quote && buf[i] != '\n') {
+                        if (size_t len = continuation(i)) {
+                            newline(i + len - 1);
+                            i += len;
+                            continue;
+                        }
+                        if (buf[i] == '\\' && i + 1 < size && buf[i + 1] != '\n')
+                            text += buf[i++];
+                        text += buf[i++];
+                    }
+                    if (i < size && buf[i] == quote)
+                        text += buf[i++];
+                } else {
+                    text += buf[i++];
+                }
+            }
+            std::string::size_type end;
+            directive.keyword = leading_identifier(text, &end);
+            directive.text = text.substr(end);
+            directives.push_back(std::move(directive));
+            code = false;
+        } else if (c == '"' || c == '\'') {
+            // literals end at their closing quote or, if malformed, at the end of the line
+            for (++i; i < size && buf[i] != c && buf[i] != '\n';) {
+                if (size_t len = continuation(i)) {
+                    newline(i + len - 1);
+                    i += len;
+                } else {
+                    i += (buf[i] == '\\' && i + 1 < size && buf[i + 1] != '\n') ? 2 : 1;
+                }
+            }
+            if (i < size && buf[i] == c)
+                ++i;
+            line_start = false;
+            code = true;
+        } else {
+            ++i;
+            line_start = false;
+            code = true;
+        }
+    }
+    directives.onlyWhitespaceAfter = !code;
+    return true;
+}
+
+ConditionalBlock *ScannerConditionalBlockBuilder::parse(const std::string &filename) {
+    DirectiveList directives;
+    if (!scan(filename, directives)) {
+        Logging::error("Failed to parse: ", filename);
+        return nullptr;
+    }
+
+    _nodeNum = 0;
+    _current = new ScannerConditionalBlock(_file, nullptr, nullptr,
+                                           ScannerConditionalBlock::Kind::TOP, 0, "", 0, 0);
+    _condBlockStack.push(_current);
+    ConditionalBlock *top = _current;
+
+    bool ok = processFile(filename, directives, false);
+    if (ok && _condBlockStack.size() != 1) {
+        Logging::error("Failed to parse: ", filename, ": unterminated #if");
+        ok = false;
+    }
+    if (!ok) {
+        delete top;
+        return nullptr;
+    }
+    return top;
+}
+
+bool ScannerConditionalBlockBuilder::processFile(const std::string &filename,
+                                                 const DirectiveList &directives,
+                                                 bool included) {
+    // included files lose their include guard, like in PreFileIncluder
+    std::set<size_t> guard;
+    if (included && directives.size() >= 3 && directives[0].keyword == "ifndef"
+            && directives[0].onlyWhitespaceBefore && directives[1].keyword == "define"
+            && directives[1].onlyWhitespaceBefore) {
+        const std::string name = leading_identifier(directives[0].text);
+        int level = 1;
+        size_t endif = 1;
+        while (level > 0 && ++endif < directives.size()) {
+            const std::string &keyword = directives[endif].keyword;
+            if (keyword == "if" || keyword == "ifdef" || keyword == "ifndef")
+                level++;
+            else if (keyword == "endif")
+                level--;
+        }
+        if (!name.empty() && name == leading_identifier(directives[1].text)
+                && endif == directives.size() - 1 && directives.onlyWhitespaceAfter)
+            guard = {0, 1, endif};
+    }
+
+    for (size_t i = 0; i < directives.size(); i++)
+        if (guard.count(i) == 0 && !processDirective(filename, directives[i], included))
+            return false;
+    return true;
+}
+
+bool ScannerConditionalBlockBuilder::processDirective(const std::string &filename,
+                                                      const Directive &directive,
+                                                      bool included) {
+    typedef ScannerConditionalBlock::Kind Kind;
+    const std::string &keyword = directive.keyword;
+
+    if (keyword == "if" || keyword == "elif") {
+        std::string exp = trim(directive.text);
+        // the Puma normalizations are applied to the main file only
+        if (!included)
+            exp = normalize_defined_makros(exp);
+        exp = expandMacros(exp);
+        if (keyword == "if") {
+            openBlock(Kind::IF, directive, exp);
+            return true;
+        }
+        return nextBlock(Kind::ELIF, directive, exp);
+    } else if (keyword == "ifdef") {
+        openBlock(Kind::IFDEF, directive, leading_identifier(directive.text));
+    } else if (keyword == "ifndef") {
+        openBlock(Kind::IFNDEF, directive, leading_identifier(directive.text));
+    } else if (keyword == "else") {
+        return nextBlock(Kind::ELSE, directive, "");
+    } else if (keyword == "endif") {
+        if (_condBlockStack.size() <= 1) {
+            Logging::error("Failed to parse: ", filename, ":", directive.line,
+                           ": #endif without #if");
+            return false;
+        }
+        _condBlockStack.pop();
+        _current->_lineEnd = directive.line;
+        _current->_colEnd = directive.col;
+        _current = _condBlockStack.top();
+    } else if (keyword == "define") {
+        std::string::size_type end;
+        const std::string name = leading_identifier(directive.text, &end);
+        if (name.empty())
+            return true;
+        const std::string rest = directive.text.substr(end);
+        if (!rest.empty() && rest[0] == '(') {
+            defineFunction(name, rest);
+        } else if (!included && is_define_null(rest)) {
+            // #define CONFIG_FOO 0 -> #undef CONFIG_FOO
+            defineHelper(name, false);
+            _macros.erase(name);
+        } else {
+            defineHelper(name, true);
+        }
+    } else if (keyword == "undef") {
+        const std::string name = leading_identifier(directive.text);
+        if (!name.empty()) {
+            defineHelper(name, false);
+            _macros.erase(name);
+        }
+    } else if (keyword == "include") {
+        include(filename, directive.text);
+    }
+    return true;
+}
+
+void ScannerConditionalBlockBuilder::openBlock(ScannerConditionalBlock::Kind kind,
+                                               const Directive &directive,
+                                               std::string expression) {
+    ScannerConditionalBlock *parent = _condBlockStack.top();
+    _current = new ScannerConditionalBlock(_file, parent, nullptr, kind, _nodeNum++,
+                                           std::move(expression), directive.line, directive.col);
+    _condBlockStack.push(_current);
+    _file->push_back(_current);
+    parent->push_back(_current);
+}
+
+bool ScannerConditionalBlockBuilder::nextBlock(ScannerConditionalBlock::Kind kind,
+                                               const Directive &directive,
+                                               std::string expression) {
+    if (_condBlockStack.size() <= 1) {
+        Logging::error("Failed to parse: #", directive.keyword, " without #if in line ",
+                       directive.line);
+        return false;
+    }
+    ScannerConditionalBlock *prev = _condBlockStack.top();
+    _condBlockStack.pop();
+    ScannerConditionalBlock *parent = _condBlockStack.top();
+    _current->_lineEnd = directive.line;
+    _current->_colEnd = directive.col;
+    _current = new ScannerConditionalBlock(_file, parent, prev, kind, _nodeNum++,
+                                           std::move(expression), directive.line, directive.col);
+    _file->push_back(_current);
+    _condBlockStack.push(_current);
+    parent->push_back(_current);
+    return true;
+}
+
+void ScannerConditionalBlockBuilder::defineHelper(const std::string &name, bool define) {
+    /* Don't handle function macros */
+    if (_macros.find(name) != _macros.end())
+        return;
+
+    ScannerConditionalBlock &block = *_condBlockStack.top();
+
+    CppFile::DefineMap &map = *_file->getDefines();
+    auto i = map.find(name);
+
+    if (i == map.end())
+        // First define for this item
+        map[name] = new CppDefine(&block, define, name);
+    else
+        (*i).second->newDefine(&block, define);
+
+    block.addDefine(map[name]);
+}
+
+void ScannerConditionalBlockBuilder::defineFunction(const std::string &name,
+                                                    const std::string &rest) {
+    if (_current->getParent()) {
+        /* If an macro is defined in an block we can't expand them for
+           sure anymore */
+        _macros.erase(name);
+        return;
+    }
+    std::vector<std::string> params;
+    std::string::size_type end = split_arguments(rest, 0, params);
+    if (end == std::string::npos)
+        return;
+    Macro &macro = _macros[name];
+    macro.params.clear();
+    for (const std::string &param : params) {
+        const std::string p = trim(param);
+        if (!p.empty())
+            macro.params.push_back(p == "..." ? "__VA_ARGS__" : p);
+    }
+    macro.body = trim(rest.substr(end));
+}
+
+void ScannerConditionalBlockBuilder::include(const std::string &filename,
+                                             const std::string &argument) {
+    const std::string arg = trim(argument);
+    if (arg.size() < 2 || (arg[0] != '"' && arg[0] != '<'))
+        return;
+    const std::string::size_type close = arg.find(arg[0] == '"' ? '"' : '>', 1);
+    if (close == std::string::npos)
+        return;
+    const std::string name = arg.substr(1, close - 1);
+
+    // "file" is searched in the directory of the including file first
+    std::list<std::string> candidates;
+    if (arg[0] == '"')
+        candidates.push_back(
+            (boost::filesystem::path(filename).parent_path() / name).string());
+    for (const std::string &path : _includePaths)
+        candidates.push_back((boost::filesystem::path(path) / name).string());
+
+    boost::system::error_code ec;
+    for (const std::string &candidate : candidates) {
+        if (!boost::filesystem::is_regular_file(candidate, ec)) {
+            _missing.push_back(candidate);
+            continue;
+        }
+        const std::string canonical = boost::filesystem::canonical(candidate, ec).string();
+        /* Paste the included file only, if we haven't it seen until then */
+        if (ec || !_already_seen.insert(canonical).second)
+            return;
+        _included.push_back(candidate);
+        DirectiveList directives;
+        if (scan(candidate, directives))
+            processFile(candidate, directives, true);
+        return;
+    }
+}
+
+std::string ScannerConditionalBlockBuilder::expandMacros(const std::string &exp,
+                                                         const std::set<std::string> &hidden) const {
+    std::string result;
+    std::string::size_type i = 0;
+    bool after_defined = false;  // the operand of defined is never expanded
+
+    while (i < exp.size()) {
+        const char c = exp[i];
+        if (c == '"' || c == '\'') {
+            const std::string::size_type end = skip_literal(exp, i);
+            result.append(exp, i, end - i);
+            i = end;
+            after_defined = false;
+            continue;
+        } else if (c >= '0' && c <= '9') {
+            // numbers like 0x10UL don't contain identifiers
+            while (i < exp.size() && (is_ident(exp[i]) || exp[i] == '.'))
+                result += exp[i++];
+            after_defined = false;
+            continue;
+        } else if (!is_ident_start(c)) {
+            if (!is_space(c) && c != '(')
+                after_defined = false;
+            result += exp[i++];
+            continue;
+        }
+
+        std::string::size_type end = i;
+        while (end < exp.size() && is_ident(exp[end]))
+            ++end;
+        const std::string name = exp.substr(i, end - i);
+        const bool operand = after_defined;
+        after_defined = (name == "defined");
+
+        auto macro = _macros.find(name);
+        std::string::size_type open = end;
+        while (open < exp.size() && is_space(exp[open]))
+            ++open;
+        std::vector<std::string> args;
+        std::string::size_type close = std::string::npos;
+        if (!operand && macro != _macros.end() && hidden.count(name) == 0
+                && open < exp.size() && exp[open] == '(')
+            close = split_arguments(exp, open, args);
+
+        const std::vector<std::string> &params = (macro != _macros.end())
+            ? macro->second.params : std::vector<std::string>();
+        if (close != std::string::npos && params.empty() && args.size() == 1
+                && trim(args[0]).empty())
+            args.clear();
+        if (close != std::string::npos && !params.empty() && params.back() == "__VA_ARGS__"
+                && args.size() > params.size()) {
+            for (size_t k = params.size(); k < args.size(); k++)
+                args[params.size() - 1] += "," + args[k];
+            args.resize(params.size());
+        }
+        if (close == std::string::npos || args.size() != params.size()) {
+            result += name;
+            i = end;
+            continue;
+        }
+
+        // substitute the parameters in the body, then rescan it
+        const std::string &body = macro->second.body;
+        std::string replaced;
+        bool paste = false;
+        for (std::string::size_type b = 0; b < body.size();) {
+            if (body.compare(b, 2, "##") == 0) {
+                // token pasting, surrounding whitespace is dropped
+                while (!replaced.empty() && is_space(replaced.back()))
+                    replaced.pop_back();
+                for (b += 2; b < body.size() && is_space(body[b]); ++b) {}
+                paste = true;
+                continue;
+            }
+            bool stringize = false;
+            std::string::size_type start = b;
+            if (body[b] == '#') {
+                for (++start; start < body.size() && is_space(body[start]); ++start) {}
+                stringize = true;
+            }
+            if (start < body.size() && is_ident_start(body[start])) {
+                std::string::size_type e = start;
+                while (e < body.size() && is_ident(body[e]))
+                    ++e;
+                const std::string ident = body.substr(start, e - start);
+                auto param = std::find(params.begin(), params.end(), ident);
+                if (param != params.end()) {
+                    const std::string &arg = args[param - params.begin()];
+                    // operands of ## aren't expanded before pasting
+                    const std::string::size_type next = body.find_first_not_of(" \t", e);
+                    const bool raw = paste
+                        || (next != std::string::npos && body.compare(next, 2, "##") == 0);
+                    if (stringize)
+                        replaced += "\"" + trim(arg) + "\"";
+                    else
+                        replaced += raw ? trim(arg) : expandMacros(arg, hidden);
+                    b = e;
+                    paste = false;
+                    continue;
+                } else if (!stringize) {
+                    replaced += ident;
+                    b = e;
+                    paste = false;
+                    continue;
+                }
+            }
+            if (!is_space(body[b]))
+                paste = false;
+            replaced += body[b++];
+        }
+        std::set<std::string> inner(hidden);
+        inner.insert(name);
+        result += expandMacros(replaced, inner);
+        i = close;
+    }
+    return result;
+}
+
+ConditionalBlock *ScannerConditionalBlockBuilder::createDummyElseBlock(ConditionalBlock *parent,
+                                                                       ConditionalBlock *prev) {
+    auto newBlock = new ScannerConditionalBlock(_file, parent, prev,
+                                                ScannerConditionalBlock::Kind::ELSE,
+                                                _nodeNum++, "", 0, 0);
+    newBlock->setDummyBlock();
+    return newBlock;
+}
@@ -0,0 +1,166 @@
+// -*- mode: c++ -*-
+/*
+ *   undertaker - analyze preprocessor blocks in code
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _SCANNER_CONDITIONAL_BLOCK_H
+#define _SCANNER_CONDITIONAL_BLOCK_H
+
+#include "ConditionalBlock.h"
+
+#include <list>
+#include <map>
+#include <set>
+#include <stack>
+#include <string>
+#include <vector>
+
+
+/************************************************************************/
+/* ScannerConditionalBlock                                              */
+/************************************************************************/
+
+class ScannerConditionalBlock : public ConditionalBlock {
+public:
+    enum class Kind { TOP, IF, IFDEF, IFNDEF, ELIF, ELSE };
+
+private:
+    unsigned long _number;
+    Kind _kind;
+    std::string _expression;
+    unsigned int _lineStart = 0, _colStart = 0, _lineEnd = 0, _colEnd = 0;
+    bool _isDummyBlock = false;
+
+public:
+    ScannerConditionalBlock(CppFile *file, ConditionalBlock *parent, ConditionalBlock *prev,
+                            Kind kind, const unsigned long nodeNum, std::string expression,
+                            unsigned int line, unsigned int col)
+            : ConditionalBlock(file, parent, prev), _number(nodeNum), _kind(kind),
+              _expression(std::move(expression)), _lineStart(line), _colStart(col) {
+        lateConstructor();
+    };
+
+    //! location related accessors
+    unsigned int lineStart()     const final override { return getParent() ? _lineStart : 0; };
+    unsigned int colStart()      const final override { return getParent() ? _colStart : 0; };
+    unsigned int lineEnd()       const final override { return getParent() ? _lineEnd : 0; };
+    unsigned int colEnd()        const final override { return getParent() ? _colEnd : 0; };
+    /// @}
+
+    //! \return original untouched expression
+    const char * ExpressionStr() const final override { return _expression.c_str(); }
+    bool isIfBlock()             const final override {
+        return _kind == Kind::TOP || _kind == Kind::IF || _kind == Kind::IFDEF
+            || _kind == Kind::IFNDEF;
+    }
+    bool isIfndefine()           const final override { return _kind == Kind::IFNDEF; }
+    bool isElseIfBlock()         const final override { return _kind == Kind::ELIF; }
+    bool isElseBlock()           const final override { return _kind == Kind::ELSE; }
+    bool isDummyBlock()          const final override { return _isDummyBlock; }
+    void setDummyBlock()               final override { _isDummyBlock = true; }
+    const std::string getName()  const final override;
+
+    friend class ScannerConditionalBlockBuilder;
+    friend class CppFileCache;
+};
+
+
+/************************************************************************/
+/* ScannerConditionalBlockBuilder                                       */
+/************************************************************************/
+
+/**
+ * \brief builds the blocks of a file from its preprocessor directives only
+ *
+ * Instead of lexing the whole translation unit with Puma, the file is
+ * mapped into memory and only the directive lines are extracted, taking
+ * line continuations, comments, string and character literals into
+ * account. The block tree, block names, expressions and defines are the
+ * same as the ones of the PumaConditionalBlockBuilder, including its
+ * normalizations, the expansion of function-like macros defined on the
+ * top level and the resolution of #include directives. Source output of
+ * the coverage analysis needs the Puma tokens and isn't supported.
+ */
+class ScannerConditionalBlockBuilder : public ConditionalBlockBuilder {
+public:
+    //! a preprocessor directive of a file
+    struct Directive {
+        std::string keyword;  //!< e.g. "ifdef", empty for the null directive
+        std::string text;     //!< the rest of the line, comments and continuations removed
+        unsigned int line, col;
+        //! true if only whitespace and comments precede the directive since the last one
+        bool onlyWhitespaceBefore;
+    };
+    //! the directives of a file, in order
+    struct DirectiveList : public std::vector<Directive> {
+        //! true if only whitespace and comments follow the last directive
+        bool onlyWhitespaceAfter = true;
+    };
+
+private:
+    //! a function-like macro defined on the top level
+    struct Macro {
+        std::vector<std::string> params;
+        std::string body;
+    };
+
+    unsigned long _nodeNum = 0;
+    // Stack of open conditional blocks. Pushed to when entering #ifdef
+    // (and similar) blocks, popped from when leaving them.
+    std::stack<ScannerConditionalBlock *> _condBlockStack;
+    ScannerConditionalBlock *_current = nullptr;
+    ConditionalBlock *_top = nullptr;
+    CppFile *_file = nullptr;
+    std::map<std::string, Macro> _macros;
+    std::set<std::string> _already_seen;
+
+    static std::list<std::string> _includePaths;
+
+    ConditionalBlock *parse(const std::string &filename);
+    bool processFile(const std::string &filename, const DirectiveList &directives,
+                     bool normalize);
+    bool processDirective(const std::string &filename, const Directive &directive,
+                          bool normalize);
+    void openBlock(ScannerConditionalBlock::Kind, const Directive &, std::string expression);
+    bool nextBlock(ScannerConditionalBlock::Kind, const Directive &, std::string expression);
+    void defineHelper(const std::string &name, bool define);
+    void defineFunction(const std::string &name, const std::string &rest);
+    void include(const std::string &filename, const std::string &argument);
+    std::string expandMacros(const std::string &exp,
+                             const std::set<std::string> &hidden = {}) const;
+
+public:
+    ScannerConditionalBlockBuilder(CppFile *file, const std::string &filename) : _file(file) {
+        _top = parse(filename);
+    }
+
+    ConditionalBlock *topBlock() final override { return _top; }
+    ConditionalBlock *createDummyElseBlock(ConditionalBlock *parent,
+                                           ConditionalBlock *prev) final override;
+
+    /**
+     * \brief extracts the preprocessor directives of a file
+     *
+     * \param directives filled with the directives in the order of the file
+     * \return false if the file couldn't be read
+     */
+    static bool scan(const std::string &filename, DirectiveList &directives);
+
+    static void addIncludePath(const char *);
+    static const std::list<std::string> &getIncludePaths() { return _includePaths; }
+};
+#endif
@@ -17,16 +17,24 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#include "BoolExpSymbolSet.h"
+#include "BoolExpParser.h"
 #include "Tools.h"
 
 #include <algorithm>
+#include <atomic>
+#include <boost/filesystem.hpp>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <unistd.h>
 
 std::set<std::string> undertaker::itemsOfString(const std::string &str) {
-    kconfig::BoolExp *e = kconfig::BoolExp::parseString(str);
-    kconfig::BoolExpSymbolSet symset(e);
-    delete e;
-    return symset.getSymbolSet();
+    std::set<std::string> items;
+    // no need to build the expression
+    kconfig::BoolExpParser parser(str);
+    if (!parser.parseItems(items))
+        items.clear();
+    return items;
 }
 
 bool undertaker::ends_with(const std::string &val, const std::string &end) {
@@ -40,3 +48,52 @@ bool undertaker::starts_with(const std::string &val, const std::string &start) {
         return false;
     return std::equal(start.begin(), start.end(), val.begin());
 }
+
+uint64_t undertaker::fnv1a(const std::string &text) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (const unsigned char c : text) {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+std::string undertaker::fileHash(const std::string &filename) {
+    std::ifstream in(filename, std::ios::binary);
+    if (!in.good())
+        return "";
+    std::stringstream content;
+    content << in.rdbuf();
+    const std::string text = content.str();
+    return std::to_string(fnv1a(text)) + " " + std::to_string(text.size());
+}
+
+std::string undertaker::cacheFilename(const std::string &directory, const std::string &key) {
+    char hex[17];
+    snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(fnv1a(key)));
+    return directory + "/" + std::string(hex, 2) + "/" + std::string(hex + 2);
+}
+
+bool undertaker::writeFileAtomically(const std::string &filename, const std::string &content) {
+    static std::atomic<unsigned int> written(0);
+    boost::system::error_code error;
+    boost::filesystem::create_directories(boost::filesystem::path(filename).parent_path(), error);
+
+    const std::string tmpname =
+        filename + "." + std::to_string(getpid()) + "." + std::to_string(written++);
+    {
+        std::ofstream out(tmpname);
+        out << content;
+        if (!out.good()) {
+            out.close();
+            std::remove(tmpname.c_str());
+            return false;
+        }
+    }
+    boost::filesystem::rename(tmpname, filename, error);
+    if (error) {
+        std::remove(tmpname.c_str());
+        return false;
+    }
+    return true;
+}
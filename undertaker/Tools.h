@@ -21,6 +21,7 @@
 #ifndef _UNDERTAKER_TOOLS_H_
 #define _UNDERTAKER_TOOLS_H_
 
+#include <cstdint>
 #include <string>
 #include <set>
 
@@ -31,5 +32,13 @@ namespace undertaker {
     //! returns true if 'val' ends with the substring 'end'
     bool ends_with(const std::string &val, const std::string &end);
     bool starts_with(const std::string &val, const std::string &start);
+    //! 64 bit FNV-1a hash of the given text
+    uint64_t fnv1a(const std::string &text);
+    //! hash and size of the content of the file, empty if it can't be read
+    std::string fileHash(const std::string &filename);
+    //! path below the given directory of a cache entry, which is keyed by the given text
+    std::string cacheFilename(const std::string &directory, const std::string &key);
+    //! writes the file such that other processes never see it partly written
+    bool writeFileAtomically(const std::string &filename, const std::string &content);
 } // namespace undertaker
 #endif
@@ -0,0 +1,148 @@
+/*
+ *   boolean framework for undertaker and satyr - throughput of the expression parsers
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "bool.h"
+#include "BoolExpParser.h"
+#include "BoolExpSymbolSet.h"
+#include "BoolExpLegacyLexer.h"
+#include "Tools.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+
+// BoolExp::parseString() as it was with the flex/bison parser
+static kconfig::BoolExp *legacyParseString(const std::string &s) {
+    kconfig::BoolExp *result;
+    std::stringstream ins(s);
+    kconfig::BoolExpLegacyLexer lexer(&ins, nullptr);
+
+    kconfig::BoolExpLegacyParser parser(&result, &lexer);
+    try {
+        if (parser.parse() == 0)
+            return result;
+    } catch (std::runtime_error &) {
+        return nullptr;
+    }
+    return nullptr;
+}
+
+// undertaker::itemsOfString() as it was with the flex/bison parser
+static std::set<std::string> legacyItemsOfString(const std::string &str) {
+    kconfig::BoolExp *e = legacyParseString(str);
+    kconfig::BoolExpSymbolSet symset(e);
+    if (e)
+        e->release();
+    return symset.getSymbolSet();
+}
+
+/*
+ * The formulas of model files, i.e., the quoted part of each line. Other
+ * files are read line by line.
+ */
+static void readFormulas(const std::string &filename, std::vector<std::string> &formulas) {
+    std::ifstream in(filename);
+    if (!in.good())
+        throw std::runtime_error("couldn't open " + filename);
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.compare(0, 15, "UNDERTAKER_SET ") == 0)
+            continue;
+        std::string::size_type first = line.find('"'), last = line.rfind('"');
+        if (first != std::string::npos && last > first)
+            formulas.push_back(line.substr(first + 1, last - first - 1));
+        else if (filename.size() < 6 || filename.compare(filename.size() - 6, 6, ".model") != 0)
+            formulas.push_back(line);
+    }
+}
+
+static void bench(const char *name, const std::function<size_t(const std::string &)> &parse,
+                  const std::vector<std::string> &formulas, int rounds) {
+    unsigned long results = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round < rounds; round++)
+        for (const std::string &formula : formulas)
+            results += parse(formula);
+    const double seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+
+    std::cout << name << ": " << formulas.size() * rounds << " formulas, " << results
+              << " results in " << seconds << " s ("
+              << formulas.size() * rounds / seconds << " formulas/s)" << std::endl;
+}
+
+int main(int argc, char **argv) {
+    int rounds = 1, opt;
+    while ((opt = getopt(argc, argv, "r:")) != -1) {
+        if (opt == 'r') {
+            rounds = std::max(1, std::stoi(optarg));
+        } else {
+            std::cerr << "usage: " << argv[0] << " [-r rounds] file..." << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    std::vector<std::string> formulas;
+    for (int i = optind; i < argc; i++)
+        readFormulas(argv[i], formulas);
+
+    // both parsers have to agree, otherwise the numbers aren't comparable
+    unsigned long differences = 0;
+    for (const std::string &formula : formulas) {
+        kconfig::BoolExp *current = kconfig::BoolExp::parseString(formula);
+        kconfig::BoolExp *legacy = legacyParseString(formula);
+        if ((current ? current->str() : "") != (legacy ? legacy->str() : "")
+                || undertaker::itemsOfString(formula) != legacyItemsOfString(formula)) {
+            std::cerr << "parsers disagree on: " << formula << std::endl;
+            differences++;
+        }
+        if (current)
+            current->release();
+        if (legacy)
+            legacy->release();
+    }
+
+    auto release = [](kconfig::BoolExp *e) -> size_t {
+        if (!e)
+            return 0;
+        e->release();
+        return 1;
+    };
+    bench("parseString   flex/bison", [&](const std::string &s) {
+        return release(legacyParseString(s));
+    }, formulas, rounds);
+    bench("parseString   BoolExpParser", [&](const std::string &s) {
+        return release(kconfig::BoolExp::parseString(s));
+    }, formulas, rounds);
+    bench("itemsOfString flex/bison", [](const std::string &s) {
+        return legacyItemsOfString(s).size();
+    }, formulas, rounds);
+    bench("itemsOfString BoolExpParser", [](const std::string &s) {
+        return undertaker::itemsOfString(s).size();
+    }, formulas, rounds);
+    return differences == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
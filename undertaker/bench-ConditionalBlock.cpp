@@ -0,0 +1,73 @@
+/*
+ *   undertaker - parse throughput of the Puma parser and the directive scanner
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ConditionalBlock.h"
+#include "Logging.h"
+
+#include <boost/filesystem.hpp>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+
+static void bench(const char *name, CppFile::Parser parser,
+                  const std::vector<std::string> &files, int rounds, uintmax_t bytes) {
+    CppFile::setParser(parser);
+    unsigned long blocks = 0, failed = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round < rounds; round++) {
+        for (const std::string &filename : files) {
+            CppFile file(filename);
+            if (file.good())
+                blocks += file.size();
+            else
+                failed++;
+        }
+    }
+    const double seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+
+    std::cout << name << ": " << files.size() * rounds << " files, " << blocks << " blocks, "
+              << failed << " failed in " << seconds << " s ("
+              << files.size() * rounds / seconds << " files/s, "
+              << bytes * rounds / seconds / (1024 * 1024) << " MiB/s)" << std::endl;
+}
+
+int main(int argc, char **argv) {
+    int rounds = 1, opt;
+    while ((opt = getopt(argc, argv, "r:")) != -1) {
+        if (opt == 'r') {
+            rounds = std::max(1, std::stoi(optarg));
+        } else {
+            std::cerr << "usage: " << argv[0] << " [-r rounds] file..." << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+    Logging::setLogLevel(Logging::LOG_ERROR);
+
+    std::vector<std::string> files(argv + optind, argv + argc);
+    uintmax_t bytes = 0;
+    for (const std::string &filename : files)
+        bytes += boost::filesystem::file_size(filename);
+
+    bench("puma   ", CppFile::Parser::PUMA, files, rounds, bytes);
+    bench("scanner", CppFile::Parser::SCANNER, files, rounds, bytes);
+    return EXIT_SUCCESS;
+}
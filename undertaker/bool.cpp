@@ -20,206 +20,112 @@
  */
 
 #include "bool.h"
-#include "exceptions/BoolExpParserException.h"
-#include "BoolExpGC.h"
 #include "BoolExpSimplifier.h"
 #include "BoolExpStringBuilder.h"
-#include "BoolExpLexer.h"
+#include "BoolExpParser.h"
 
 #include <typeinfo> // for typeid()
-#include <sstream>
+#include <typeindex>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <unordered_set>
+#include <vector>
 
 
 /************************************************************************/
-/* accept Methods for BoolExp and subclasses. Needed by BoolExpVisitor  */
+/* accept and dispatch methods, and the traversal of BoolVisitor        */
 /************************************************************************/
 
 void kconfig::BoolExp::accept(kconfig::BoolVisitor *visitor) {
-    void *l = nullptr, *r = nullptr;
-    if (this->left) {
-        if (visitor->isVisited(left)) {
-            l = visitor->visited[left];
-        } else {
-            this->left->accept(visitor);
-            l = visitor->result;
+    visitor->traverse(this);
+}
+
+void kconfig::BoolVisitor::traverse(BoolExp *e) {
+    // a node is expanded when it is on top of the stack for the first time,
+    // and visited when it comes back to the top after its operands
+    struct Frame {
+        BoolExp *node;
+        bool expanded;
+    };
+    std::vector<Frame> stack{{e, false}};
+
+    while (!stack.empty()) {
+        BoolExp *node = stack.back().node;
+        if (node->id >= visits.size())
+            visits.resize(node->id + 1);
+        if (visits[node->id].epoch == epoch) {
+            // reached on another path in the meantime
+            stack.pop_back();
+            continue;
         }
-    }
-    if (this->right) {
-        if (visitor->isVisited(right)) {
-            r = visitor->visited[right];
-        } else {
-            this->right->accept(visitor);
-            r = visitor->result;
+        if (!stack.back().expanded) {
+            stack.back().expanded = true;
+            // pushed in reverse, so the left operand is visited first
+            // only function calls have parameters, and they are not hash-consed
+            BoolExpCall *call = node->interned ? nullptr : dynamic_cast<BoolExpCall *>(node);
+            if (call) {
+                for (auto it = call->param->rbegin(); it != call->param->rend(); ++it)
+                    stack.push_back({*it, false});
+            }
+            if (node->right)
+                stack.push_back({node->right, false});
+            if (node->left)
+                stack.push_back({node->left, false});
+            continue;
         }
+        stack.pop_back();
+        this->left = node->left ? resultOf(node->left) : nullptr;
+        this->right = node->right ? resultOf(node->right) : nullptr;
+        this->result = nullptr;
+        node->dispatch(this);
+        visits[node->id].result = this->result;
+        visits[node->id].epoch = epoch;
     }
-    visitor->left = l;
-    visitor->right = r;
-    visitor->result = nullptr;
+    this->result = resultOf(e);
+}
+
+void kconfig::BoolExp::dispatch(kconfig::BoolVisitor *visitor) {
     visitor->visit(this);
-    visitor->visited[this] = visitor->result;
 }
 
-void kconfig::BoolExpAny::accept(kconfig::BoolVisitor *visitor) {
-    void *l = nullptr, *r = nullptr;
-    if (this->left) {
-        if (visitor->isVisited(left)) {
-            l = visitor->visited[left];
-        } else {
-            this->left->accept(visitor);
-            l = visitor->result;
-        }
-    }
-    if (this->right) {
-        if (visitor->isVisited(right)) {
-            r = visitor->visited[right];
-        } else {
-            this->right->accept(visitor);
-            r = visitor->result;
-        }
-    }
-    visitor->left = l;
-    visitor->right = r;
-    visitor->result = nullptr;
+void kconfig::BoolExpAny::dispatch(kconfig::BoolVisitor *visitor) {
     visitor->visit(this);
-    visitor->visited[this] = visitor->result;
 }
 
-void kconfig::BoolExpAnd::accept(kconfig::BoolVisitor *visitor) {
-    void *l = nullptr, *r = nullptr;
-    if (this->left) {
-        if (visitor->isVisited(left)) {
-            l = visitor->visited[left];
-        } else {
-            this->left->accept(visitor);
-            l = visitor->result;
-        }
-    }
-    if (this->right) {
-        if (visitor->isVisited(right)) {
-            r = visitor->visited[right];
-        } else {
-            this->right->accept(visitor);
-            r = visitor->result;
-        }
-    }
-    visitor->left = l;
-    visitor->right = r;
-    visitor->result = nullptr;
+void kconfig::BoolExpAnd::dispatch(kconfig::BoolVisitor *visitor) {
     visitor->visit(this);
-    visitor->visited[this] = visitor->result;
 }
 
-void kconfig::BoolExpOr::accept(kconfig::BoolVisitor *visitor) {
-    void *l = nullptr, *r = nullptr;
-    if (this->left) {
-        if (visitor->isVisited(left)) {
-            l = visitor->visited[left];
-        } else {
-            this->left->accept(visitor);
-            l = visitor->result;
-        }
-    }
-    if (this->right) {
-        if (visitor->isVisited(right)) {
-            r = visitor->visited[right];
-        } else {
-            this->right->accept(visitor);
-            r = visitor->result;
-        }
-    }
-    visitor->left = l;
-    visitor->right = r;
-    visitor->result = nullptr;
+void kconfig::BoolExpOr::dispatch(kconfig::BoolVisitor *visitor) {
     visitor->visit(this);
-    visitor->visited[this] = visitor->result;
 }
 
-void kconfig::BoolExpImpl::accept(kconfig::BoolVisitor *visitor) {
-    void *l = nullptr, *r = nullptr;
-    if (this->left) {
-        if (visitor->isVisited(left)) {
-            l = visitor->visited[left];
-        } else {
-            this->left->accept(visitor);
-            l = visitor->result;
-        }
-    }
-    if (this->right) {
-        if (visitor->isVisited(right)) {
-            r = visitor->visited[right];
-        } else {
-            this->right->accept(visitor);
-            r = visitor->result;
-        }
-    }
-    visitor->left = l;
-    visitor->right = r;
-    visitor->result = nullptr;
+void kconfig::BoolExpImpl::dispatch(kconfig::BoolVisitor *visitor) {
     visitor->visit(this);
-    visitor->visited[this] = visitor->result;
 }
 
-void kconfig::BoolExpEq::accept(kconfig::BoolVisitor *visitor) {
-    void *l = nullptr, *r = nullptr;
-    if (this->left) {
-        if (visitor->isVisited(left)) {
-            l = visitor->visited[left];
-        } else {
-            this->left->accept(visitor);
-            l = visitor->result;
-        }
-    }
-    if (this->right) {
-        if (visitor->isVisited(right)) {
-            r = visitor->visited[right];
-        } else {
-            this->right->accept(visitor);
-            r = visitor->result;
-        }
-    }
-    visitor->left = l;
-    visitor->right = r;
-    visitor->result = nullptr;
+void kconfig::BoolExpEq::dispatch(kconfig::BoolVisitor *visitor) {
     visitor->visit(this);
-    visitor->visited[this] = visitor->result;
 }
 
-void kconfig::BoolExpNot::accept(kconfig::BoolVisitor *visitor) {
-    void *r = nullptr;
-    if (this->right) {
-        if (visitor->isVisited(right)) {
-            r = visitor->visited[right];
-        } else {
-            this->right->accept(visitor);
-            r = visitor->result;
-        }
-    }
-    visitor->left = nullptr;
-    visitor->right = r;
-    visitor->result = nullptr;
+void kconfig::BoolExpNot::dispatch(kconfig::BoolVisitor *visitor) {
     visitor->visit(this);
-    visitor->visited[this] = visitor->result;
 }
 
-void kconfig::BoolExpConst::accept(kconfig::BoolVisitor *visitor) {
-    visitor->result = nullptr;
+void kconfig::BoolExpConst::dispatch(kconfig::BoolVisitor *visitor) {
     visitor->visit(this);
-    visitor->visited[this] = visitor->result;
 }
 
 kconfig::BoolExpConst *kconfig::BoolExpConst::getInstance(bool val) {
-    return new kconfig::BoolExpConst(val);
+    return static_cast<BoolExpConst *>(intern(new BoolExpConst(val)));
 }
 
-void kconfig::BoolExpVar::accept(kconfig::BoolVisitor *visitor) {
-    visitor->result = nullptr;
+void kconfig::BoolExpVar::dispatch(kconfig::BoolVisitor *visitor) {
     visitor->visit(this);
-    visitor->visited[this] = visitor->result;
 }
 
-void kconfig::BoolExpCall::accept(kconfig::BoolVisitor *visitor) {
-    for (const auto &bool_exp : *this->param)  // BoolExp *
-        bool_exp->accept(visitor);
+void kconfig::BoolExpCall::dispatch(kconfig::BoolVisitor *visitor) {
     visitor->visit(this);
 }
 
@@ -238,7 +144,7 @@ bool kconfig::BoolExp::equals(const BoolExp *other) const {
 
 bool kconfig::BoolExpCall::equals(const BoolExp *other) const {
     const BoolExpCall *otherc = dynamic_cast<const BoolExpCall *>(other);
-    if (otherc == nullptr || this->name != otherc->name
+    if (otherc == nullptr || !this->sameName(otherc)
         || this->param->size() != otherc->param->size()) {
         return false;
     }
@@ -253,7 +159,7 @@ bool kconfig::BoolExpCall::equals(const BoolExp *other) const {
 
 bool kconfig::BoolExpVar::equals(const BoolExp *other) const {
     const BoolExpVar *otherv = dynamic_cast<const BoolExpVar *>(other);
-    return otherv != nullptr && this->name == otherv->name;
+    return otherv != nullptr && this->sameName(otherv);
 }
 
 bool kconfig::BoolExpConst::equals(const BoolExp *other) const {
@@ -263,7 +169,7 @@ bool kconfig::BoolExpConst::equals(const BoolExp *other) const {
 
 bool kconfig::BoolExpAny::equals(const BoolExp *other) const {
     const BoolExpAny *otherc = dynamic_cast<const BoolExpAny *>(other);
-    return otherc != nullptr && this->name == otherc->name
+    return otherc != nullptr && this->sameName(otherc)
            && ((this->left == otherc->left || this->left->equals(otherc->left))
                && (this->right == otherc->right || this->right->equals(otherc->right)));
 }
@@ -272,28 +178,266 @@ bool kconfig::BoolExpAny::equals(const BoolExp *other) const {
 /* BoolExp baseclass methods                                            */
 /************************************************************************/
 
-kconfig::BoolExp::~BoolExp() {
-    if (!gcMarked) {
-        BoolExpGC gc;
-        gc.trash(this);
-        gc.sweep(this);
+namespace {
+    using kconfig::BoolExp;
+
+    // the operator, operands and name that identify a node
+    struct NodeKey {
+        std::type_index type;
+        const BoolExp *left, *right;
+        const std::string *name;
+        const void *sym = nullptr;
+        int value = -1;
+
+        explicit NodeKey(const BoolExp *e)
+                : type(typeid(*e)), left(e->left), right(e->right), name(&e->getName()) {
+            if (const auto *var = dynamic_cast<const kconfig::BoolExpVar *>(e))
+                sym = var->sym;
+            if (const auto *constant = dynamic_cast<const kconfig::BoolExpConst *>(e))
+                value = constant->value;
+        }
+
+        bool operator==(const NodeKey &other) const {
+            return type == other.type && left == other.left && right == other.right
+                   && sym == other.sym && value == other.value && name == other.name;
+        }
+    };
+
+    // the table only stores the nodes, their keys are computed on demand
+    struct NodeHash {
+        size_t operator()(const BoolExp *e) const {
+            NodeKey key(e);
+            size_t hash = key.type.hash_code();
+            for (size_t part : {std::hash<const void *>()(key.left),
+                                std::hash<const void *>()(key.right),
+                                std::hash<const void *>()(key.name),
+                                std::hash<const void *>()(key.sym),
+                                std::hash<int>()(key.value)})
+                hash = hash * 31 + part;
+            return hash;
+        }
+    };
+
+    struct NodeEqual {
+        bool operator()(const BoolExp *a, const BoolExp *b) const {
+            return NodeKey(a) == NodeKey(b);
+        }
+    };
+
+    // the unique table of all hash-consed nodes, which are shared between threads
+    std::mutex nodes_mutex;
+    std::unordered_set<BoolExp *, NodeHash, NodeEqual> nodes;
+    // the ids of freed nodes, guarded by nodes_mutex like next_id
+    std::vector<unsigned> free_ids;
+    unsigned next_id = 0;
+
+    unsigned newId() {
+        if (free_ids.empty())
+            return next_id++;
+        unsigned id = free_ids.back();
+        free_ids.pop_back();
+        return id;
+    }
+
+    // the names of all nodes; they are never freed, as there are only as many as symbols
+    std::mutex names_mutex;
+    const std::string no_name;
+
+    std::unordered_set<std::string> &names() {
+        static auto *names = new std::unordered_set<std::string>;
+        return *names;
+    }
+
+    /*
+     * Hands out chunks of the node sizes from large blocks. Freed chunks are
+     * kept in a list per size and reused. The pool is never destroyed, so
+     * nodes may still be released during the destruction of static objects.
+     */
+    class NodePool {
+        static const size_t block_size = 1 << 16;
+        static const size_t max_size = 128;
+        // nodes contain nothing but pointers and integers
+        static const size_t alignment = alignof(void *);
+
+        struct Chunk { Chunk *next; };
+
+        std::mutex mutex;
+        Chunk *free_chunks[max_size / alignment + 1] = {};
+        char *block = nullptr, *block_end = nullptr;
+
+        static size_t chunkSize(size_t size) { return (size + alignment - 1) / alignment; }
+
+    public:
+        void *allocate(size_t size) {
+            if (size > max_size)
+                return ::operator new(size);
+            size_t n = chunkSize(size);
+            std::lock_guard<std::mutex> lock(mutex);
+            if (Chunk *chunk = free_chunks[n]) {
+                free_chunks[n] = chunk->next;
+                return chunk;
+            }
+            if (block == nullptr || block_end - block < (ptrdiff_t) (n * alignment)) {
+                block = static_cast<char *>(::operator new(block_size));
+                block_end = block + block_size;
+            }
+            void *chunk = block;
+            block += n * alignment;
+            return chunk;
+        }
+
+        void deallocate(void *p, size_t size) {
+            if (size > max_size) {
+                ::operator delete(p);
+                return;
+            }
+            size_t n = chunkSize(size);
+            Chunk *chunk = static_cast<Chunk *>(p);
+            std::lock_guard<std::mutex> lock(mutex);
+            chunk->next = free_chunks[n];
+            free_chunks[n] = chunk;
+        }
+    };
+
+    NodePool &pool() {
+        static auto *pool = new NodePool;
+        return *pool;
     }
+} // namespace
+
+// vptr, refs and id, name, left and right
+static_assert(sizeof(void *) != 8 || sizeof(kconfig::BoolExp) == 40,
+              "a plain node is meant to take 40 bytes");
+
+void *kconfig::BoolExp::operator new(size_t size) {
+    return pool().allocate(size);
 }
 
-kconfig::BoolExp *kconfig::BoolExp::parseString(std::string s) {
-    BoolExp *result;
-    std::stringstream ins(s);
-    BoolExpLexer lexer(&ins, nullptr);
-
-    BoolExpParser parser(&result, &lexer);
-    try {
-        if (parser.parse() == 0) {
-            return result;
+void kconfig::BoolExp::operator delete(void *p, size_t size) {
+    pool().deallocate(p, size);
+}
+
+void kconfig::BoolExp::setName(const std::string &name) {
+    std::lock_guard<std::mutex> lock(names_mutex);
+    this->name = &*names().insert(name).first;
+}
+
+const std::string &kconfig::BoolExp::getName() const {
+    return name ? *name : no_name;
+}
+
+kconfig::BoolExp *kconfig::BoolExp::intern(BoolExp *e) {
+    BoolExp *node = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(nodes_mutex);
+        auto it = nodes.find(e);
+        if (it != nodes.end()) {
+            // a node whose last reference is being dropped must not come back, it is
+            // replaced by e and left to the thread that frees it
+            unsigned refs = (*it)->refs.load();
+            while (refs > 0 && !(*it)->refs.compare_exchange_weak(refs, refs + 1)) {}
+            if (refs > 0)
+                node = *it;
+            else
+                nodes.erase(it);
+        }
+        if (!node) {
+            e->refs = 1;
+            e->interned = true;
+            e->id = newId();
+            nodes.insert(e);
+            return e;
+        }
+    }
+    // the existing node has its own references to the operands
+    if (e->left)
+        e->left->release();
+    if (e->right)
+        e->right->release();
+    delete e;
+    return node;
+}
+
+kconfig::BoolExp *kconfig::BoolExp::own(BoolExp *e) {
+    e->refs++;
+    std::lock_guard<std::mutex> lock(nodes_mutex);
+    e->id = newId();
+    return e;
+}
+
+kconfig::BoolExp *kconfig::BoolExp::retain() {
+    refs++;
+    return this;
+}
+
+void kconfig::BoolExp::release() {
+    if (refs.fetch_sub(1) > 1)
+        return;
+    // iteratively, as long chains of && would overflow the stack
+    std::vector<BoolExp *> garbage{this};
+    auto drop = [&garbage](BoolExp *operand) {
+        if (operand && operand->refs.fetch_sub(1) == 1)
+            garbage.push_back(operand);
+    };
+    while (!garbage.empty()) {
+        BoolExp *e = garbage.back();
+        garbage.pop_back();
+        {
+            std::lock_guard<std::mutex> lock(nodes_mutex);
+            if (e->interned) {
+                // intern() may have replaced the node already
+                auto it = nodes.find(e);
+                if (it != nodes.end() && *it == e)
+                    nodes.erase(it);
+            }
+            free_ids.push_back(e->id);
         }
-    } catch (BoolExpParserException *e) {
-        return nullptr;
+        drop(e->left);
+        drop(e->right);
+        // only function calls have parameters, and they are not hash-consed
+        if (BoolExpCall *call = e->interned ? nullptr : dynamic_cast<BoolExpCall *>(e))
+            for (BoolExp *param : *call->param)
+                drop(param);
+        delete e;
     }
-    return nullptr;
+}
+
+kconfig::BoolExpAnd *kconfig::BoolExpAnd::make(BoolExp *el, BoolExp *er) {
+    return static_cast<BoolExpAnd *>(intern(new BoolExpAnd(el, er)));
+}
+
+kconfig::BoolExpOr *kconfig::BoolExpOr::make(BoolExp *el, BoolExp *er) {
+    return static_cast<BoolExpOr *>(intern(new BoolExpOr(el, er)));
+}
+
+kconfig::BoolExpImpl *kconfig::BoolExpImpl::make(BoolExp *el, BoolExp *er) {
+    return static_cast<BoolExpImpl *>(intern(new BoolExpImpl(el, er)));
+}
+
+kconfig::BoolExpEq *kconfig::BoolExpEq::make(BoolExp *el, BoolExp *er) {
+    return static_cast<BoolExpEq *>(intern(new BoolExpEq(el, er)));
+}
+
+kconfig::BoolExpNot *kconfig::BoolExpNot::make(BoolExp *e) {
+    return static_cast<BoolExpNot *>(intern(new BoolExpNot(e)));
+}
+
+kconfig::BoolExpVar *kconfig::BoolExpVar::make(std::string name, bool addPrefix) {
+    return static_cast<BoolExpVar *>(intern(new BoolExpVar(name, addPrefix)));
+}
+
+kconfig::BoolExpAny *kconfig::BoolExpAny::make(std::string name, BoolExp *el, BoolExp *er) {
+    return static_cast<BoolExpAny *>(own(new BoolExpAny(name, el, er)));
+}
+
+kconfig::BoolExpCall *kconfig::BoolExpCall::make(std::string name,
+                                                 std::list<BoolExp *> *param) {
+    return static_cast<BoolExpCall *>(own(new BoolExpCall(name, param)));
+}
+
+kconfig::BoolExp *kconfig::BoolExp::parseString(std::string s) {
+    BoolExpParser parser(s);
+    return parser.parse();
 }
 
 std::string kconfig::BoolExp::str(void) {
@@ -325,12 +469,12 @@ kconfig::BoolExp &kconfig::operator&&(kconfig::BoolExp &l, kconfig::BoolExp &r)
         BoolExpConst &c = left ? *left : *right;
         BoolExp &var = left ? r : l;
         if (c.value == true) {
-            return var;
+            return *var.retain();
         } else {
-            return c;  // false
+            return *c.retain();  // false
         }
     }
-    return *B_AND(&l, &r);
+    return *B_AND(l.retain(), r.retain());
 }
 
 kconfig::BoolExp &kconfig::operator||(kconfig::BoolExp &l, kconfig::BoolExp &r) {
@@ -341,12 +485,12 @@ kconfig::BoolExp &kconfig::operator||(kconfig::BoolExp &l, kconfig::BoolExp &r)
         BoolExpConst &c = left ? *left : *right;
         BoolExp &var = left ? r : l;
         if (c.value == false) {
-            return var;
+            return *var.retain();
         } else {
-            return c;  // true
+            return *c.retain();  // true
         }
     }
-    return *B_OR(&l, &r);
+    return *B_OR(l.retain(), r.retain());
 }
 
 kconfig::BoolExp &kconfig::operator!(kconfig::BoolExp & l) {
@@ -356,5 +500,5 @@ kconfig::BoolExp &kconfig::operator!(kconfig::BoolExp & l) {
         bool newval = !(lConst->value);
         return *B_CONST(newval);
     }
-    return *B_NOT(&l);
+    return *B_NOT(l.retain());
 }
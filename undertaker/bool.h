@@ -26,15 +26,16 @@
 
 #include "SymbolTools.h"
 
+#include <atomic>
 #include <string>
 #include <list>
 #include <ostream>
 
-#define B_AND new kconfig::BoolExpAnd
-#define B_OR new kconfig::BoolExpOr
-#define B_NOT new kconfig::BoolExpNot
-#define B_IMPL new kconfig::BoolExpImpl
-#define B_VAR new kconfig::BoolExpVar
+#define B_AND kconfig::BoolExpAnd::make
+#define B_OR kconfig::BoolExpOr::make
+#define B_NOT kconfig::BoolExpNot::make
+#define B_IMPL kconfig::BoolExpImpl::make
+#define B_VAR kconfig::BoolExpVar::make
 #define B_CONST(v) (kconfig::BoolExpConst::getInstance(v))
 
 
@@ -49,26 +50,78 @@ namespace kconfig {
 /* BoolExp                                                              */
 /************************************************************************/
 
+    /**
+     * \brief node of a boolean expression
+     *
+     * Expressions are hash-consed: the make() functions of the subclasses
+     * return the existing node if the same operator has already been applied
+     * to the same operands. Hence, identical subexpressions are a single node
+     * and an expression is a DAG rather than a tree. Only function calls and
+     * C operators (BoolExpCall, BoolExpAny) are created anew each time, as
+     * each of them stands for an unknown value.
+     *
+     * Nodes are reference counted. make() takes over the references to the
+     * operands that are passed to it and returns a new reference to the node.
+     * Every reference has to be dropped with release(). The count is
+     * atomic, the unique table is only locked to add a node and to remove
+     * it when its last reference is dropped.
+     *
+     * As translating a Kconfig model creates millions of nodes, they are
+     * kept small: names are interned, so nodes refer to a shared string, and
+     * the nodes are carved out of large blocks instead of being allocated one
+     * by one. Freed nodes are reused for new ones. The ids of the nodes are
+     * dense, too, so visitors can keep their results in a plain vector.
+     */
     class BoolExp {
+        friend class BoolVisitor;
+
+        std::atomic<unsigned> refs{0};
+        //! unique among the live nodes, the ids of freed nodes are reused
+        unsigned id : 31;
+        //! shares the word with the id, so that a node stays at 40 bytes
+        unsigned interned : 1;
+        //! interned, nullptr for nodes without a name
+        const std::string *name = nullptr;
+
     protected:
-        std::string name;
+        BoolExp() : id(0), interned(false) {}
+        virtual ~BoolExp() {}
+        //! \return the unique node that equals e, takes over the reference to e
+        static BoolExp *intern(BoolExp *e);
+        //! \return e with a new reference, for nodes that are not hash-consed
+        static BoolExp *own(BoolExp *e);
+        void setName(const std::string &name);
+
     public:
-        bool gcMarked = false;
         BoolExp *left = nullptr;
         BoolExp *right = nullptr;
-        int CNFVar = 0;
 
-        BoolExp() = default;
-        virtual ~BoolExp();
+        BoolExp(const BoolExp &) = delete;
+        BoolExp &operator=(const BoolExp &) = delete;
+
+        static void *operator new(size_t size);
+        static void operator delete(void *p, size_t size);
+
+        //! \return a new reference to this expression
+        BoolExp *retain();
+        //! drops a reference, the expression is freed with the last one
+        void release();
+
         std::string str(void);
-        const std::string &getName(void) const { return this->name; }
+        const std::string &getName(void) const;
+        //! \return true if both expressions have the same name, faster than comparing getName()
+        bool sameName(const BoolExp *other) const { return name == other->name; }
         //! Apply obvious simplifications (if possible)
         BoolExp *simplify();
 
         virtual int getEvaluationPriority(void) const { return -1; }
         virtual bool equals(const BoolExp *other) const;
-        virtual void accept(BoolVisitor *visitor);
+        //! visits the subexpressions and this expression, each node once, see BoolVisitor
+        void accept(BoolVisitor *visitor);
+        //! calls the visit() method of the visitor that matches the type of this node
+        virtual void dispatch(BoolVisitor *visitor);
 
+        //! \return a new reference to the parsed expression, nullptr on syntax errors
         static BoolExp *parseString(std::string);
     };
 
@@ -77,13 +130,15 @@ namespace kconfig {
 /************************************************************************/
 
     class BoolExpAnd : public BoolExp {
-    public:
         BoolExpAnd(BoolExp *el, BoolExp *er) {
             right = er;
             left = el;
         }
 
-        void accept(BoolVisitor *visitor) final override;
+    public:
+        static BoolExpAnd *make(BoolExp *el, BoolExp *er);
+
+        void dispatch(BoolVisitor *visitor) final override;
         int getEvaluationPriority(void) const final override { return 50; }
     };
 
@@ -92,13 +147,15 @@ namespace kconfig {
 /************************************************************************/
 
     class BoolExpOr : public BoolExp {
-    public:
         BoolExpOr(BoolExp *el, BoolExp *er) {
             right = er;
             left = el;
         }
 
-        void accept(BoolVisitor *visitor) final override;
+    public:
+        static BoolExpOr *make(BoolExp *el, BoolExp *er);
+
+        void dispatch(BoolVisitor *visitor) final override;
         int getEvaluationPriority(void) const final override { return 30; }
     };
 
@@ -107,14 +164,16 @@ namespace kconfig {
 /************************************************************************/
 
     class BoolExpAny : public BoolExp {
-    public:
         BoolExpAny(std::string name, BoolExp *el, BoolExp *er) {
             right = er;
             left = el;
-            this->name = name;
+            setName(name);
         }
 
-        void accept(BoolVisitor *visitor) final override;
+    public:
+        static BoolExpAny *make(std::string name, BoolExp *el, BoolExp *er);
+
+        void dispatch(BoolVisitor *visitor) final override;
         int getEvaluationPriority(void) const final override { return 60; }
         bool equals(const BoolExp *other) const final override;
     };
@@ -124,13 +183,15 @@ namespace kconfig {
 /************************************************************************/
 
     class BoolExpImpl : public BoolExp {
-    public:
         BoolExpImpl(BoolExp *el, BoolExp *er) {
             right = er;
             left = el;
         }
 
-        void accept(BoolVisitor *visitor) final override;
+    public:
+        static BoolExpImpl *make(BoolExp *el, BoolExp *er);
+
+        void dispatch(BoolVisitor *visitor) final override;
         int getEvaluationPriority(void) const final override { return 20; }
     };
 
@@ -139,13 +200,15 @@ namespace kconfig {
 /************************************************************************/
 
     class BoolExpEq : public BoolExp {
-    public:
         BoolExpEq(BoolExp *el, BoolExp *er) {
             right = er;
             left = el;
         }
 
-        void accept(BoolVisitor *visitor) final override;
+    public:
+        static BoolExpEq *make(BoolExp *el, BoolExp *er);
+
+        void dispatch(BoolVisitor *visitor) final override;
         int getEvaluationPriority(void) const final override { return 10; }
     };
 
@@ -154,14 +217,18 @@ namespace kconfig {
 /************************************************************************/
 
     class BoolExpCall : public BoolExp {
-    public:
-        std::list<BoolExp *> *param;
         BoolExpCall(std::string name, std::list<BoolExp *> *param) {
-            this->name = name;
+            setName(name);
             this->param = param;
         }
+        ~BoolExpCall() { delete param; }
+
+    public:
+        std::list<BoolExp *> *param;
+        //! takes over the list and the references to its expressions
+        static BoolExpCall *make(std::string name, std::list<BoolExp *> *param);
 
-        void accept(BoolVisitor *visitor) final override;
+        void dispatch(BoolVisitor *visitor) final override;
         int getEvaluationPriority(void) const final override { return 90; }
         bool equals(const BoolExp *other) const final override;
     };
@@ -171,10 +238,12 @@ namespace kconfig {
 /************************************************************************/
 
     class BoolExpNot : public BoolExp {
-    public:
         explicit BoolExpNot(BoolExp *e) { right = e; }
 
-        void accept(BoolVisitor *visitor) final override;
+    public:
+        static BoolExpNot *make(BoolExp *e);
+
+        void dispatch(BoolVisitor *visitor) final override;
         int getEvaluationPriority(void) const final override { return 70; }
     };
 
@@ -188,10 +257,11 @@ namespace kconfig {
     public:
         bool value;
 
-        void accept(BoolVisitor *visitor) final override;
+        void dispatch(BoolVisitor *visitor) final override;
         int getEvaluationPriority(void) const final override { return 90; }
         bool equals(const BoolExp *other) const final override;
 
+        //! \return a new reference to the constant
         static BoolExpConst *getInstance(bool val);
     };
 
@@ -200,22 +270,28 @@ namespace kconfig {
 /************************************************************************/
 
     class BoolExpVar : public BoolExp {
-    public:
-        TristateRelation rel;
-        struct symbol *sym = nullptr;
-
         explicit BoolExpVar(std::string name, bool addPrefix = true) {
             this->rel = rel_helper;
-            this->name = addPrefix ? "CONFIG_" + name : name;
+            setName(addPrefix ? "CONFIG_" + name : name);
         }
 
         BoolExpVar(struct symbol *sym, TristateRelation rel) : rel(rel), sym(sym) {
             nameSymbol(sym);
             std::string name(sym->name ? sym->name : "[unnamed_menu]");
-            this->name = "CONFIG_" + name + TristateRelationNames[rel];
+            setName("CONFIG_" + name + TristateRelationNames[rel]);
+        }
+
+    public:
+        TristateRelation rel;
+        struct symbol *sym = nullptr;
+
+        static BoolExpVar *make(std::string name, bool addPrefix = true);
+        // inline, as only satyr links the symbol tools
+        static BoolExpVar *make(struct symbol *sym, TristateRelation rel) {
+            return static_cast<BoolExpVar *>(intern(new BoolExpVar(sym, rel)));
         }
 
-        void accept(BoolVisitor *visitor) final override;
+        void dispatch(BoolVisitor *visitor) final override;
         int getEvaluationPriority(void) const final override { return 90; }
         bool equals(const BoolExp *other) const final override;
     };
@@ -226,6 +302,7 @@ namespace kconfig {
 
     std::ostream &operator<<(std::ostream &s, BoolExp &exp);
 
+    // the operators return a new reference, but don't take over the references to their operands
     BoolExp &operator&&(BoolExp &l, BoolExp &r);
     BoolExp &operator||(BoolExp &l, BoolExp &r);
     BoolExp &operator!(BoolExp & l);
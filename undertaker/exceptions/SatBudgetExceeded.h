@@ -1,8 +1,7 @@
+// -*- mode: c++ -*-
 /*
  *   boolean framework for undertaker and satyr
  *
- * Copyright (C) 2012 Ralf Hackner <rh@ralf-hackner.de>
- *
  * This program is free software; you can redistribute it and/or
  * modify it under the terms of the GNU General Public License
  * as published by the Free Software Foundation; either version 2
@@ -18,12 +17,14 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
  */
 
-#ifndef KCONFIG_BOOL_EXP_PARSER_EXCEPTION_H
-#define KCONFIG_BOOL_EXP_PARSER_EXCEPTION_H
+#ifndef SAT_BUDGET_EXCEEDED_H
+#define SAT_BUDGET_EXCEEDED_H
 
 #include <stdexcept>
 
-struct BoolExpParserException : public std::runtime_error {
-    explicit BoolExpParserException(std::string s) : runtime_error(s) {}
+
+//! a check ran out of its budget, its outcome is unknown
+struct SatBudgetExceeded : public std::runtime_error {
+    explicit SatBudgetExceeded(std::string s) : runtime_error(s) {}
 };
 #endif
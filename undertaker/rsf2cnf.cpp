@@ -26,21 +26,30 @@
 #include "KconfigWhitelist.h"
 #include "Logging.h"
 #include "bool.h"
+#include "cpp14.h"
 
+#include <boost/filesystem.hpp>
 #include <boost/regex.hpp>
+#include <list>
+#include <memory>
 
 using namespace kconfig;
 
 
 static void usage(void){
-    std::cerr << "rsf2cnf [-v] [-q] -m <model> [-W <file>] [-B <file>] [-r <rsf>] [-c <cnf>]" << std::endl;
+    std::cerr << "rsf2cnf [-v] [-q] [-k] [-p] -m <model> [-W <file>] [-B <file>] [-r <rsf>] [-c <cnf>]" << std::endl;
+    std::cerr << "rsf2cnf [-v] [-q] [-k] [-p] -a <cnf> [-a <cnf> ...]" << std::endl;
     std::cerr << "  -v           increase verbosity" << std::endl;
     std::cerr << "  -q           decrease verbosity" << std::endl;
+    std::cerr << "  -k           find the items that are fixed by the model and store them in the cnf" << std::endl;
+    std::cerr << "  -p           simplify the cnf before writing it" << std::endl;
     std::cerr << "  -m <model>   file with inferences from golem, or a version 1.0 model file generated by rsf2model" << std::endl;
     std::cerr << "  -r <rsf>     (optional) original *.rsf file generated by dumpconf" << std::endl;
     std::cerr << "  -c <cnf>     (optional) merges constraints from given .cnf file" << std::endl;
     std::cerr << "  -W <file>    (optional) file with a whitelist of options that are always enabled" << std::endl;
     std::cerr << "  -B <file>    (optional) file with a blacklist of options that are always disabled" << std::endl;
+    std::cerr << "  -a <cnf>     merges the given .cnf models of several architectures into one model," << std::endl;
+    std::cerr << "               the basename of each file is taken as architecture name" << std::endl;
     exit(1);
 }
 
@@ -80,7 +89,7 @@ static void addClauses(kconfig::CNFBuilder &builder, RsfReader &model) {
                 BoolExp *exp = BoolExp::parseString(clause);
                 if (exp) {
                     builder.pushClause(exp);
-                    delete exp;
+                    exp->release();
                 } else {
                     Logging::error("failed to parse '", clause, "'");
                 }
@@ -107,7 +116,7 @@ static void addAlwaysOnOff(kconfig::CNFBuilder &builder, RsfReader &model) {
         for (const std::string &clause : *model.getMetaValue(magic_on)) {
             BoolExp *exp = BoolExp::parseString(clause);
             builder.pushClause(exp);
-            delete exp;
+            exp->release();
             builder.cnf->addMetaValue(magic_on, clause);
         }
     }
@@ -116,7 +125,7 @@ static void addAlwaysOnOff(kconfig::CNFBuilder &builder, RsfReader &model) {
             std::string clause = "! " + str;
             BoolExp *exp = BoolExp::parseString(clause);
             builder.pushClause(exp);
-            delete exp;
+            exp->release();
             builder.cnf->addMetaValue(magic_off, str);
         }
     }
@@ -127,10 +136,13 @@ int main(int argc, char **argv) {
     std::string model_file;
     std::string rsf_file;
     std::string cnf_file;
+    std::list<std::string> arch_files;
+    bool backbone = false;
+    bool simplify = false;
 
     int loglevel = Logging::getLogLevel();
 
-    while ((opt = getopt(argc, argv, "m:r:c:W:B:vh")) != -1) {
+    while ((opt = getopt(argc, argv, "m:r:c:a:W:B:kpvh")) != -1) {
         switch (opt) {
             int n;
         case 'm':
@@ -142,6 +154,15 @@ int main(int argc, char **argv) {
         case 'c':
             cnf_file = optarg;
             break;
+        case 'a':
+            arch_files.push_back(optarg);
+            break;
+        case 'k':
+            backbone = true;
+            break;
+        case 'p':
+            simplify = true;
+            break;
         case 'q':
             loglevel = loglevel + 10;
             Logging::setLogLevel(loglevel);
@@ -176,6 +197,29 @@ int main(int argc, char **argv) {
             break;
         }
     }
+    if (!arch_files.empty()) {
+        std::list<std::unique_ptr<PicosatCNF>> arch_cnfs;
+        std::map<std::string, const PicosatCNF *> archs;
+        for (const std::string &file : arch_files) {
+            arch_cnfs.emplace_back(make_unique<PicosatCNF>());
+            arch_cnfs.back()->readFromFile(file);
+            std::string arch = boost::filesystem::path(file).stem().string();
+            if (!archs.emplace(arch, arch_cnfs.back().get()).second) {
+                Logging::error("architecture ", arch, " was given more than once");
+                exit(1);
+            }
+        }
+        PicosatCNF cnf;
+        cnf.mergeArchitectures(archs);
+        Logging::info("merged ", archs.size(), " architectures into ", cnf.getVarCount(),
+                      " variables and ", cnf.getClauseCount(), " clauses");
+        if (backbone && !cnf.computeBackbone())
+            Logging::warn("The cnf model is unsatisfiable, it has no backbone.");
+        if (simplify)
+            cnf.simplify();
+        cnf.toStream(std::cout);
+        return 0;
+    }
     if (model_file == "")
         usage();
 
@@ -195,5 +239,9 @@ int main(int argc, char **argv) {
     std::string magic_inc("CONFIGURATION_SPACE_INCOMPLETE");
     if (model.getMetaValue(magic_inc))
         cnf.addMetaValue(magic_inc, "True");
+    if (backbone && !cnf.computeBackbone())
+        Logging::warn("The cnf model is unsatisfiable, it has no backbone.");
+    if (simplify)
+        cnf.simplify();
     cnf.toStream(std::cout);
 }
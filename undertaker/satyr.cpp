@@ -38,11 +38,13 @@ using namespace kconfig;
 
 
 void usage(std::ostream &out) {
-    out << "usage: satyr [-V] [-a <assumtion.config> | -c <out.cnf>] <model>" << std::endl;
+    out << "usage: satyr [-V] [-p] [-a <assumtion.config> | -c <out.cnf>] <model>" << std::endl;
     out << "       model:          a Kconfig file / translated cnf file" << std::endl;
     out << "       -a <assumtion>  a .config file to be validated" << std::endl;
     out << "                       (may be incomplete)" << std::endl;
     out << "       -c <out.cnf>   translates model to cnf and saves it to out.cnf" << std::endl;
+    out << "                      (in the binary format, if out.cnf ends with .cnfb)" << std::endl;
+    out << "       -p              simplify the cnf model before using it" << std::endl;
     out << "       -V  print version information\n";
     exit(EXIT_FAILURE);
 }
@@ -75,6 +77,7 @@ int process_assumptions(PicosatCNF &cnf, const std::vector<boost::filesystem::pa
 
 int main(int argc, char **argv) {
     bool saveTranslatedModel = false;
+    bool simplify = false;
     std::vector<boost::filesystem::path> assumptions;
     boost::filesystem::path saveFile;
     int exitstatus = 0;
@@ -82,7 +85,7 @@ int main(int argc, char **argv) {
 
     int loglevel = Logging::getLogLevel();
 
-    while ((opt = getopt(argc, argv, "Vvc:a:")) != -1) {
+    while ((opt = getopt(argc, argv, "Vvpc:a:")) != -1) {
         switch (opt) {
         case 'c':
             saveTranslatedModel = true;
@@ -91,6 +94,9 @@ int main(int argc, char **argv) {
         case 'a':
             assumptions.push_back(optarg);
             break;
+        case 'p':
+            simplify = true;
+            break;
         case 'v':
             loglevel = loglevel - 10;
             if (loglevel < 0)
@@ -130,7 +136,7 @@ int main(int argc, char **argv) {
 
     PicosatCNF cnf;
 
-    if (filepath.extension() == ".cnf") {
+    if (filepath.extension() == ".cnf" || filepath.extension() == ".cnfb") {
         Logging::info("Loading CNF model ", filepath);
         cnf.readFromFile(filepath.string());
     } else {
@@ -153,6 +159,8 @@ int main(int argc, char **argv) {
         }
         Logging::info("features in model: ", symbolSet.size());
     }
+    if (simplify)
+        cnf.simplify();
     if (saveTranslatedModel) {
         cnf.toFile(saveFile.string());
         Logging::info(cnf.getVarCount(), " variables written to ", saveFile);
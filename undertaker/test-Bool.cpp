@@ -19,7 +19,11 @@
  */
 
 #include "bool.h"
+#include "BoolExpParser.h"
+#include <atomic>
 #include <iostream>
+#include <thread>
+#include <vector>
 #include <check.h>
 
 using namespace kconfig;
@@ -27,7 +31,8 @@ using namespace kconfig;
 void parse_test(std::string input, bool good) {
     BoolExp *e = BoolExp::parseString(input);
     fail_unless(good == (e!=0), input.c_str());
-    delete e;
+    if (e)
+        e->release();
 }
 
 //from test-SatChecker
@@ -79,6 +84,19 @@ START_TEST(parseFunc) {
     parse_test("B00 && ( B0 <-> ON. && A > 23 ) && ( B1 <-> ! ON. || 12 + (24 & 12) ) && (B00 -> ON.) && (!B00 -> (ON <-> ON.)) && B00 && ( B00 <-> FILE_comparator.c )", true);
 } END_TEST;
 
+START_TEST(parseItems) {
+    std::string input("A && !foo(B, 0x10) || (C.x -> A) && bar(, 'c')");
+    std::set<std::string> items;
+    BoolExpParser parser(input);
+
+    fail_unless(parser.parseItems(items));
+    fail_unless(items == std::set<std::string>({"A", "B", "C.x"}));
+
+    input = "A && (B || C";
+    BoolExpParser broken(input);
+    fail_if(broken.parseItems(items));
+} END_TEST;
+
 void parse_test_reference(const char *expression, const char *reference, const char *comment) {
     BoolExp *e = BoolExp::parseString(expression);
 
@@ -92,7 +110,7 @@ void parse_test_reference(const char *expression, const char *reference, const c
     fail_if (e->str() != reference,
              "Failed to parse\n\t'%s'\nexpected:\n\t'%s'\ngot:\n\t'%s'  %s",
              expression, reference, e->str().c_str(), comment);
-    delete e;
+    e->release();
 }
 
 START_TEST(parseBool) {
@@ -119,16 +137,17 @@ START_TEST(parseBool) {
 } END_TEST;
 
 START_TEST(notATree) {
-    BoolExp *x = new BoolExpVar("X",false);
-    BoolExp *n0 = new BoolExpNot(x);
-    BoolExp *n1 = new BoolExpNot(n0);
-    BoolExp *o = new BoolExpOr(n0,n1);
+    BoolExp *x = B_VAR("X",false);
+    BoolExp *n0 = B_NOT(x);
+    BoolExp *n1 = B_NOT(n0->retain());
+    BoolExp *o = B_OR(n0,n1);
     BoolExp *p = o->simplify();
     std::string s = o->str();
     std::string t = p->str();
     fail_unless(s == "!X || !!X", "should be %s but is %s","!X || !!X", s.c_str());
     fail_unless(t == "1", "should be %s but is %s","1", t.c_str());
-    delete o;
+    o->release();
+    p->release();
 } END_TEST;
 
 void simplify_test(std::string input, std::string expected) {
@@ -137,8 +156,8 @@ void simplify_test(std::string input, std::string expected) {
     fail_unless(s->str() == expected,
                 "\"%s\" results \"%s\" instead of \"%s\"",
                 e->str().c_str(),s->str().c_str(), expected.c_str());
-    delete e;
-    delete s;
+    e->release();
+    s->release();
 }
 
 START_TEST(simplify) {
@@ -168,8 +187,8 @@ void equals_test(std::string a, std::string b="") {
     fail_unless(e->equals(f) == ( e->str() == f->str() ),
                 "equals() missbehaves on \"%s\" and \"%s\"",
                 e->str().c_str(), f->str().c_str() );
-    delete e;
-    delete f;
+    e->release();
+    f->release();
 }
 
 START_TEST(equal) {
@@ -192,6 +211,45 @@ START_TEST(equal) {
     equals_test("A + B");
 } END_TEST;
 
+START_TEST(hashConsing) {
+    BoolExp *e = BoolExp::parseString("(A && !B) || (C -> A && !B)");
+    BoolExp *f = BoolExp::parseString("C -> A && !B");
+    // identical subexpressions are the same node
+    fail_unless(e->left == e->right->right);
+    fail_unless(e->right == f);
+    // function calls and C operators stand for unknown values of their own
+    BoolExp *g = BoolExp::parseString("foo(A) && foo(A) && A + B && A + B");
+    fail_if(g->left->left->left == g->left->left->right);
+    fail_if(g->left->right == g->right);
+    e->release();
+    // f keeps its subexpressions alive
+    BoolExp *h = BoolExp::parseString("A && !B");
+    fail_unless(h == f->right);
+    fail_unless(h->str() == "A && !B");
+    f->release();
+    g->release();
+    h->release();
+} END_TEST;
+
+START_TEST(hashConsingThreads) {
+    // the threads drop and create the same nodes at the same time
+    std::atomic<int> wrong(0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++)
+        threads.emplace_back([&wrong]() {
+            for (int i = 0; i < 5000; i++) {
+                BoolExp *e = BoolExp::parseString("(A && !B) || (C -> A && !B)");
+                BoolExp *f = B_AND(B_VAR("A", false), B_NOT(B_VAR("B", false)));
+                if (e->left != f || e->right->right != f)
+                    wrong++;
+                e->release();
+                f->release();
+            }
+        });
+    for (std::thread &thread : threads)
+        thread.join();
+    fail_unless(wrong == 0);
+} END_TEST;
 
 Suite *cond_block_suite(void) {
     Suite *s  = suite_create("Suite test-Bool");
@@ -199,9 +257,12 @@ Suite *cond_block_suite(void) {
     tcase_add_test(tc, parseBool);
     tcase_add_test(tc, bool_parser_test);
     tcase_add_test(tc, parseFunc);
+    tcase_add_test(tc, parseItems);
     tcase_add_test(tc, notATree);
     tcase_add_test(tc, equal);
     tcase_add_test(tc, simplify);
+    tcase_add_test(tc, hashConsing);
+    tcase_add_test(tc, hashConsingThreads);
     suite_add_tcase(s, tc);
     return s;
 }
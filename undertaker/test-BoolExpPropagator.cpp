@@ -0,0 +1,78 @@
+#include "bool.h"
+#include "BoolExpPropagator.h"
+#include <check.h>
+
+using namespace kconfig;
+
+static bool propagates(const char *expression, const std::map<std::string, bool> &values,
+                       CNFBuilder::ConstantPolicy policy = CNFBuilder::ConstantPolicy::BOUND) {
+    BoolExp *e = BoolExp::parseString(expression);
+    ck_assert(e != nullptr);
+    BoolExpPropagator propagator(policy);
+    for (const auto &entry : values)  // pair<string, bool>
+        propagator.assign(entry.first, entry.second);
+    bool consistent = propagator.propagate(e);
+    e->release();
+    return consistent;
+}
+
+START_TEST(evaluate) {
+    fail_if(propagates("A && B", {{"B", false}}));
+    fail_if(!propagates("A || B", {{"B", false}}));
+    fail_if(propagates("A -> B", {{"A", true}, {"B", false}}));
+    fail_if(propagates("(A <-> B) && A", {{"B", false}}));
+    fail_if(!propagates("A && foo(B)", {{"B", false}}));
+    fail_if(!propagates("A || B", {}));
+} END_TEST;
+
+START_TEST(forcedValues) {
+    // B1 needs CONFIG_BROKEN_FOO, which the model never selects
+    fail_if(propagates("B1 && (B1 <-> CONFIG_BROKEN_FOO && B0) && B0",
+                       {{"CONFIG_BROKEN_FOO", false}}));
+    // the nested block B2 only finds out through its parent
+    fail_if(propagates("B2 && (B2 <-> CONFIG_A && B1) && (B1 <-> CONFIG_BROKEN_FOO && B0)",
+                       {{"CONFIG_BROKEN_FOO", false}}));
+    fail_if(propagates("B1 && (B1 <-> !CONFIG_X86) && (B1 -> CONFIG_A)",
+                       {{"CONFIG_A", false}}));
+    fail_if(!propagates("B1 && (B1 <-> CONFIG_A || CONFIG_B)", {{"CONFIG_A", false}}));
+} END_TEST;
+
+START_TEST(freeConstants) {
+    fail_if(propagates("B1 && (B1 <-> 0)", {}));
+    fail_if(!propagates("B1 && (B1 <-> 0)", {}, CNFBuilder::ConstantPolicy::FREE));
+    fail_if(propagates("B1 && (B1 <-> 0 || A)", {{"A", false}}));
+    fail_if(!propagates("B1 && (B1 <-> 0 || A)", {{"A", false}},
+                        CNFBuilder::ConstantPolicy::FREE));
+} END_TEST;
+
+START_TEST(deepChain) {
+    // far deeper than a recursive traversal could go on the stack
+    BoolExp *e = B_VAR("X0", false);
+    for (int i = 1; i < 200000; i++)
+        e = B_AND(e, B_VAR("X" + std::to_string(i % 100), false));
+    BoolExpPropagator propagator;
+    propagator.assign("X99", false);
+    fail_if(propagator.propagate(e));
+    e->release();
+} END_TEST;
+
+
+Suite *cond_block_suite(void) {
+    Suite *s  = suite_create("Suite");
+    TCase *tc = tcase_create("BoolExpPropagator");
+    tcase_add_test(tc, evaluate);
+    tcase_add_test(tc, forcedValues);
+    tcase_add_test(tc, freeConstants);
+    tcase_add_test(tc, deepChain);
+    suite_add_tcase(s, tc);
+    return s;
+}
+
+int main() {
+    Suite *s = cond_block_suite();
+    SRunner *sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    int number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -40,12 +40,24 @@ START_TEST(symtableWithCall) {
     fail_if(!e || s0.size() != 3);
 } END_TEST;
 
+START_TEST(symtableDeepChain) {
+    // far deeper than a recursive traversal could go on the stack
+    BoolExp *e = B_VAR("X0", false);
+    for (int i = 1; i < 200000; i++)
+        e = B_AND(e, B_VAR("X" + std::to_string(i % 100), false));
+    BoolExpSymbolSet t0(e);
+
+    fail_if(t0.getSymbolSet().size() != 100);
+    e->release();
+} END_TEST;
+
 
 Suite *cond_block_suite(void) {
     Suite *s  = suite_create("Suite");
     TCase *tc = tcase_create("Bool");
     tcase_add_test(tc, symtable);
     tcase_add_test(tc, symtableWithCall);
+    tcase_add_test(tc, symtableDeepChain);
     suite_add_tcase(s, tc);
     return s;
 }
@@ -20,6 +20,7 @@
 
 #include "bool.h"
 #include "CNFBuilder.h"
+#include "KconfigWhitelist.h"
 #include "PicosatCNF.h"
 #include "exceptions/CNFBuilderError.h"
 
@@ -328,6 +329,40 @@ START_TEST(buildImplNull) {
     build_and_evaluate_strategy("A && (A <-> 0)", true, false);
 } END_TEST;
 
+START_TEST(buildNestedNull) {
+    // #if 0 nested in another #if 0, each 0 is a free variable of its own
+    const char *formulas[] = {
+        "( B1 && ! B2 ) && ( B1 <-> 0 ) && ( B2 <-> B1 && 0 )",
+        "( B1 && ! B2 ) && ( B1 <-> ! 0 ) && ( B2 <-> ! 0 )",
+    };
+    for (const char *formula : formulas) {
+        build_and_evaluate_strategy(formula, true, false);
+        PicosatCNF cnf;
+        CNFBuilder(&cnf, formula, false, CNFBuilder::ConstantPolicy::FREE, 0,
+                   CNFBuilder::Encoding::POLARITY);
+        fail_unless(cnf.checkSatisfiable(), "%s is unsatisfiable (strategy: FREE)", formula);
+    }
+} END_TEST;
+
+START_TEST(buildNestedIgnored) {
+    // #ifdef CONFIG_MMU nested in #ifndef CONFIG_MMU, each occurrence of an
+    // ignored item is a free variable of its own
+    const char *formula = "( B1 && B2 ) && ( B1 <-> ! CONFIG_MMU ) && ( B2 <-> B1 && CONFIG_MMU )";
+    KconfigWhitelist::getIgnorelist().emplace_back("CONFIG_MMU");
+    for (CNFBuilder::Encoding encoding : {CNFBuilder::Encoding::EQUIVALENCE,
+                                          CNFBuilder::Encoding::POLARITY}) {
+        PicosatCNF cnf;
+        CNFBuilder(&cnf, formula, true, CNFBuilder::ConstantPolicy::FREE, 0, encoding);
+        fail_unless(cnf.checkSatisfiable(), "%s is unsatisfiable with CONFIG_MMU ignored",
+                    formula);
+    }
+    KconfigWhitelist::getIgnorelist().clear();
+
+    PicosatCNF cnf;
+    CNFBuilder(&cnf, formula, true, CNFBuilder::ConstantPolicy::FREE);
+    fail_if(cnf.checkSatisfiable(), "%s is satisfiable, should not be", formula);
+} END_TEST;
+
 START_TEST(literals) {
     build_and_evaluate_strategy("0l", true, false);
 
@@ -336,6 +371,106 @@ START_TEST(literals) {
 //  build_and_evaluate_strategy("0x0ull", true, false);
 } END_TEST;
 
+START_TEST(buildCNFPolarity) {
+    const char *formulas[] = {
+        "(A -> (B && C)) && (!(A || D) -> !C)",
+        "(A <-> (B || !C)) && !(B && D)",
+        "!(A -> B) || (C && !(D || A))",
+        "(A || B) && (!(A || B) || (C -> D)) && !(C && (A <-> D))",
+    };
+    for (const char *formula : formulas) {
+        PicosatCNF full, polarity;
+        CNFBuilder(&full, formula, false, CNFBuilder::ConstantPolicy::BOUND, 0,
+                   CNFBuilder::Encoding::EQUIVALENCE);
+        CNFBuilder(&polarity, formula, false, CNFBuilder::ConstantPolicy::BOUND, 0,
+                   CNFBuilder::Encoding::POLARITY);
+        fail_unless(polarity.getClauseCount() < full.getClauseCount(),
+                    "%s: no clauses saved", formula);
+        // both encodings agree on all assignments of the named variables
+        for (int i = 0; i < 16; i++) {
+            for (PicosatCNF *cnf : {&full, &polarity}) {
+                cnf->pushAssumption("A", i & 1);
+                cnf->pushAssumption("B", i & 2);
+                cnf->pushAssumption("C", i & 4);
+                cnf->pushAssumption("D", i & 8);
+            }
+            ck_assert_int_eq(full.checkSatisfiable(), polarity.checkSatisfiable());
+        }
+    }
+    // a subexpression that is pushed again with the other polarity gets the missing clauses
+    BoolExp *shared = BoolExp::parseString("A && B");
+    BoolExp *first = B_IMPL(BoolExp::parseString("C"), shared);
+    BoolExp *second = B_IMPL(shared->retain(), BoolExp::parseString("D"));
+    PicosatCNF cnf;
+    CNFBuilder builder(&cnf, "", false, CNFBuilder::ConstantPolicy::BOUND, 0,
+                       CNFBuilder::Encoding::POLARITY);
+    builder.pushClause(first);
+    builder.pushClause(second);
+    cnf.pushAssumption("A", true);
+    cnf.pushAssumption("B", true);
+    cnf.pushAssumption("D", false);
+    fail_if(cnf.checkSatisfiable());
+    first->release();
+    second->release();
+} END_TEST;
+
+START_TEST(buildCNFChains) {
+    PicosatCNF cnf;
+    // the operands of a pushed conjunction are pushed without helper variables
+    CNFBuilder(&cnf, "A && B && C && (D || E || F)", false,
+               CNFBuilder::ConstantPolicy::BOUND, 0, CNFBuilder::Encoding::POLARITY);
+    ck_assert_int_eq(cnf.getVarCount(), 6);
+    ck_assert_int_eq(cnf.getClauseCount(), 4);
+
+    // a nested chain gets a single helper variable
+    PicosatCNF nested;
+    CNFBuilder(&nested, "G -> (A && B && C && D)", false,
+               CNFBuilder::ConstantPolicy::BOUND, 0, CNFBuilder::Encoding::POLARITY);
+    ck_assert_int_eq(nested.getVarCount(), 7);
+    ck_assert_int_eq(nested.getClauseCount(), 6);
+    nested.pushAssumption("G", true);
+    nested.pushAssumption("C", false);
+    fail_if(nested.checkSatisfiable());
+
+    // a shared subexpression ends the chain
+    BoolExp *shared = BoolExp::parseString("A || B");
+    BoolExp *e = B_AND(B_OR(shared, BoolExp::parseString("C")),
+                       B_IMPL(BoolExp::parseString("D"), shared->retain()));
+    PicosatCNF sharedcnf;
+    CNFBuilder builder(&sharedcnf, "", false, CNFBuilder::ConstantPolicy::BOUND, 0,
+                       CNFBuilder::Encoding::POLARITY);
+    builder.pushClause(e);
+    sharedcnf.pushAssumption("A", false);
+    sharedcnf.pushAssumption("B", false);
+    sharedcnf.pushAssumption("D", true);
+    fail_if(sharedcnf.checkSatisfiable());
+    sharedcnf.pushAssumption("A", false);
+    sharedcnf.pushAssumption("B", false);
+    sharedcnf.pushAssumption("C", true);
+    fail_unless(sharedcnf.checkSatisfiable());
+    e->release();
+} END_TEST;
+START_TEST(reuseDefinitions) {
+    PicosatCNF cnf;
+    CNFBuilder builder(&cnf, "", false, CNFBuilder::ConstantPolicy::BOUND, 0,
+                       CNFBuilder::Encoding::POLARITY);
+    BoolExp *first = BoolExp::parseString("X -> (A && B && C)");
+    builder.pushClause(first);
+    first->release();
+    ck_assert_int_eq(cnf.getVarCount(), 6);
+    ck_assert_int_eq(cnf.getClauseCount(), 5);
+
+    // the conjunction is parsed again, but it is encoded only once
+    BoolExp *second = BoolExp::parseString("Y -> (A && B && C)");
+    builder.pushClause(second);
+    second->release();
+    ck_assert_int_eq(cnf.getVarCount(), 8);
+    ck_assert_int_eq(cnf.getClauseCount(), 7);
+    cnf.pushAssumption("Y", true);
+    cnf.pushAssumption("B", false);
+    fail_if(cnf.checkSatisfiable());
+} END_TEST;
+
 Suite *cond_block_suite(void) {
     Suite *s  = suite_create("Suite: test-CNFBuilder");
     TCase *tc = tcase_create("CNFBuilder");
@@ -350,8 +485,13 @@ Suite *cond_block_suite(void) {
     tcase_add_test(tc, buildCNFConst);
     tcase_add_test(tc, buildAndNull);
     tcase_add_test(tc, buildImplNull);
+    tcase_add_test(tc, buildNestedNull);
+    tcase_add_test(tc, buildNestedIgnored);
     tcase_add_test(tc, buildCNFVarUsedMultipleTimes);
     tcase_add_test(tc, literals);
+    tcase_add_test(tc, buildCNFPolarity);
+    tcase_add_test(tc, buildCNFChains);
+    tcase_add_test(tc, reuseDefinitions);
     tcase_add_test(tc, buildCNFVarUsedMultipleTimes);
     suite_add_tcase(s, tc);
     return s;
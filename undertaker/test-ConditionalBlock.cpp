@@ -18,11 +18,15 @@
  */
 
 #include <string>
+#include <fstream>
 #include <iostream>
 #include <typeinfo>
 
 #include "ConditionalBlock.h"
+#include "CppFileCache.h"
+#include "bool.h"
 
+#include <boost/filesystem.hpp>
 #include <stdlib.h>
 #include <assert.h>
 #include <check.h>
@@ -84,6 +88,27 @@ START_TEST(cond_getConstraints) {
 
 } END_TEST;
 
+START_TEST(cond_replaceDefinedSymbols) {
+    std::string s = "A && !B || (X) || A_B || A+1 || AB";
+    file->replaceDefinedSymbols(s);
+    ck_assert_str_eq(s.c_str(), "A. && !B... || (X.) || A_B || A+1 || AB");
+
+    std::vector<CppDefine *> defines = file->getDefinesOf("defined(X) && B || A || X");
+    fail_unless(defines.size() == 3);
+    ck_assert_str_eq(defines[0]->getActualSymbol().c_str(), "A.");
+    ck_assert_str_eq(defines[1]->getActualSymbol().c_str(), "B...");
+    ck_assert_str_eq(defines[2]->getActualSymbol().c_str(), "X.");
+} END_TEST;
+
+START_TEST(cond_getCodeConstraintExp) {
+    // the same nodes as the parser builds from the formula
+    for (ConditionalBlock *block : {file->topBlock(), block_a, block_b, block_ifdef, block_elsif}) {
+        kconfig::BoolExp *parsed = kconfig::BoolExp::parseString(block->getCodeConstraints());
+        fail_unless(parsed == block->getCodeConstraintExp());
+        parsed->release();
+    }
+} END_TEST;
+
 Suite *
 cond_block_suite(void) {
     ConditionalBlock::iterator i = file->topBlock()->begin();
@@ -101,12 +126,23 @@ cond_block_suite(void) {
     TCase *tc = tcase_create("Conditional");
     tcase_add_test(tc, cond_parse_test);
     tcase_add_test(tc, cond_getConstraints);
+    tcase_add_test(tc, cond_replaceDefinedSymbols);
+    tcase_add_test(tc, cond_getCodeConstraintExp);
 
     suite_add_tcase(s, tc);
 
     return s;
 }
 
+static int run_suite() {
+    Suite *s = cond_block_suite();
+    SRunner *sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    int number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return number_failed;
+}
+
 int main(int argc, char **argv) {
     if (argc > 1) {
         CppFile f(argv[1]);
@@ -116,13 +152,37 @@ int main(int argc, char **argv) {
         std::cout << f.topBlock()->getCodeConstraints() << std::endl;
     }
 
+    // both parsers have to build the same blocks
+    int number_failed = 0;
+    for (CppFile::Parser parser : {CppFile::Parser::PUMA, CppFile::Parser::SCANNER}) {
+        CppFile::setParser(parser);
+        file = new CppFile("validation/conditional-block-test");
+        number_failed += run_suite();
+        delete file;
+    }
+
+    // and so does the cache
+    char cache_dir[] = "/tmp/test-ConditionalBlock.XXXXXX";
+    if (!mkdtemp(cache_dir))
+        return EXIT_FAILURE;
+    CppFileCache::setDirectory(cache_dir);
+    delete new CppFile("validation/conditional-block-test");  // stores the entry
     file = new CppFile("validation/conditional-block-test");
-    Suite *s = cond_block_suite();
-    SRunner *sr = srunner_create(s);
-    srunner_run_all(sr, CK_NORMAL);
-    int number_failed = srunner_ntests_failed(sr);
-    srunner_free(sr);
+    if (!dynamic_cast<CppFileCache *>(file->getBuilder()))
+        number_failed++;
+    number_failed += run_suite();
+    delete file;
+
+    // but not once an #include that didn't resolve finds its file
+    const std::string source = std::string(cache_dir) + "/include-later.c";
+    std::ofstream(source) << "#include \"later.h\"\n#ifdef CONFIG_A\n#endif\n";
+    delete new CppFile(source);
+    std::ofstream(std::string(cache_dir) + "/later.h") << "#define CONFIG_A\n";
+    file = new CppFile(source);
+    if (dynamic_cast<CppFileCache *>(file->getBuilder()))
+        number_failed++;
     delete file;
+    boost::filesystem::remove_all(cache_dir);
 
     return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
 }
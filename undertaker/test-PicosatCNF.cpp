@@ -20,10 +20,14 @@
 
 #include "bool.h"
 #include "PicosatCNF.h"
+#include "exceptions/SatBudgetExceeded.h"
+#include <cstdio>
 #include <iostream>
 #include <check.h>
 #include <string>
 #include <sstream>
+#include <thread>
+#include <vector>
 
 using namespace kconfig;
 
@@ -418,6 +422,324 @@ START_TEST(addClausesToCnfFromFile) {
     fail_unless(cnf.deref(v6) == true);
 } END_TEST;
 
+START_TEST(copiedModel) {
+    PicosatCNF cnf;
+
+    // v2 -> v1
+    cnf.pushVar(-2);
+    cnf.pushVar(1);
+    cnf.pushClause();
+
+    cnf.pushAssumption(2);
+    fail_unless(cnf.checkSatisfiable());
+
+    // the copy must not share the solver instance with the original
+    PicosatCNF copy(cnf);
+    copy.pushVar(-1);
+    copy.pushClause();
+    copy.pushAssumption(2);
+    fail_if(copy.checkSatisfiable());
+
+    cnf.pushAssumption(2);
+    fail_unless(cnf.checkSatisfiable());
+    fail_unless(cnf.deref(1) == true);
+
+    copy.pushAssumption(2);
+    fail_if(copy.checkSatisfiable());
+} END_TEST;
+
+START_TEST(threadedUsage) {
+    std::vector<std::thread> threads;
+    std::vector<int> results(8, 0);
+
+    for (int t = 0; t < 8; t++)
+        threads.emplace_back([t, &results]() {
+            // each thread alternates between its own two models
+            PicosatCNF satisfiable, unsatisfiable;
+
+            // v1 || !v1
+            satisfiable.pushVar(1);
+            satisfiable.pushVar(-1);
+            satisfiable.pushClause();
+
+            // v1 && !v1
+            unsatisfiable.pushVar(1);
+            unsatisfiable.pushClause();
+            unsatisfiable.pushVar(-1);
+            unsatisfiable.pushClause();
+
+            for (int i = 0; i < 100; i++) {
+                satisfiable.pushAssumption((i + t) % 2 ? 1 : -1);
+                if (satisfiable.checkSatisfiable()
+                    && satisfiable.deref(1) == ((i + t) % 2 == 1)
+                    && !unsatisfiable.checkSatisfiable())
+                    results[t]++;
+            }
+        });
+    for (std::thread &thread : threads)
+        thread.join();
+
+    for (const int &result : results)
+        ck_assert_int_eq(result, 100);
+} END_TEST;
+
+START_TEST(mergedArchitectures) {
+    PicosatCNF a, b;
+    a.setCNFVar("CONFIG_A", 1);
+    a.setCNFVar("CONFIG_B", 2);
+    a.addMetaValue("ALWAYS_ON", "CONFIG_B");
+    // CONFIG_A -> CONFIG_B
+    a.pushVar(-1);
+    a.pushVar(2);
+    a.pushClause();
+    // v3 && (v3 -> CONFIG_A), v3 has no name
+    a.pushVar(3);
+    a.pushClause();
+    a.pushVar(-3);
+    a.pushVar(1);
+    a.pushClause();
+
+    b.setCNFVar("CONFIG_B", 1);
+    b.setCNFVar("CONFIG_A", 2);
+    b.addMetaValue("ALWAYS_ON", "CONFIG_A");
+    // CONFIG_A -> CONFIG_B
+    b.pushVar(1);
+    b.pushVar(-2);
+    b.pushClause();
+    // !CONFIG_A
+    b.pushVar(-2);
+    b.pushClause();
+
+    PicosatCNF merged;
+    merged.mergeArchitectures({{"a", &a}, {"b", &b}});
+
+    // the clause both architectures have in common is only stored once
+    ck_assert_int_eq(merged.getClauseCount(), 5);
+    const std::deque<std::string> *archs = merged.getMetaValue("ARCHITECTURES");
+    fail_unless(archs != nullptr && archs->size() == 2);
+    // items are only whitelisted if they are whitelisted on all architectures
+    fail_unless(merged.getMetaValue("ALWAYS_ON") == nullptr);
+
+    fail_unless(merged.checkSatisfiable());
+
+    merged.pushAssumption("CONFIG_A", true);
+    fail_unless(merged.checkSatisfiable());
+    fail_unless(merged.deref("ARCH_a"));
+    fail_if(merged.deref("ARCH_b"));
+
+    merged.pushAssumption("CONFIG_A", true);
+    merged.pushAssumption("CONFIG_B", false);
+    fail_if(merged.checkSatisfiable());
+
+    merged.pushAssumption("ARCH_a", true);
+    merged.pushAssumption("ARCH_b", true);
+    fail_if(merged.checkSatisfiable());
+} END_TEST;
+
+START_TEST(binaryFile) {
+    PicosatCNF cnf;
+    cnf.setCNFVar("CONFIG_A", 1);
+    cnf.setCNFVar("CONFIG_B", 2);
+    cnf.setSymbolType("A", K_S_BOOLEAN);
+    cnf.setSymbolType("B", K_S_TRISTATE);
+    cnf.addMetaValue("ALWAYS_ON", "CONFIG_A");
+    cnf.addMetaValue("ALWAYS_ON", "CONFIG_C");
+    // CONFIG_B -> v3 && v3 -> CONFIG_A
+    cnf.pushVar(-2);
+    cnf.pushVar(3);
+    cnf.pushClause();
+    cnf.pushVar(-3);
+    cnf.pushVar(1);
+    cnf.pushClause();
+
+    const std::string filename("test-PicosatCNF.cnfb");
+    cnf.toFile(filename);
+    PicosatCNF binary;
+    binary.readFromFile(filename);
+    std::remove(filename.c_str());
+
+    // the binary format has to round-trip with the text format
+    std::stringstream text, binary_text;
+    cnf.toStream(text);
+    binary.toStream(binary_text);
+    ck_assert_str_eq(text.str().c_str(), binary_text.str().c_str());
+    fail_unless(binary.getClauses() == cnf.getClauses());
+
+    // the copy shares the mapped clauses and can still be extended
+    PicosatCNF copy(binary);
+    copy.pushVar(-1);
+    copy.pushClause();
+    copy.pushAssumption("CONFIG_B", true);
+    fail_if(copy.checkSatisfiable());
+
+    binary.pushAssumption("CONFIG_B", true);
+    fail_unless(binary.checkSatisfiable());
+    fail_unless(binary.deref("CONFIG_A"));
+} END_TEST;
+
+START_TEST(simplifiedModel) {
+    PicosatCNF cnf;
+    cnf.setCNFVar("CONFIG_A", 1);
+    cnf.setCNFVar("CONFIG_B", 2);
+    cnf.setCNFVar("CONFIG_C", 3);
+    cnf.addMetaValue("ALWAYS_ON", "CONFIG_C");
+    // v4 <-> (CONFIG_A || CONFIG_B)
+    cnf.pushVar(-4);
+    cnf.pushVar(1);
+    cnf.pushVar(2);
+    cnf.pushClause();
+    cnf.pushVar(4);
+    cnf.pushVar(-1);
+    cnf.pushClause();
+    cnf.pushVar(4);
+    cnf.pushVar(-2);
+    cnf.pushClause();
+    // CONFIG_C -> v4, twice
+    for (int i = 0; i < 2; i++) {
+        cnf.pushVar(-3);
+        cnf.pushVar(4);
+        cnf.pushClause();
+    }
+    // v5 && (v5 -> CONFIG_C)
+    cnf.pushVar(5);
+    cnf.pushClause();
+    cnf.pushVar(-5);
+    cnf.pushVar(3);
+    cnf.pushClause();
+
+    PicosatCNF simplified(cnf);
+    simplified.simplify();
+    // left: CONFIG_C, CONFIG_A || CONFIG_B
+    ck_assert_int_eq(simplified.getVarCount(), 3);
+    ck_assert_int_eq(simplified.getClauseCount(), 2);
+    fail_unless(simplified.getMetaValue("ALWAYS_ON") != nullptr);
+
+    // both models agree on all assignments of the named variables
+    for (int i = 0; i < 8; i++) {
+        for (PicosatCNF *c : {&cnf, &simplified}) {
+            c->pushAssumption("CONFIG_A", i & 1);
+            c->pushAssumption("CONFIG_B", i & 2);
+            c->pushAssumption("CONFIG_C", i & 4);
+        }
+        ck_assert_int_eq(cnf.checkSatisfiable(), simplified.checkSatisfiable());
+    }
+} END_TEST;
+
+START_TEST(modelBackbone) {
+    PicosatCNF cnf;
+    cnf.setCNFVar("CONFIG_A", 1);
+    cnf.setCNFVar("CONFIG_B", 2);
+    cnf.setCNFVar("CONFIG_C", 3);
+    cnf.setCNFVar("CONFIG_BROKEN", 4);
+    // CONFIG_A && (CONFIG_A -> CONFIG_B) && (CONFIG_BROKEN -> !CONFIG_A), CONFIG_C is free
+    cnf.pushVar(1);
+    cnf.pushClause();
+    cnf.pushVar(-1);
+    cnf.pushVar(2);
+    cnf.pushClause();
+    cnf.pushVar(-4);
+    cnf.pushVar(-1);
+    cnf.pushClause();
+    cnf.pushVar(3);
+    cnf.pushVar(-3);
+    cnf.pushClause();
+
+    // all checks share one selector
+    const int vars = cnf.getVarCount();
+    cnf.computeBackbone();
+    ck_assert_int_eq(vars + 1, cnf.getVarCount());
+    const std::deque<std::string> on{"CONFIG_A", "CONFIG_B"}, off{"CONFIG_BROKEN"};
+    fail_unless(cnf.getMetaValue("BACKBONE_ON") != nullptr);
+    fail_unless(*cnf.getMetaValue("BACKBONE_ON") == on);
+    fail_unless(cnf.getMetaValue("BACKBONE_OFF") != nullptr);
+    fail_unless(*cnf.getMetaValue("BACKBONE_OFF") == off);
+    fail_unless(cnf.checkSatisfiable());
+} END_TEST;
+
+START_TEST(sharedSymbolTable) {
+    PicosatCNF cnf;
+    cnf.setCNFVar("CONFIG_A", 1);
+    cnf.setCNFVar("CONFIG_A_MODULE", 2);
+    cnf.setSymbolType("A", K_S_TRISTATE);
+    PicosatCNF copy(cnf);
+    fail_unless(&copy.getSymbolTable() == &cnf.getSymbolTable());
+
+    // the copy gets a table of its own as soon as it changes it
+    copy.setCNFVar("CONFIG_B", 3);
+    copy.setCNFVar("CONFIG_A", 4);
+    fail_if(&copy.getSymbolTable() == &cnf.getSymbolTable());
+    ck_assert_int_eq(0, cnf.getCNFVar("CONFIG_B"));
+    ck_assert_int_eq(1, cnf.getCNFVar("CONFIG_A"));
+    ck_assert_int_eq(4, copy.getCNFVar("CONFIG_A"));
+    ck_assert_str_eq("CONFIG_B", copy.getSymbolName(3).c_str());
+    ck_assert_str_eq("", cnf.getSymbolName(3).c_str());
+    fail_unless(copy.hasAssociatedSymbol("CONFIG_A_MODULE"));
+    fail_if(copy.hasAssociatedSymbol("CONFIG_B"));
+    const SymbolTable &table = copy.getSymbolTable();
+    ck_assert_str_eq("A", table.str(table.associated(table.find("CONFIG_A_MODULE"))).c_str());
+    fail_unless(copy.getSymbolType("A") == K_S_TRISTATE);
+    fail_unless(copy.getSymbolType("CONFIG_A") == K_S_UNKNOWN);
+
+    // many names, such that the hash table has to grow several times
+    for (int i = 0; i < 1000; i++)
+        cnf.setCNFVar("CONFIG_X" + std::to_string(i), cnf.newVar());
+    for (int i = 0; i < 1000; i++)
+        ck_assert_str_eq(("CONFIG_X" + std::to_string(i)).c_str(),
+                         cnf.getSymbolName(cnf.getCNFVar("CONFIG_X" + std::to_string(i))).c_str());
+    ck_assert_int_eq(1002, cnf.getSymbolTable().varCount());
+} END_TEST;
+
+START_TEST(minimalUnsatisfiableSubset) {
+    PicosatCNF cnf;
+    // A, A -> B, C || D, !B
+    cnf.pushVar(1);
+    cnf.pushClause();
+    cnf.pushVar(-1);
+    cnf.pushVar(2);
+    cnf.pushClause();
+    cnf.pushVar(3);
+    cnf.pushVar(4);
+    cnf.pushClause();
+    fail_unless(cnf.minimalUnsatisfiableSubset().empty());
+    cnf.pushVar(-2);
+    cnf.pushClause();
+
+    const std::vector<int> mus{1, 0, -1, 2, 0, -2, 0};
+    fail_unless(cnf.minimalUnsatisfiableSubset() == mus);
+    // the solver of the cnf itself is not affected
+    cnf.pushAssumption(3);
+    fail_if(cnf.checkSatisfiable());
+} END_TEST;
+
+START_TEST(propagationBudget) {
+    PicosatCNF cnf;
+    // pigeonhole: 7 pigeons don't fit into 6 holes, variable 6 * p + h + 1
+    const int pigeons = 7, holes = 6;
+    for (int p = 0; p < pigeons; p++) {
+        for (int h = 0; h < holes; h++)
+            cnf.pushVar(holes * p + h + 1);
+        cnf.pushClause();
+    }
+    for (int h = 0; h < holes; h++)
+        for (int p = 0; p < pigeons; p++)
+            for (int q = p + 1; q < pigeons; q++) {
+                cnf.pushVar(-(holes * p + h + 1));
+                cnf.pushVar(-(holes * q + h + 1));
+                cnf.pushClause();
+            }
+    PicosatCNF::setPropagationBudget(10);
+    bool exceeded = false;
+    try {
+        cnf.checkSatisfiable();
+    } catch (SatBudgetExceeded &) {
+        exceeded = true;
+    }
+    fail_unless(exceeded);
+    // the budget applies to each check, and the instance is still usable
+    PicosatCNF::setPropagationBudget(0);
+    fail_if(cnf.checkSatisfiable());
+} END_TEST;
+
 Suite *cond_block_suite(void) {
     Suite *s  = suite_create("PicosatCNF-test");
     TCase *tc = tcase_create("PicosatCNF");
@@ -431,6 +753,15 @@ Suite *cond_block_suite(void) {
     tcase_add_test(tc, readCnfFileWithInts);
     tcase_add_test(tc, readCnfFileWithStrings);
     tcase_add_test(tc, addClausesToCnfFromFile);
+    tcase_add_test(tc, copiedModel);
+    tcase_add_test(tc, threadedUsage);
+    tcase_add_test(tc, mergedArchitectures);
+    tcase_add_test(tc, binaryFile);
+    tcase_add_test(tc, simplifiedModel);
+    tcase_add_test(tc, modelBackbone);
+    tcase_add_test(tc, sharedSymbolTable);
+    tcase_add_test(tc, minimalUnsatisfiableSubset);
+    tcase_add_test(tc, propagationBudget);
     suite_add_tcase(s, tc);
     return s;
 }
@@ -23,13 +23,22 @@
  */
 
 #include "SatChecker.h"
+#include "CnfConfigurationModel.h"
+#include "bool.h"
 
 #include <assert.h>
+#include <atomic>
+#include <cstdio>
+#include <deque>
+#include <list>
 #include <typeinfo>
 #include <string>
 #include <sstream>
 #include <set>
+#include <thread>
+#include <vector>
 #include <check.h>
+#include <boost/filesystem.hpp>
 
 
 int cnf_test(std::string s, bool result, std::runtime_error *error = nullptr) {
@@ -116,6 +125,221 @@ START_TEST(test_base_expression) {
     fail_if(sat(a1));
 } END_TEST
 
+START_TEST(test_assignments) {
+    BaseExpressionSatChecker sat("X && (Y || Z) && !(Y && Z)");
+    fail_if(!sat({"Y"}));
+    const SatChecker::AssignmentMap y = sat.getAssignment();
+    fail_if(!sat({"Z"}));
+    const SatChecker::AssignmentMap z = sat.getAssignment();
+    ck_assert_int_eq(3, y.size());
+    fail_unless(y.at("X") && y.at("Y") && !y.at("Z"));
+    fail_if(y == z);
+
+    // the same entries, but with a name table of its own
+    SatChecker::AssignmentMap m;
+    m.emplace("Z", false);
+    m.emplace("X", true);
+    m.emplace("Y", true);
+    fail_unless(m == y);
+    fail_unless(SatChecker::AssignmentMap::Hash()(m) == SatChecker::AssignmentMap::Hash()(y));
+
+    std::stringstream ss;
+    SatChecker::AssignmentMap::intersect({y, z}).formatAll(ss);
+    ck_assert_str_eq(ss.str().c_str(), "X=1\n");
+    ss.str("");
+    z.difference(m).formatAll(ss);
+    ck_assert_str_eq(ss.str().c_str(), "Y=0\nZ=1\n");
+
+    SatChecker::AssignmentMap::Filter notX([](const std::string &name) { return name != "X"; });
+    ck_assert_int_eq(2, y.select(notX).size());
+    ck_assert_int_eq(2, m.select(notX).size());
+    fail_unless(y.select(notX) == m.select(notX));
+} END_TEST
+
+START_TEST(test_incremental_queries) {
+    IncrementalSatChecker sat(nullptr);
+    sat.beginQuery();
+    sat.addFormula("X && !Y");
+    fail_if(!sat("X"));
+    fail_if(!sat.deref("X"));
+    fail_if(sat.deref("Y"));
+    fail_if(sat("Y"));
+    sat.endQuery();
+
+    // the formulas of the previous query must not be active anymore
+    sat.beginQuery();
+    fail_if(!sat("Y && !X"));
+    sat.endQuery();
+    sat.beginQuery();
+    fail_if(!sat("X && Y"));
+    SatChecker::AssignmentMap assumptions;
+    assumptions.emplace("X", false);
+    fail_if(sat.checkAssuming(assumptions));
+    sat.endQuery();
+    fail_if(!sat.checkAssuming(assumptions));
+} END_TEST
+
+START_TEST(test_expressions) {
+    // built expressions are checked without formatting them
+    kconfig::BoolExp *exp = B_AND(B_VAR("X", false), B_NOT(B_VAR("Y", false)));
+    SatChecker checker;
+    fail_if(!checker(exp));
+
+    IncrementalSatChecker sat(nullptr);
+    sat.beginQuery();
+    sat.addFormula(exp);
+    fail_if(!sat("X"));
+    fail_if(sat.deref("Y"));
+    fail_if(sat("Y"));
+    sat.endQuery();
+    exp->release();
+} END_TEST
+
+START_TEST(test_incremental_threads) {
+    // each thread gets checkers of its own
+    IncrementalSatChecker *main_checker = &IncrementalSatChecker::forModel(nullptr);
+    std::vector<std::thread> threads;
+    std::atomic<int> failures(0);
+    for (int i = 0; i < 4; i++) {
+        threads.emplace_back([main_checker, &failures, i]() {
+            IncrementalSatChecker &sat = IncrementalSatChecker::forModel(nullptr);
+            if (&sat == main_checker || &sat != &IncrementalSatChecker::forModel(nullptr))
+                failures++;
+            const std::string var = "X" + std::to_string(i);
+            for (int j = 0; j < 50; j++) {
+                sat.beginQuery();
+                if (!sat(var + " && !Y") || sat("Y"))
+                    failures++;
+                sat.endQuery();
+            }
+        });
+    }
+    for (std::thread &t : threads)
+        t.join();
+    ck_assert_int_eq(0, failures);
+} END_TEST
+
+START_TEST(test_incremental_architectures) {
+    IncrementalSatChecker sat(nullptr);
+    const std::deque<std::string> archs{"a", "b", "c"};
+    sat.beginQuery();
+    // what 'rsf2cnf -a' makes out of three architectures
+    sat.addFormula("(ARCH_a -> X) && (ARCH_b -> !X) && (ARCH_c -> Y) && (ARCH_a || ARCH_b || ARCH_c)");
+    sat.addFormula("X");
+    std::list<std::string> expected{"a", "c"};
+    fail_unless(sat.checkArchitectures(archs) == expected);
+    sat.addFormula("!Y");
+    expected = {"a"};
+    fail_unless(sat.checkArchitectures(archs) == expected);
+    sat.endQuery();
+} END_TEST
+
+START_TEST(test_incremental_slicing) {
+    kconfig::PicosatCNF cnf;
+    // A -> B -> !C, D is not connected to them
+    for (const std::string var : {"A", "B", "C", "D"})
+        cnf.setCNFVar(var, cnf.newVar());
+    int a = cnf.getCNFVar("A"), b = cnf.getCNFVar("B"), c = cnf.getCNFVar("C");
+    cnf.pushVar(-a);
+    cnf.pushVar(b);
+    cnf.pushClause();
+    cnf.pushVar(-b);
+    cnf.pushVar(-c);
+    cnf.pushClause();
+    cnf.pushVar(cnf.getCNFVar("D"));
+    cnf.pushClause();
+    const std::string filename("test-SatChecker.cnf");
+    cnf.toFile(filename);
+    CnfConfigurationModel model(filename);
+    std::remove(filename.c_str());
+
+    kconfig::PicosatCNF sliced(*model.getCNF());
+    sliced.clearClauses();
+    CnfConfigurationModel::Cone cone;
+    fail_if(model.pushCone(&sliced, {a}, cone, 1));
+    ck_assert_int_eq(1, sliced.getClauseCount());
+    fail_unless(model.pushCone(&sliced, {}, cone));
+    ck_assert_int_eq(2, sliced.getClauseCount());
+
+    for (int depth : {-1, 1, 0}) {
+        IncrementalSatChecker::setSliceDepth(depth);
+        IncrementalSatChecker sat(&model);
+        sat.beginQuery();
+        fail_if(sat("A && C"));
+        sat.endQuery();
+        sat.beginQuery();
+        fail_if(sat("!D"));
+        sat.endQuery();
+        sat.beginQuery();
+        fail_unless(sat("A"));
+        fail_unless(sat.deref("B"));
+        sat.endQuery();
+    }
+    IncrementalSatChecker::setSliceDepth(-1);
+} END_TEST
+
+START_TEST(test_result_cache) {
+    const std::string a = SatResultCache::canonicalize(
+        nullptr, {"B2\n&&\n( B2 <-> B1 && CONFIG_X )\n&& ( B1 <-> FILE_a.c )", "CONFIG_X"});
+    const std::string b = SatResultCache::canonicalize(
+        nullptr, {"B7\n&&\n( B5 <-> FILE_b.c )\n&& ( B7 <-> B5 && CONFIG_X )", "CONFIG_X"});
+    const std::string c = SatResultCache::canonicalize(
+        nullptr, {"B7\n&&\n( B5 <-> FILE_b.c )\n&& ( B7 <-> B5 || CONFIG_X )", "CONFIG_X"});
+    // the same structure with other blocks, files and order of conjuncts
+    fail_unless(a == b);
+    fail_unless(a != c);
+    fail_unless(SatResultCache::canonicalize(nullptr, {"B1 && B2 || B3"})
+                == SatResultCache::canonicalize(nullptr, {"B4 && B5 || B6"}));
+    fail_unless(SatResultCache::canonicalize(nullptr, {"B1 && CONFIG_X", "B2"})
+                == SatResultCache::canonicalize(nullptr, {"CONFIG_X && B3", "B4"}));
+    fail_unless(SatResultCache::canonicalize(nullptr, {"B1 && CONFIG_X || CONFIG_Y"})
+                != SatResultCache::canonicalize(nullptr, {"CONFIG_X || CONFIG_Y && B1"}));
+
+    const std::string directory("test-SatChecker.cache");
+    SatResultCache::setDirectory(directory);
+    std::string result;
+    fail_if(SatResultCache::lookup(a, result));
+    SatResultCache::store(a, "kconfig");
+    SatResultCache::store(c, "");
+    fail_unless(SatResultCache::lookup(a, result));
+    ck_assert_str_eq("kconfig", result.c_str());
+    fail_unless(SatResultCache::lookup(c, result));
+    ck_assert_str_eq("", result.c_str());
+    fail_unless(SatResultCache::lookup(b, result));
+    ck_assert_str_eq("kconfig", result.c_str());
+    fail_if(SatResultCache::lookup(SatResultCache::canonicalize(nullptr, {"B1"}), result));
+    SatResultCache::setDirectory("");
+    boost::filesystem::remove_all(directory);
+} END_TEST
+
+START_TEST(test_result_cache_files) {
+    // a cnf model constrains the files by name: FILE_a.c -> CONFIG_X
+    kconfig::PicosatCNF cnf;
+    for (const std::string var : {"FILE_a.c", "FILE_b.c", "CONFIG_X"})
+        cnf.setCNFVar(var, cnf.newVar());
+    cnf.pushVar(-cnf.getCNFVar("FILE_a.c"));
+    cnf.pushVar(cnf.getCNFVar("CONFIG_X"));
+    cnf.pushClause();
+    const std::string filename("test-SatChecker.cnf");
+    cnf.toFile(filename);
+    CnfConfigurationModel model(filename);
+    std::remove(filename.c_str());
+
+    // the same block structure in two files
+    const std::vector<std::string> a{"B1\n&&\n( B1 <-> ! CONFIG_X )\n&& ( B00 <-> FILE_a.c )"};
+    const std::vector<std::string> b{"B1\n&&\n( B1 <-> ! CONFIG_X )\n&& ( B00 <-> FILE_b.c )"};
+    fail_unless(SatResultCache::canonicalize(nullptr, a) == SatResultCache::canonicalize(nullptr, b));
+    fail_unless(SatResultCache::canonicalize(&model, a) != SatResultCache::canonicalize(&model, b));
+    // B1 is dead in a.c only
+    IncrementalSatChecker sat(&model);
+    sat.beginQuery();
+    fail_if(sat(a[0] + "\n&& B00"));
+    sat.endQuery();
+    sat.beginQuery();
+    fail_unless(sat(b[0] + "\n&& B00"));
+    sat.endQuery();
+} END_TEST
+
 Suite * satchecker_suite(void) {
     Suite *s  = suite_create("SatChecker");
     TCase *tc = tcase_create("SatChecker");
@@ -123,6 +347,14 @@ Suite * satchecker_suite(void) {
     tcase_add_test(tc, format_config_items_module);
     tcase_add_test(tc, format_config_items_module_not_valid_in_kconfig);
     tcase_add_test(tc, test_base_expression);
+    tcase_add_test(tc, test_assignments);
+    tcase_add_test(tc, test_incremental_queries);
+    tcase_add_test(tc, test_expressions);
+    tcase_add_test(tc, test_incremental_threads);
+    tcase_add_test(tc, test_incremental_architectures);
+    tcase_add_test(tc, test_incremental_slicing);
+    tcase_add_test(tc, test_result_cache);
+    tcase_add_test(tc, test_result_cache_files);
 
     suite_add_tcase(s, tc);
 
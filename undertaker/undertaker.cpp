@@ -28,15 +28,24 @@
 #include "ModelContainer.h"
 #include "RsfConfigurationModel.h"
 #include "PumaConditionalBlock.h"
+#include "ScannerConditionalBlock.h"
+#include "CppFileCache.h"
 #include "ConditionalBlock.h"
 #include "BlockDefectAnalyzer.h"
 #include "SatChecker.h"
 #include "CoverageAnalyzer.h"
 #include "Logging.h"
 #include "Tools.h"
+#include "exceptions/SatBudgetExceeded.h"
 #include "../version.h"
 
+#include <algorithm>
+#include <atomic>
+#include <exception>
 #include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <sstream>
 #include <vector>
 #include <sys/wait.h>
@@ -109,7 +118,22 @@ void usage(std::ostream &out, const char *error) {
     "                       (output-format: <file>:<blockID>:<start>:<end>)\n"
     "  -b  batch mode: analyze all files in a given worklist-file\n"
     "  -t  specify a number of parallel processes (default: 1)\n"
+    "  -T  specify a number of threads per process for checking a defect on all\n"
+    "      models (default: number of cores divided by the number of processes)\n"
+    "  -S  specify how many steps the clauses of a cnf model are followed to load\n"
+    "      the cone of influence of a defect check, 0 loads the whole model\n"
+    "      (default: -1, i.e., the whole cone)\n"
+    "  -P  specify how many unit propagations a single SAT check may take, the\n"
+    "      blocks of checks that exceed it are recorded as unknown, 0 means no limit\n"
+    "      (default: 100000000)\n"
+    "  -K  cache the results of the defect checks on the models and the parsed\n"
+    "      files in the given directory, which can be shared by several runs\n"
     "  -I  add an include path for #include directives\n"
+    "  -p  specify the parser for the preprocessor blocks of the files\n"
+    "      puma      - full Puma preprocessor (default for all other jobs)\n"
+    "      scanner   - lightweight directive scanner, which only reads the\n"
+    "                  preprocessor directives (default for dead, cpppc,\n"
+    "                  cppsym and blockrange)\n"
     "  -s  skip non-configuration based defect reports\n"
     "  -u  calculate a 'minimal unsatisfiable subset' of the defect-formula\n"
     "\nCoverage Options:\n"
@@ -133,6 +157,76 @@ void usage(std::ostream &out, const char *error) {
 // XXX currently undocumented -O exec:cmd, -O commented, interactive mode
 }
 
+typedef std::function<void(const FileBudget::Cancellation &)> watched_job_t;
+
+// abandoned jobs whose threads haven't stopped yet, guarded by stuck_mutex
+static unsigned int stuck_jobs = 0;
+static std::mutex stuck_mutex;
+
+/**
+ * Runs the job in a thread of its own and waits at most the given number of
+ * seconds for it. The budget of the checks doesn't end hangs outside of them,
+ * e.g., in the parser. A job that takes longer is cancelled: its budget is
+ * exhausted, it doesn't check, nor report any further blocks, and it is
+ * reported like a job that ran out of budget. The following jobs are still
+ * processed.
+ *
+ * A cancelled job usually stops within its current check. If it doesn't stop
+ * within a few seconds, it hangs outside of its checks. Its thread is left
+ * behind and stops as soon as it returns to the job.
+ * @throws SatBudgetExceeded when the job is abandoned
+ */
+void run_watched(const watched_job_t &job, unsigned int seconds) {
+    struct State {
+        std::atomic<bool> cancelled{false};
+        std::exception_ptr error;
+        bool stopped = false, stuck = false;  // guarded by stuck_mutex
+    };
+    // a stuck thread outlives this call, so it owns everything it uses
+    auto state = std::make_shared<State>();
+    boost::thread t([job, state]() {
+        try {
+            job(FileBudget::Cancellation(state, &state->cancelled));
+        } catch (...) {
+            state->error = std::current_exception();
+        }
+        std::lock_guard<std::mutex> lock(stuck_mutex);
+        state->stopped = true;
+        if (state->stuck)
+            stuck_jobs--;
+    });
+    if (t.try_join_for(boost::chrono::seconds(seconds))) {
+        if (state->error)
+            std::rethrow_exception(state->error);
+        return;
+    }
+    state->cancelled = true;
+    if (!t.try_join_for(boost::chrono::seconds(10))) {
+        std::lock_guard<std::mutex> lock(stuck_mutex);
+        if (!state->stopped) {
+            state->stuck = true;
+            stuck_jobs++;
+        }
+        t.detach();
+    }
+    throw SatBudgetExceeded("timeout of " + std::to_string(seconds) + " seconds passed");
+}
+
+/*
+ * The threads of stuck jobs may still use the models and other static
+ * objects. If there are any, the process ends without destroying them.
+ */
+int leave(int status) {
+    {
+        std::lock_guard<std::mutex> lock(stuck_mutex);
+        if (stuck_jobs == 0)
+            return status;
+    }
+    std::cout.flush();
+    std::cerr.flush();
+    std::_Exit(status);
+}
+
 int rm_pattern(const char *pattern) {
     glob_t globbuf;
 
@@ -293,10 +387,14 @@ void process_blockconf(const std::string &locationname) {
         sc.getAssignment().formatKconfig(std::cout, {});
 }
 
-void process_file_coverage_helper(const std::string &filename) {
-    CppFile file(filename);
+void process_file_coverage_helper(const std::string &filename,
+                                  const FileBudget::Cancellation &cancelled) {
+    // source output needs the Puma tokens, which aren't cached
+    CppFile file(filename, false);
 
-    if (!file.good()) {
+    if (*cancelled) {
+        return;
+    } else if (!file.good()) {
         Logging::error("failed to open file: `", filename, "'");
         std::exit(EXIT_FAILURE);
     } else if (decision_coverage) {
@@ -329,10 +427,14 @@ void process_file_coverage_helper(const std::string &filename) {
     if (!main_model)
         Logging::debug("Running without a model!");
 
-    std::list<SatChecker::AssignmentMap> solutions = analyzer->blockCoverage(main_model);
+    FileBudget budget(120, cancelled);
+    std::list<SatChecker::AssignmentMap> solutions = analyzer->blockCoverage(main_model, budget);
     MissingSet missingSet = analyzer->getMissingSet();
 
-    if (coverageOutputMode == CoverageOutput::STDOUT) {
+    if (budget.cancelled()) {
+        file.pop_front();
+        return;
+    } else if (coverageOutputMode == CoverageOutput::STDOUT) {
         SatChecker::pprintAssignments(std::cout, solutions, main_model, missingSet);
         file.pop_front();
         return;
@@ -421,18 +523,17 @@ void process_file_coverage_helper(const std::string &filename) {
 
     Logging::info(filename, ", ", "Found Solutions: ", solutions.size(), ", ", "Coverage: ",
                   enabled_blocks, "/", file.size(), " blocks enabled ", "(", ratio, "%)");
+    if (!budget.getUnknown().empty())
+        Logging::info(filename, ": ", budget.getUnknown().size(), " blocks unknown");
 
     // undo hack to avoid de-allocation failures
     file.pop_front();
 }
 
 void process_file_coverage(const std::string &filename) {
-    boost::thread t(process_file_coverage_helper, filename);
-
-    if (!t.try_join_for(boost::chrono::seconds(120))) {
-        Logging::error("timeout passed while processing ", filename);
-        std::exit(EXIT_FAILURE);
-    }
+    run_watched([filename](const FileBudget::Cancellation &cancelled) {
+        process_file_coverage_helper(filename, cancelled);
+    }, 180);
 }
 
 void process_file_cpppc(const std::string &filename) {
@@ -476,14 +577,17 @@ void process_file_cpppc(const std::string &filename) {
     }
 }
 
-void process_file_cppsym_helper(const std::string &filename) {
+void process_file_cppsym_helper(const std::string &filename,
+                                const FileBudget::Cancellation &cancelled) {
     // vector of length 2, first: #references, second: #rewrites
     typedef std::vector<size_t> ItemStats;
     // key: name of the item.
     typedef std::map<std::string, ItemStats> FoundItems;
 
     CppFile file(filename);
-    if (!file.good()) {
+    if (*cancelled) {
+        return;
+    } else if (!file.good()) {
         Logging::error("failed to open file: `", filename, "'");
         std::exit(EXIT_FAILURE);
     }
@@ -552,18 +656,18 @@ void process_file_cppsym_helper(const std::string &filename) {
 }
 
 void process_file_cppsym(const std::string &filename) {
-    boost::thread t(process_file_cppsym_helper, filename);
-
-    if (!t.try_join_for(boost::chrono::seconds(30))) {
-        Logging::error("timeout passed while processing ", filename);
-        std::exit(EXIT_FAILURE);
-    }
+    run_watched([filename](const FileBudget::Cancellation &cancelled) {
+        process_file_cppsym_helper(filename, cancelled);
+    }, 30);
 }
 
-void process_file_blockrange_helper(const std::string &filename) {
+void process_file_blockrange_helper(const std::string &filename,
+                                    const FileBudget::Cancellation &cancelled) {
     CppFile cpp(filename);
 
-    if (!cpp.good()) {
+    if (*cancelled) {
+        return;
+    } else if (!cpp.good()) {
         Logging::error("failed to open file: `", filename, "'");
         std::exit(EXIT_FAILURE);
     }
@@ -578,12 +682,9 @@ void process_file_blockrange_helper(const std::string &filename) {
 }
 
 void process_file_blockrange(const std::string &filename) {
-    boost::thread t(process_file_blockrange_helper, filename);
-
-    if (!t.try_join_for(boost::chrono::seconds(10))) {
-        Logging::error("timeout passed while processing ", filename);
-        std::exit(EXIT_FAILURE);
-    }
+    run_watched([filename](const FileBudget::Cancellation &cancelled) {
+        process_file_blockrange_helper(filename, cancelled);
+    }, 10);
 }
 
 void process_file_blockpc(const std::string &filename) {
@@ -617,7 +718,8 @@ void process_file_blockpc(const std::string &filename) {
     else
         main_model = ModelContainer::lookupMainModel();
 
-    const BlockDefect *defect = BlockDefectAnalyzer::analyzeBlock(block, main_model);
+    const FileBudget budget(0);  // a single block, without a time limit
+    const BlockDefect *defect = BlockDefectAnalyzer::analyzeBlock(block, main_model, budget);
     std::string defect_string
         = (defect ? defect->getSuffix() + "/" + defect->defectTypeToString() : "no");
     Logging::info("Block ", block->getName(), " | Defect: ", defect_string,
@@ -627,9 +729,14 @@ void process_file_blockpc(const std::string &filename) {
     std::cout << BlockDefectAnalyzer::getBlockPrecondition(block, main_model) << std::endl;
 }
 
-void process_file_dead_helper(const std::string &filename) {
+void process_file_dead_helper(const std::string &filename, unsigned int timeout,
+                              const FileBudget::Cancellation &cancelled) {
     CppFile file(filename);
-    if (!file.good()) {
+    FileBudget budget(timeout, cancelled);
+    // the reports of a cancelled job have already been written
+    if (budget.cancelled()) {
+        return;
+    } else if (!file.good()) {
         Logging::error("failed to open file: `", filename, "'");
         std::exit(EXIT_FAILURE);
     }
@@ -637,6 +744,8 @@ void process_file_dead_helper(const std::string &filename) {
     std::string pattern(filename);
     pattern.append("*.*dead");
     rm_pattern(pattern.c_str());
+    pattern = filename + "*.unknown";
+    rm_pattern(pattern.c_str());
 
     // if the current file is arch specific, use only the matching model for analyses
     ConfigurationModel *main_model;
@@ -645,36 +754,61 @@ void process_file_dead_helper(const std::string &filename) {
     else
         main_model = ModelContainer::lookupMainModel();
 
-    static auto processBlock = [](ConditionalBlock *block, ConfigurationModel *main_model) {
-        const BlockDefect *defect = BlockDefectAnalyzer::analyzeBlock(block, main_model);
-        if (defect) {
+    static auto processBlock = [](ConditionalBlock *block, ConfigurationModel *main_model,
+                                  const FileBudget &budget) {
+        std::unique_ptr<const BlockDefect> defect(
+            BlockDefectAnalyzer::analyzeBlock(block, main_model, budget));
+        if (defect && !budget.cancelled()) {
             defect->writeReportToFile(skip_non_configuration_based_defects);
-            if (do_mus_analysis)
-                defect->reportMUS(main_model);
-            delete defect;
+            if (do_mus_analysis) {
+                try {
+                    defect->reportMUS(main_model);
+                } catch (SatBudgetExceeded &e) {
+                    Logging::warn("Skipping MUS analysis of ", block->getName(), ": ", e.what());
+                }
+            }
         }
     };
 
-    /* process File (B00 Block) */
-    processBlock(file.topBlock(), main_model);
-    /* Iterate over all Blocks */
-    for (const auto &block : file)  // ConditionalBlock *
-        processBlock(block, main_model);
+    /* process File (B00 Block) and all Blocks that might be defective */
+    for (ConditionalBlock *block
+             : BlockDefectAnalyzer::getDefectCandidates(&file, main_model, budget)) {
+        std::string reason;
+        if (budget.cancelled()) {
+            return;
+        } else if (budget.exhausted()) {
+            reason = FileBudget::timeout_reason;
+        } else {
+            try {
+                processBlock(block, main_model, budget);
+                continue;
+            } catch (SatBudgetExceeded &e) {
+                reason = e.what();
+            }
+        }
+        budget.markUnknown(block->getName(), reason);
+        BlockDefectAnalyzer::writeUnknownReport(block, reason);
+    }
+    if (!budget.getUnknown().empty())
+        Logging::info(filename, ": ", budget.getUnknown().size(), " blocks unknown");
 }
 
 void process_file_dead(const std::string &filename) {
-    boost::thread t(process_file_dead_helper, filename);
-    static unsigned int timeout = 150;  // default timeout in seconds
-
-    ConfigurationModel *main_model = ModelContainer::lookupMainModel();
-    if (main_model && "cnf" == main_model->getModelVersionIdentifier()) {
-        Logging::debug("Increasing timeout for dead analysis to 3600 seconds");
+    unsigned int timeout = 150;  // default time budget of a file in seconds
+    ConfigurationModel *default_model = ModelContainer::lookupMainModel();
+    if (default_model && "cnf" == default_model->getModelVersionIdentifier()) {
+        Logging::debug("Increasing time budget for dead analysis to 3600 seconds");
         timeout = 3600;
     }
-
-    if (!t.try_join_for(boost::chrono::seconds(timeout))) {
-        Logging::error("timeout passed while processing ", filename);
-        std::exit(EXIT_FAILURE);
+    // the checks are limited by the budget of the file, the watchdog ends hangs outside of
+    // them, e.g., in the parser
+    try {
+        run_watched([filename, timeout](const FileBudget::Cancellation &cancelled) {
+            process_file_dead_helper(filename, timeout, cancelled);
+        }, timeout + 60);
+    } catch (SatBudgetExceeded &e) {
+        BlockDefectAnalyzer::writeUnknownReport(filename, e.what());
+        throw;
     }
 }
 
@@ -791,6 +925,28 @@ process_file_cb_t parse_job_argument(const std::string arg) {
     return nullptr;
 }
 
+// the parser used for the files of a job, unless it is given with -p
+CppFile::Parser default_parser(process_file_cb_t process_file) {
+    // these jobs need no more than the blocks, expressions and defines of a file, on which
+    // 'make check-parsers' compares both parsers
+    if (process_file == process_file_dead || process_file == process_file_cpppc
+            || process_file == process_file_cppsym || process_file == process_file_blockrange)
+        return CppFile::Parser::SCANNER;
+    return CppFile::Parser::PUMA;
+}
+
+// runs the job, jobs that check blocks record exhausted budgets themselves
+// \return false if the job ran out of budget, the next job can still be run
+bool run_job(process_file_cb_t process_file, const std::string &argument) {
+    try {
+        process_file(argument);
+    } catch (SatBudgetExceeded &e) {
+        Logging::error("Couldn't process ", argument, ": ", e.what());
+        return false;
+    }
+    return true;
+}
+
 int wait_for_forked_child(pid_t new_pid, int threads = 1, const char *argument = nullptr,
                           bool print_stats = false) {
     static struct { int ok, failed, signaled; } process_stats;
@@ -846,6 +1002,9 @@ int main(int argc, char **argv) {
     int opt;
     std::string worklist;
     int threads = 1;
+    int crosscheck_threads = 0;
+    unsigned long long propagation_budget = 100000000;
+    bool parser_from_parameters = false;
     std::vector<std::string> models_from_parameters;
     /* Default main model will be x86 or the first one in model container if x86 is not loaded */
     std::string main_model = "default";
@@ -867,7 +1026,7 @@ int main(int argc, char **argv) {
     coverageOutputMode = CoverageOutput::KCONFIG;
     coverageMode = CoverageMode::SIMPLE;
 
-    while ((opt = getopt(argc, argv, "ucb:M:m:t:i:B:W:sj:O:C:I:Vhvq")) != -1) {
+    while ((opt = getopt(argc, argv, "ucb:M:m:t:T:S:P:K:i:B:W:sj:O:C:I:p:Vhvq")) != -1) {
         switch (opt) {
             int n;
         case 'i':
@@ -901,11 +1060,7 @@ int main(int argc, char **argv) {
             worklist = optarg;
             break;
         case 'u':
-            if (std::system("which picomus > /dev/null") == 0)
-                do_mus_analysis = true;
-            else
-                Logging::error("Cannot do MUS-Analysis: picomus not in PATH. Continuing without "
-                               "MUS-Analysis.");
+            do_mus_analysis = true;
             break;
         case 'c':
             process_file = process_file_coverage;
@@ -955,6 +1110,23 @@ int main(int argc, char **argv) {
                 threads = 1;
             }
             break;
+        case 'T':
+            crosscheck_threads = std::stoi(optarg);
+            if (crosscheck_threads < 1) {
+                Logging::warn("Invalid numbers of crosscheck threads, using 1 instead.");
+                crosscheck_threads = 1;
+            }
+            break;
+        case 'S':
+            IncrementalSatChecker::setSliceDepth(std::stoi(optarg));
+            break;
+        case 'P':
+            propagation_budget = std::stoull(optarg);
+            break;
+        case 'K':
+            SatResultCache::setDirectory(optarg);
+            CppFileCache::setDirectory(std::string(optarg) + "/files");
+            break;
         case 'M':
             /* Specify a new main arch */
             main_model = optarg;
@@ -974,6 +1146,18 @@ int main(int argc, char **argv) {
             break;
         case 'I':
             PumaConditionalBlockBuilder::addIncludePath(optarg);
+            ScannerConditionalBlockBuilder::addIncludePath(optarg);
+            break;
+        case 'p':
+            if (0 == strcmp(optarg, "puma")) {
+                CppFile::setParser(CppFile::Parser::PUMA);
+            } else if (0 == strcmp(optarg, "scanner")) {
+                CppFile::setParser(CppFile::Parser::SCANNER);
+            } else {
+                usage(std::cerr, "Invalid parser specified");
+                return EXIT_FAILURE;
+            }
+            parser_from_parameters = true;
             break;
         case 's':
             skip_non_configuration_based_defects = true;
@@ -1000,6 +1184,13 @@ int main(int argc, char **argv) {
     }
     Logging::debug("undertaker ", version);
 
+    if (crosscheck_threads == 0)
+        crosscheck_threads = std::max(1u, boost::thread::hardware_concurrency() / threads);
+    BlockDefectAnalyzer::setCrosscheckThreads(crosscheck_threads);
+    kconfig::PicosatCNF::setPropagationBudget(propagation_budget);
+    if (!parser_from_parameters)
+        CppFile::setParser(default_parser(process_file));
+
     if (worklist == "" && optind >= argc) {
         usage(std::cout, "please specify a file to scan or a worklist");
         return EXIT_FAILURE;
@@ -1106,10 +1297,12 @@ int main(int argc, char **argv) {
                     /* now change the pointer and the working mode */
                     process_file = new_function;
                     process_mode = new_mode;
+                    if (!parser_from_parameters)
+                        CppFile::setParser(default_parser(process_file));
                 }
             }
             if (line.size() > 0)
-                process_file(line);
+                run_job(process_file, line);
         }
     } else if (workfiles.size() > 1) {
         // flush stdout to prevent printing of stdout-buffer contents multiple times
@@ -1119,8 +1312,7 @@ int main(int argc, char **argv) {
             pid_t pid = fork();
             if (pid == 0) { /* child */
                 /* calling the function pointer */
-                process_file(file);
-                return EXIT_SUCCESS;
+                return leave(run_job(process_file, file) ? EXIT_SUCCESS : EXIT_FAILURE);
             } else if (pid < 0) {
                 Logging::error("forking failed. Exiting.");
                 return EXIT_FAILURE;
@@ -1131,7 +1323,8 @@ int main(int argc, char **argv) {
         /* Wait until fork count reaches zero */
         return wait_for_forked_child(0, 0, nullptr, threads > 1);
     } else if (workfiles.size() == 1) {
-        process_file(workfiles[0]);
+        if (!run_job(process_file, workfiles[0]))
+            return leave(EXIT_FAILURE);
     }
-    return EXIT_SUCCESS;
+    return leave(EXIT_SUCCESS);
 }
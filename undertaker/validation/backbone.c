@@ -0,0 +1,24 @@
+#ifdef CONFIG_BROKEN_FOO
+#ifdef CONFIG_BAR
+#endif
+#endif
+
+#ifdef CONFIG_BAR
+#endif
+
+/*
+ * CONFIG_BROKEN_FOO is fixed to off by the model, the first two blocks
+ * contradict it without a solver.
+ *
+ * check-name: Blocks that contradict the items fixed by the model
+ * check-command: undertaker -v -m backbone.model $file; tail -n +2 backbone.model.backbone
+ * check-output-start
+I: loaded rsf model for backbone
+I: Using backbone as primary model
+I: creating backbone.c.B0.kconfig.globally.dead
+I: creating backbone.c.B1.kconfig.globally.dead
+!CONFIG_BROKEN
+!CONFIG_BROKEN_FOO
+CONFIG_X86
+ * check-output-end
+ */
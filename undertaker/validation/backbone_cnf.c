@@ -0,0 +1,34 @@
+#ifdef CONFIG_BROKEN_FOO
+#ifdef CONFIG_BAR
+#endif
+#endif
+
+#ifdef CONFIG_BAR
+#endif
+
+/*
+ * backbone.cnf is 'rsf2cnf -k -m backbone.model -r backbone.rsf'. CONFIG_BROKEN_FOO
+ * is fixed to off by the model, the first two blocks contradict it without a solver.
+ * Their reports contain the fixed value, so that the MUS analysis finds the conflict.
+ *
+ * check-name: CNF: blocks that contradict the items fixed by the model
+ * check-command: undertaker -v -u -m backbone.cnf $file && cat $file.B0.kconfig.globally.dead
+ * check-output-start
+I: loaded cnf model for backbone
+I: Using backbone as primary model
+I: creating backbone_cnf.c.B0.kconfig.globally.dead
+I: creating backbone_cnf.c.B0.kconfig.globally.dead.mus
+I: creating backbone_cnf.c.B1.kconfig.globally.dead
+I: creating backbone_cnf.c.B1.kconfig.globally.dead.mus
+#B0:backbone_cnf.c:1:1:backbone_cnf.c:4:1:
+B0
+&&
+( B0 <-> (CONFIG_BROKEN_FOO) )
+&& B00
+&&
+!CONFIG_BROKEN_FOO
+
+Arch -> Defect Type:
+backbone -> kconfig
+ * check-output-end
+ */
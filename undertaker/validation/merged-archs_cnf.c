@@ -0,0 +1,27 @@
+#if defined(CONFIG_A) && defined(CONFIG_B)
+int both;
+#endif
+
+/*
+ * archs-merged.cnf is 'rsf2cnf -a arm.cnf -a mips.cnf', only arm excludes
+ * A && B like the main model.
+ *
+ * check-name: CNF: defects on the architectures of a merged model
+ * check-command: undertaker -v -m archs-main.cnf -m archs-merged.cnf -M archs-main $file && cat $file.B0.kconfig.locally.dead
+ * check-output-start
+I: loaded cnf model for archs-main
+I: loaded cnf model for archs-merged
+I: Using archs-main as primary model
+I: creating merged-archs_cnf.c.B0.kconfig.locally.dead
+#B0:merged-archs_cnf.c:1:1:merged-archs_cnf.c:3:1:
+B0
+&&
+( B0 <-> ((CONFIG_A) && (CONFIG_B)) )
+&& B00
+
+Arch -> Defect Type:
+arm -> kconfig
+mips -> none
+archs-main -> kconfig
+ * check-output-end
+ */
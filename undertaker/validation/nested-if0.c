@@ -0,0 +1,14 @@
+#if 0
+#if 0
+int a;
+#endif
+#endif
+
+/*
+ * Each 0 is a free variable of its own, neither block is a defect.
+ *
+ * check-name: nested #if 0 blocks
+ * check-command: undertaker -v $file
+ * check-output-start
+ * check-output-end
+ */
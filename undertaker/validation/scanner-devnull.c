@@ -0,0 +1,7 @@
+/*
+ * check-name: scanner: read files that can't be mapped, e.g., /dev/null
+ * check-command: undertaker -p scanner -j blockrange /dev/null
+ * check-output-start
+/dev/null:B00:0:0
+ * check-output-end
+ */